@@ -0,0 +1,110 @@
+/**
+ * @file benchdsets.cpp
+ * Compares DisjointSets with ConcurrentDisjointSets on grid-shaped
+ * workloads at 1 to 64 threads.
+ *
+ * Usage: ./benchdsets [width] [height]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "concurrentdsets.h"
+#include "dsets.h"
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+    double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Random subset of the grid edges, in row-major order like a labeling pass
+    std::vector<std::pair<int, int>> gridEdges(int width, int height, double keep)
+    {
+        std::mt19937 g(225);
+        std::bernoulli_distribution coin(keep);
+        std::vector<std::pair<int, int>> edges;
+        for(int y = 0; y < height; y++)
+        {
+            for(int x = 0; x < width; x++)
+            {
+                int cell = y * width + x;
+                if(x + 1 < width && coin(g))
+                    edges.emplace_back(cell, cell + 1);
+                if(y + 1 < height && coin(g))
+                    edges.emplace_back(cell, cell + width);
+            }
+        }
+        return edges;
+    }
+
+    void run(int width, int height, double keep, char const * name)
+    {
+        int cells = width * height;
+        std::vector<std::pair<int, int>> edges = gridEdges(width, height, keep);
+        cout << name << ": " << width << "x" << height << " grid, " << edges.size() << " unions" << endl;
+
+        DisjointSets serial;
+        serial.reset(cells);
+        auto start = std::chrono::steady_clock::now();
+        int joined = serial.unionMany(edges);
+        double serialTime = secondsSince(start);
+        cout << "  DisjointSets           " << std::setw(9) << std::fixed << std::setprecision(4)
+             << serialTime << " s  " << cells - joined << " components" << endl;
+
+        ConcurrentDisjointSets sets;
+        for(unsigned threads = 1; threads <= 64; threads *= 2)
+        {
+            sets.reset(cells);
+            std::vector<int> joinedBy(threads);
+            auto worker = [&](unsigned t) {
+                size_t begin = edges.size() * t / threads;
+                size_t end = edges.size() * (t + 1) / threads;
+                int count = 0;
+                for(size_t i = begin; i < end; i++)
+                    count += sets.setunion(edges[i].first, edges[i].second);
+                joinedBy[t] = count;
+            };
+
+            start = std::chrono::steady_clock::now();
+            std::vector<std::thread> pool;
+            for(unsigned t = 1; t < threads; t++)
+                pool.emplace_back(worker, t);
+            worker(0);
+            for(std::thread & thread : pool)
+                thread.join();
+            double time = secondsSince(start);
+
+            int total = 0;
+            for(int count : joinedBy)
+                total += count;
+            cout << "  Concurrent, " << std::setw(2) << threads << " threads "
+                 << std::setw(9) << time << " s  " << cells - total << " components  "
+                 << std::setprecision(2) << serialTime / time << "x" << std::setprecision(4) << endl;
+        }
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    int width = argc > 1 ? std::atoi(argv[1]) : 2048;
+    int height = argc > 2 ? std::atoi(argv[2]) : 2048;
+    cout << "hardware threads: " << std::thread::hardware_concurrency() << endl;
+
+    // Every wall gone: one component, heavy contention near the roots
+    run(width, height, 1.0, "full grid");
+    // Around the percolation threshold: many mid-sized components
+    run(width, height, 0.5, "percolation");
+    return 0;
+}
@@ -10,8 +10,20 @@
 using std::string;
 
 #include "HSLAPixel.h"
+#include "PNGEncoder.h"
 
 namespace cs225 {
+  /**
+   * Dimensions and format of a PNG file, as read from its header by PNG::probe.
+   */
+  struct PNGInfo {
+    unsigned width = 0;
+    unsigned height = 0;
+    PNGColorType colorType = PNGColorType::RGBA;
+    unsigned bitDepth = 8;
+    bool interlaced = false;
+  };
+
   class PNG {
   public:
     /**
@@ -69,6 +81,53 @@ namespace cs225 {
       */
     bool readFromFile(string const & fileName);
 
+    /**
+      * Reads in a reduced version of a PNG image from a file, about 1/scale
+      * of its width and height, without decoding it at full resolution.
+      * Interlaced files only decode the Adam7 passes the reduced image
+      * needs; other files are box filtered one scanline at a time.
+      * Overwrites any current image content in the PNG.
+      * @param fileName Name of the file to be read from.
+      * @param scale Reduction factor in each dimension; 1 reads the full image.
+      * @return true, if the image was successfully read and loaded.
+      */
+    bool readFromFile(string const & fileName, unsigned scale);
+
+    /**
+      * Reads only the header (IHDR chunk) of a PNG file.
+      * @param fileName Name of the file to be inspected.
+      * @param info Receives the dimensions and format of the image.
+      * @return true, if the file starts with a valid PNG header.
+      */
+    static bool probe(string const & fileName, PNGInfo & info);
+
+    /**
+      * Reads in an image from a raw pixel file written by writeRawFile.
+      * The file is memory-mapped copy-on-write instead of being read, so
+      * loading costs little more than the page faults of the pixels used.
+      * Overwrites any current image content in the PNG.
+      * @param fileName Name of the raw file to be read from.
+      * @return true, if the image was successfully mapped.
+      */
+    bool readRawFile(string const & fileName);
+
+    /**
+      * Writes the image as a raw pixel file: a small header (width, height,
+      * pixel format, row stride) followed by the page-aligned pixel rows
+      * exactly as they are laid out in memory.
+      * @param fileName Name of the raw file to be written.
+      * @return true, if the file was successfully written.
+      */
+    bool writeRawFile(string const & fileName) const;
+
+    /**
+      * When true, readFromFile(fileName) keeps a raw copy of every PNG it
+      * decodes next to it, named `fileName + ".rawcache"`, and maps that
+      * copy instead of decoding as long as the PNG's modification time, to
+      * the nanosecond, and size are unchanged. Off by default.
+      */
+    static bool useRawCache;
+
     /**
       * Writes a PNG image to a file.
       * @param fileName Name of the file to be written.
@@ -76,6 +135,16 @@ namespace cs225 {
       */
     bool writeToFile(string const & fileName);
 
+    /**
+      * Writes a PNG image to a file using the multi-threaded encoder.
+      * The image is split into row groups that are filtered and compressed
+      * in parallel; see PNGEncoder.
+      * @param fileName Name of the file to be written.
+      * @param options Compression level and threading settings.
+      * @return true, if the image was successfully written.
+      */
+    bool writeToFile(string const & fileName, EncodeOptions const & options);
+
     /**
       * Pixel access operator. Gets a reference to the pixel at the given
       * coordinates in the image. (0,0) is the upper left corner.
@@ -121,6 +190,33 @@ namespace cs225 {
     unsigned int width_;            /*< Width of the image */
     unsigned int height_;           /*< Height of the image */
     HSLAPixel *imageData_;          /*< Array of pixels */
+    void *mapping_;                 /*< Mapped raw file holding imageData_, or NULL if allocated */
+    size_t mappingLength_;          /*< Length of mapping_ in bytes */
+
+    /**
+     * Identifies the PNG a raw cache file was made from.
+     */
+    struct RawSource {
+      long long mtime;          // modification time, seconds
+      long long mtimeNsec;      // and nanoseconds, since sizes often repeat
+      unsigned long long size;
+    };
+
+    /**
+     * Frees or unmaps the pixel array.
+     */
+    void _release();
+
+    /**
+     * Maps a raw file. If `source` is not NULL, the file is only used if it
+     * was made from that source, and failures are not reported.
+     */
+    bool _readRawFile(string const & fileName, RawSource const * source);
+
+    /**
+     * Writes a raw file, recording `source` (if not NULL) in its header.
+     */
+    bool _writeRawFile(string const & fileName, RawSource const * source) const;
 
     /**
      * Copies the contents of `other` to self
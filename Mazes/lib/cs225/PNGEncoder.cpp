@@ -0,0 +1,396 @@
+/**
+ * @file PNGEncoder.cpp
+ * Implementation of a multi-threaded, row-streaming PNG encoder built on
+ * the deflate implementation of the lodepng PNG library.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <iostream>
+using std::cerr;
+using std::endl;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "lodepng/lodepng.h"
+#include "PNGEncoder.h"
+
+namespace cs225 {
+  namespace {
+    /** Largest IDAT chunk we emit (the PNG limit is 2^31 - 1). */
+    const size_t MAX_CHUNK_DATA = size_t(1) << 30;
+
+    /** Output of one compressed row group. */
+    struct RowGroup {
+      unsigned firstRow;             // index of the first scanline within the batch
+      unsigned numRows;
+      vector<unsigned char> chunks;  // complete IDAT chunk(s) for this group
+      unsigned adler;                // Adler-32 of the filtered bytes
+      size_t filteredSize;
+      unsigned error;
+    };
+
+    unsigned channelCount(PNGColorType colorType) {
+      switch (colorType) {
+        case PNGColorType::GREY: return 1;
+        case PNGColorType::RGB: return 3;
+        case PNGColorType::PALETTE: return 1;
+        case PNGColorType::GREY_ALPHA: return 2;
+        case PNGColorType::RGBA: return 4;
+      }
+      return 0;
+    }
+
+    bool validBitDepth(PNGColorType colorType, unsigned bitDepth) {
+      switch (colorType) {
+        case PNGColorType::GREY:
+          return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8 || bitDepth == 16;
+        case PNGColorType::PALETTE:
+          return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8;
+        default:
+          return bitDepth == 8 || bitDepth == 16;
+      }
+    }
+
+    void put32(unsigned char * out, unsigned value) {
+      out[0] = (unsigned char)((value >> 24) & 0xff);
+      out[1] = (unsigned char)((value >> 16) & 0xff);
+      out[2] = (unsigned char)((value >> 8) & 0xff);
+      out[3] = (unsigned char)(value & 0xff);
+    }
+
+    /**
+     * Appends a complete chunk (length, type, data, CRC) to `out`.
+     */
+    void appendChunk(vector<unsigned char> & out, char const * type,
+                     unsigned char const * data, size_t length) {
+      size_t start = out.size();
+      out.resize(start + length + 12);
+      unsigned char * chunk = &out[start];
+      put32(chunk, (unsigned)length);
+      memcpy(chunk + 4, type, 4);
+      if (length > 0) { memcpy(chunk + 8, data, length); }
+      put32(chunk + 8 + length, lodepng_crc32(chunk + 4, length + 4));
+    }
+
+    /**
+     * Maps a 0-8 compression level onto lodepng's deflate settings. Level 8
+     * already uses lodepng's largest window and longest match.
+     */
+    LodePNGCompressSettings settingsForLevel(int level) {
+      static const unsigned windowSizes[8] = {256, 512, 1024, 2048, 4096, 8192, 16384, 32768};
+      static const unsigned niceMatches[8] = {8, 16, 32, 64, 128, 128, 192, 258};
+
+      LodePNGCompressSettings settings;
+      lodepng_compress_settings_init(&settings);
+      if (level <= 0) {
+        settings.btype = 0;
+      } else {
+        level = std::min(level, 8);
+        settings.windowsize = windowSizes[level - 1];
+        settings.nicematch = niceMatches[level - 1];
+        settings.lazymatching = (level >= 4);
+      }
+      return settings;
+    }
+
+    unsigned char paethPredictor(int a, int b, int c) {
+      int p = a + b - c;
+      int pa = std::abs(p - a);
+      int pb = std::abs(p - b);
+      int pc = std::abs(p - c);
+      if (pa <= pb && pa <= pc) { return (unsigned char)a; }
+      if (pb <= pc) { return (unsigned char)b; }
+      return (unsigned char)c;
+    }
+
+    /**
+     * Writes scanline `row` with the given filter type to `out`.
+     * `prev` is the unfiltered scanline above, or NULL for the first one.
+     */
+    void filterRow(unsigned char * out, unsigned char const * row, unsigned char const * prev,
+                   size_t length, unsigned bpp, unsigned filterType) {
+      for (size_t i = 0; i < length; i++) {
+        int a = (i >= bpp) ? row[i - bpp] : 0;
+        int b = prev ? prev[i] : 0;
+        int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+        unsigned char predicted = 0;
+        switch (filterType) {
+          case 1: predicted = (unsigned char)a; break;
+          case 2: predicted = (unsigned char)b; break;
+          case 3: predicted = (unsigned char)((a + b) / 2); break;
+          case 4: predicted = paethPredictor(a, b, c); break;
+          default: break;
+        }
+        out[i] = (unsigned char)(row[i] - predicted);
+      }
+    }
+
+    /**
+     * Filters one scanline, picking the filter type with the smallest sum of
+     * absolute (signed) residuals, the heuristic recommended by the PNG spec.
+     * Writes the filter type byte followed by the filtered bytes.
+     */
+    void filterRowAdaptive(unsigned char * out, vector<unsigned char> & scratch,
+                           unsigned char const * row, unsigned char const * prev,
+                           size_t length, unsigned bpp) {
+      size_t bestSum = (size_t)-1;
+      for (unsigned filterType = 0; filterType < 5; filterType++) {
+        filterRow(scratch.data(), row, prev, length, bpp, filterType);
+        size_t sum = 0;
+        for (size_t i = 0; i < length; i++) {
+          unsigned char s = scratch[i];
+          sum += (s < 128) ? s : (256 - s);
+        }
+        if (sum < bestSum) {
+          bestSum = sum;
+          out[0] = (unsigned char)filterType;
+          memcpy(out + 1, scratch.data(), length);
+        }
+      }
+    }
+  }
+
+  PNGEncoder::PNGEncoder(string const & fileName, unsigned width, unsigned height,
+                         PNGColorType colorType, unsigned bitDepth,
+                         EncodeOptions const & options)
+      : out_(fileName, std::ios::out | std::ios::binary | std::ios::trunc),
+        width_(width), height_(height), colorType_(colorType), bitDepth_(bitDepth),
+        options_(options), rowBytes_(0), bytesPerPixel_(1), batchRows_(0),
+        rowsWritten_(0), adler_(1), headerWritten_(false), finished_(false), ok_(true) {
+    if (!out_) {
+      cerr << "PNG encoding error: could not open " << fileName << " for writing" << endl;
+      ok_ = false;
+    }
+    if (width_ == 0 || height_ == 0) {
+      cerr << "PNG encoding error: image dimensions must be nonzero" << endl;
+      ok_ = false;
+    }
+    if (!validBitDepth(colorType_, bitDepth_)) {
+      cerr << "PNG encoding error: invalid bit depth " << bitDepth_ << " for color type "
+           << static_cast<int>(colorType_) << endl;
+      ok_ = false;
+    }
+
+    size_t bitsPerPixel = (size_t)channelCount(colorType_) * bitDepth_;
+    rowBytes_ = ((size_t)width_ * bitsPerPixel + 7) / 8;
+    bytesPerPixel_ = std::max<unsigned>(1, (unsigned)(bitsPerPixel / 8));
+
+    if (options_.level < 0) { options_.level = 0; }
+    if (options_.level > 8) { options_.level = 8; }
+    if (options_.threads == 0) {
+      options_.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (options_.rowsPerGroup == 0 && rowBytes_ > 0) {
+      size_t total = rowBytes_ * height_;
+      size_t target = std::max<size_t>(64 * 1024, std::min<size_t>(1024 * 1024, total / options_.threads));
+      options_.rowsPerGroup = (unsigned)std::max<size_t>(1, target / rowBytes_);
+    }
+    options_.rowsPerGroup = std::max(1u, std::min(options_.rowsPerGroup, std::max(1u, height_)));
+  }
+
+  PNGEncoder::~PNGEncoder() {
+    if (!finished_) { finish(); }
+  }
+
+  size_t PNGEncoder::rowBytes() const {
+    return rowBytes_;
+  }
+
+  void PNGEncoder::setPalette(vector<unsigned char> const & rgba) {
+    palette_ = rgba;
+  }
+
+  bool PNGEncoder::writeRows(unsigned char const * rows, unsigned numRows) {
+    if (!ok_ || finished_) { return false; }
+    if (numRows > height_ - rowsWritten_ - batchRows_) {
+      cerr << "PNG encoding error: more than " << height_ << " rows written" << endl;
+      ok_ = false;
+      return false;
+    }
+    if (!headerWritten_) { _writeHeader(); }
+
+    size_t capacity = (size_t)options_.threads * options_.rowsPerGroup;
+    if (batch_.size() != capacity * rowBytes_) { batch_.resize(capacity * rowBytes_); }
+
+    while (numRows > 0 && ok_) {
+      unsigned count = (unsigned)std::min<size_t>(numRows, capacity - batchRows_);
+      memcpy(batch_.data() + batchRows_ * rowBytes_, rows, count * rowBytes_);
+      rows += count * rowBytes_;
+      numRows -= count;
+      batchRows_ += count;
+      if (batchRows_ == capacity) { _flushBatch(); }
+    }
+    return ok_;
+  }
+
+  bool PNGEncoder::finish() {
+    if (finished_) { return ok_; }
+    finished_ = true;
+    if (!ok_) { return false; }
+
+    if (!headerWritten_) { _writeHeader(); }
+    if (batchRows_ > 0) { _flushBatch(); }
+
+    if (ok_ && rowsWritten_ != height_) {
+      cerr << "PNG encoding error: only " << rowsWritten_ << " of " << height_ << " rows written" << endl;
+      ok_ = false;
+    }
+
+    if (ok_) {
+      unsigned char trailer[4];
+      put32(trailer, adler_);
+      _writeChunk("IDAT", trailer, 4);
+      _writeChunk("IEND", NULL, 0);
+    }
+
+    out_.close();
+    if (out_.fail()) { ok_ = false; }
+    return ok_;
+  }
+
+  bool PNGEncoder::encode(string const & fileName, unsigned char const * data,
+                          unsigned width, unsigned height,
+                          PNGColorType colorType, unsigned bitDepth,
+                          EncodeOptions const & options) {
+    PNGEncoder encoder(fileName, width, height, colorType, bitDepth, options);
+    encoder.writeRows(data, height);
+    return encoder.finish();
+  }
+
+  void PNGEncoder::_writeHeader() {
+    headerWritten_ = true;
+
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    out_.write(reinterpret_cast<char const *>(signature), 8);
+
+    unsigned char ihdr[13];
+    put32(ihdr, width_);
+    put32(ihdr + 4, height_);
+    ihdr[8] = (unsigned char)bitDepth_;
+    ihdr[9] = (unsigned char)colorType_;
+    ihdr[10] = 0; // compression method: deflate
+    ihdr[11] = 0; // filter method: adaptive
+    ihdr[12] = 0; // no interlacing
+    _writeChunk("IHDR", ihdr, 13);
+
+    if (colorType_ == PNGColorType::PALETTE) {
+      size_t entries = palette_.size() / 4;
+      if (entries == 0 || entries > 256) {
+        cerr << "PNG encoding error: palette images need 1 to 256 palette entries" << endl;
+        ok_ = false;
+        return;
+      }
+      vector<unsigned char> plte, trns;
+      size_t lastTranslucent = 0;
+      for (size_t i = 0; i < entries; i++) {
+        plte.insert(plte.end(), &palette_[i * 4], &palette_[i * 4] + 3);
+        trns.push_back(palette_[i * 4 + 3]);
+        if (palette_[i * 4 + 3] != 255) { lastTranslucent = i + 1; }
+      }
+      _writeChunk("PLTE", plte.data(), plte.size());
+      if (lastTranslucent > 0) { _writeChunk("tRNS", trns.data(), lastTranslucent); }
+    }
+
+    // zlib header (deflate, 32K window, no dictionary) in its own IDAT so that
+    // every row group can be emitted as self-contained chunks
+    static const unsigned char zlibHeader[2] = {0x78, 0x01};
+    _writeChunk("IDAT", zlibHeader, 2);
+  }
+
+  void PNGEncoder::_flushBatch() {
+    if (!ok_ || batchRows_ == 0) { return; }
+
+    LodePNGCompressSettings settings = settingsForLevel(options_.level);
+    bool adaptive = options_.level > 0 && colorType_ != PNGColorType::PALETTE && bitDepth_ >= 8;
+
+    vector<RowGroup> groups;
+    for (unsigned first = 0; first < batchRows_; first += options_.rowsPerGroup) {
+      RowGroup group;
+      group.firstRow = first;
+      group.numRows = std::min(options_.rowsPerGroup, batchRows_ - first);
+      group.adler = 1;
+      group.filteredSize = 0;
+      group.error = 0;
+      groups.push_back(group);
+    }
+
+    std::atomic<size_t> nextGroup(0);
+    auto worker = [&]() {
+      vector<unsigned char> filtered;
+      vector<unsigned char> scratch(rowBytes_);
+      for (size_t g = nextGroup++; g < groups.size(); g = nextGroup++) {
+        RowGroup & group = groups[g];
+        filtered.resize(group.numRows * (rowBytes_ + 1));
+
+        for (unsigned r = 0; r < group.numRows; r++) {
+          unsigned batchRow = group.firstRow + r;
+          unsigned char const * row = &batch_[batchRow * rowBytes_];
+          unsigned char const * prev = NULL;
+          if (batchRow > 0) { prev = &batch_[(batchRow - 1) * rowBytes_]; }
+          else if (rowsWritten_ > 0) { prev = prevRow_.data(); }
+
+          unsigned char * out = &filtered[r * (rowBytes_ + 1)];
+          if (adaptive) {
+            filterRowAdaptive(out, scratch, row, prev, rowBytes_, bytesPerPixel_);
+          } else {
+            out[0] = 0;
+            memcpy(out + 1, row, rowBytes_);
+          }
+        }
+
+        bool final = (rowsWritten_ + group.firstRow + group.numRows == height_);
+        unsigned char * deflated = NULL;
+        size_t deflatedSize = 0;
+        group.error = lodepng_deflate_chunk(&deflated, &deflatedSize, filtered.data(), filtered.size(),
+                                            &settings, final ? 1 : 0);
+        if (!group.error) {
+          group.adler = lodepng_adler32(filtered.data(), filtered.size());
+          group.filteredSize = filtered.size();
+          for (size_t pos = 0; pos < deflatedSize; pos += MAX_CHUNK_DATA) {
+            appendChunk(group.chunks, "IDAT", deflated + pos, std::min(MAX_CHUNK_DATA, deflatedSize - pos));
+          }
+        }
+        free(deflated);
+      }
+    };
+
+    unsigned numThreads = (unsigned)std::min<size_t>(options_.threads, groups.size());
+    vector<std::thread> threads;
+    for (unsigned t = 1; t < numThreads; t++) { threads.emplace_back(worker); }
+    worker();
+    for (std::thread & thread : threads) { thread.join(); }
+
+    for (RowGroup const & group : groups) {
+      if (group.error) {
+        cerr << "PNG encoding error " << group.error << ": " << lodepng_error_text(group.error) << endl;
+        ok_ = false;
+        break;
+      }
+      adler_ = lodepng_adler32_combine(adler_, group.adler, group.filteredSize);
+      out_.write(reinterpret_cast<char const *>(group.chunks.data()), group.chunks.size());
+    }
+    if (!out_) { ok_ = false; }
+
+    prevRow_.assign(batch_.data() + (batchRows_ - 1) * rowBytes_, batch_.data() + batchRows_ * rowBytes_);
+    rowsWritten_ += batchRows_;
+    batchRows_ = 0;
+  }
+
+  void PNGEncoder::_writeChunk(char const * type, unsigned char const * data, size_t length) {
+    vector<unsigned char> chunk;
+    appendChunk(chunk, type, data, length);
+    out_.write(reinterpret_cast<char const *>(chunk.data()), chunk.size());
+    if (!out_) { ok_ = false; }
+  }
+}
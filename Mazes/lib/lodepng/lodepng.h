@@ -768,6 +768,46 @@ information is placed in the info_png field of the LodePNGState.
 unsigned lodepng_inspect(unsigned* w, unsigned* h,
                          LodePNGState* state,
                          const unsigned char* in, size_t insize);
+
+/*
+Called by lodepng_decode_rows once per scanline, from top to bottom. row holds
+scanline y packed like a one-row image, in the color mode of state->info_raw (or of
+state->info_png.color if state->decoder.color_convert is 0). It is only valid during
+the call. A nonzero return value stops decoding and is returned as the error.
+*/
+typedef unsigned (*LodePNGRowCallback)(void* user, unsigned y, const unsigned char* row);
+
+/*
+Same as lodepng_decode, but hands the image to callback one scanline at a time
+instead of returning it. Inflating, unfiltering and color conversion run on a
+small sliding window, so no buffer of the whole image is ever allocated and the
+callback can write the pixels straight to their destination. Use lodepng_inspect
+first to size that destination. Adam7 interlaced images cannot be streamed: they
+are decoded whole first and then handed out row by row.
+*/
+unsigned lodepng_decode_rows(unsigned* w, unsigned* h, LodePNGState* state,
+                             const unsigned char* in, size_t insize,
+                             LodePNGRowCallback callback, void* user);
+
+/*
+Decodes into a caller-provided buffer of h rows, row y starting at out + y * stride.
+The PNG must be exactly w * h pixels, otherwise error 105 is returned and out is
+left untouched.
+*/
+unsigned lodepng_decode_into(unsigned char* out, size_t stride, unsigned w, unsigned h,
+                             LodePNGState* state, const unsigned char* in, size_t insize);
+
+/*
+Decodes a thumbnail of ceil(width / scale) by ceil(height / scale) pixels as 8-bit RGBA,
+ignoring state->info_raw, and returns its size in w and h. Non-interlaced images are
+box filtered while they are unfiltered, one scanline at a time. For Adam7 images
+only the first passes needed for the sample grid are inflated and unfiltered (a
+scale that is a multiple of 8 only needs pass 1), and each thumbnail pixel is
+the top left pixel of its box.
+*/
+unsigned lodepng_decode_reduced32(unsigned char** out, unsigned* w, unsigned* h,
+                                  LodePNGState* state, const unsigned char* in, size_t insize,
+                                  unsigned scale);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 
@@ -913,7 +953,26 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings);
 
+/*
+Same as lodepng_deflate, but if final is 0 the output does not end the deflate
+stream: no block has BFINAL set and an empty stored block (zlib "full flush") is
+appended, so the output is byte aligned and independently compressed pieces can
+be concatenated into one stream. The last piece must be compressed with final 1.
+*/
+unsigned lodepng_deflate_chunk(unsigned char** out, size_t* outsize,
+                               const unsigned char* in, size_t insize,
+                               const LodePNGCompressSettings* settings, unsigned final);
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
+
+/*Calculate the Adler-32 checksum of a buffer, as used in the zlib trailer.*/
+unsigned lodepng_adler32(const unsigned char* data, size_t len);
+
+/*
+Adler-32 of the concatenation of two buffers, given the checksum of the first,
+the checksum of the second and the length in bytes of the second.
+*/
+unsigned lodepng_adler32_combine(unsigned adler1, unsigned adler2, size_t len2);
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
 #ifdef LODEPNG_COMPILE_DISK
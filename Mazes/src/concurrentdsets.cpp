@@ -0,0 +1,91 @@
+#include "concurrentdsets.h"
+
+ConcurrentDisjointSets::ConcurrentDisjointSets(int n)
+{
+    reset(n);
+}
+
+void ConcurrentDisjointSets::reset(int n)
+{
+    if(static_cast<int>(parent_.size()) != n)
+    {
+        std::vector<std::atomic<int>> parents(n);
+        parent_.swap(parents);
+    }
+    for(int i = 0; i < n; i++)
+    {
+        parent_[i].store(i, std::memory_order_relaxed);
+    }
+}
+
+int ConcurrentDisjointSets::size() const
+{
+    return static_cast<int>(parent_.size());
+}
+
+unsigned ConcurrentDisjointSets::_priority(int elem)
+{
+    // Multiplying by an odd constant is a bijection on 32-bit values
+    return static_cast<unsigned>(elem) * 0x9E3779B1u;
+}
+
+int ConcurrentDisjointSets::find(int elem)
+{
+    while(true)
+    {
+        int parent = parent_[elem].load(std::memory_order_acquire);
+        int grandparent = parent_[parent].load(std::memory_order_acquire);
+        if(parent == grandparent)
+        {
+            return parent;
+        }
+        // Path halving; if another thread got there first, just move on
+        parent_[elem].compare_exchange_weak(parent, grandparent,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_relaxed);
+        elem = grandparent;
+    }
+}
+
+bool ConcurrentDisjointSets::setunion(int a, int b)
+{
+    while(true)
+    {
+        a = find(a);
+        b = find(b);
+        if(a == b)
+        {
+            return false;
+        }
+        if(_priority(a) > _priority(b))
+        {
+            std::swap(a, b);
+        }
+        // a is linked below b, as long as a is still a root
+        int expected = a;
+        if(parent_[a].compare_exchange_strong(expected, b,
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+}
+
+bool ConcurrentDisjointSets::sameSet(int a, int b)
+{
+    while(true)
+    {
+        a = find(a);
+        b = find(b);
+        if(a == b)
+        {
+            return true;
+        }
+        // a was a root when found; if it still is, the sets are distinct
+        if(parent_[a].load(std::memory_order_acquire) == a)
+        {
+            return false;
+        }
+    }
+}
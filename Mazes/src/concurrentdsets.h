@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+/**
+ * A union-find that many threads may use at the same time.
+ *
+ * Every element holds an atomic parent index; roots point at themselves.
+ * Two roots are linked with one compare-and-swap on the root that loses,
+ * so a union either takes effect atomically or is retried from the new
+ * roots. Linking follows a fixed pseudo-random order of the indices (in
+ * the style of Jayanti and Tarjan), which keeps trees shallow without
+ * having to maintain ranks or sizes. Finds halve the path they walk with
+ * single compare-and-swap attempts that are never retried, so compression
+ * cannot make a find wait on another thread.
+ *
+ * reset() and the constructor are not thread-safe; everything else is.
+ */
+class ConcurrentDisjointSets
+{
+  public:
+    /**
+     * Creates n unconnected elements.
+     * @param n The number of elements
+     */
+    explicit ConcurrentDisjointSets(int n = 0);
+
+    /**
+     * Replaces the contents with n unconnected elements. Must not be
+     * called while other threads use the structure.
+     * @param n The number of elements
+     */
+    void reset(int n);
+
+    /**
+     * Gets the number of elements.
+     * @return the number of elements
+     */
+    int size() const;
+
+    /**
+     * Finds the current root of the set containing elem. If other threads
+     * are uniting sets at the same time, the root may change right after
+     * this returns.
+     * @param elem The element to look up
+     * @return the index of the root
+     */
+    int find(int elem);
+
+    /**
+     * Unites the sets containing a and b.
+     * @param a An element of the first set
+     * @param b An element of the second set
+     * @return true, if this call joined two different sets
+     */
+    bool setunion(int a, int b);
+
+    /**
+     * Checks whether a and b are in the same set. The answer is exact for
+     * all unions that finished before the call.
+     * @param a The first element
+     * @param b The second element
+     * @return true, if both are in the same set
+     */
+    bool sameSet(int a, int b);
+
+  private:
+    std::vector<std::atomic<int>> parent_;
+
+    /**
+     * Position of an element in the linking order; the root that comes
+     * first in this order is linked below the other one.
+     */
+    static unsigned _priority(int elem);
+};
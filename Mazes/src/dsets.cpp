@@ -1,25 +1,44 @@
 #include "dsets.h"
 
+#include <algorithm>
+
+namespace
+{
+    // How many elements ahead the batch operations prefetch
+    const size_t PREFETCH_DISTANCE = 8;
+}
+
 void DisjointSets::addelements(int num) 
 {
-    for(int i = 0; i < num; i++)
+    // Grow once for the whole batch, but keep geometric growth for callers
+    // that add a few elements at a time
+    size_t needed = set.size() + num;
+    if(needed > set.capacity())
     {
-        set.push_back(-1);
+        set.reserve(std::max(needed, set.capacity() * 2));
     }
+    set.insert(set.end(), num, -1);
+}
+
+void DisjointSets::reset(int n)
+{
+    set.assign(n, -1);
 }
 
 int DisjointSets::find(int elem) 
 {
-    if(set[elem] < 0)
-    {
-        return elem;
-    }
-    else
+    int parent;
+    while((parent = set[elem]) >= 0)
     {
-        int root = find(set[elem]);
-        set[elem] = root;
-        return root;
+        int grandparent = set[parent];
+        if(grandparent < 0)
+        {
+            return parent;
+        }
+        set[elem] = grandparent;
+        elem = grandparent;
     }
+    return elem;
 }
 
 void DisjointSets::setunion(int a, int b) {
@@ -31,7 +50,7 @@ void DisjointSets::setunion(int a, int b) {
     }
 
     int newSize = set[rootA] + set[rootB]; 
-    if (set[rootA] < set[rootB]) { 
+    if (set[rootA] <= set[rootB]) { 
         set[rootA] = newSize;   
         set[rootB] = rootA;      
     } else { 
@@ -40,7 +59,39 @@ void DisjointSets::setunion(int a, int b) {
     }
 }
 
+void DisjointSets::findMany(const std::vector<int> & elems, std::vector<int> & roots)
+{
+    roots.resize(elems.size());
+    for(size_t i = 0; i < elems.size(); i++)
+    {
+        if(i + PREFETCH_DISTANCE < elems.size())
+        {
+            __builtin_prefetch(set.data() + elems[i + PREFETCH_DISTANCE], 1);
+        }
+        roots[i] = find(elems[i]);
+    }
+}
 
+int DisjointSets::unionMany(const std::vector<std::pair<int, int>> & pairs)
+{
+    int joined = 0;
+    for(size_t i = 0; i < pairs.size(); i++)
+    {
+        if(i + PREFETCH_DISTANCE < pairs.size())
+        {
+            __builtin_prefetch(set.data() + pairs[i + PREFETCH_DISTANCE].first, 1);
+            __builtin_prefetch(set.data() + pairs[i + PREFETCH_DISTANCE].second, 1);
+        }
+        int rootA = find(pairs[i].first);
+        int rootB = find(pairs[i].second);
+        if(rootA != rootB)
+        {
+            setunion(rootA, rootB);
+            joined++;
+        }
+    }
+    return joined;
+}
 
 int DisjointSets::size(int elem) 
 {
@@ -51,4 +102,4 @@ int DisjointSets::size(int elem)
 int DisjointSets::getValue(int elem) const 
 {
     return set[elem];
-}
\ No newline at end of file
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <utility>
 #include <vector>
 
 class DisjointSets
@@ -12,7 +14,16 @@ class DisjointSets
     void addelements(int num);
 
     /**
-     * This function should compress paths and works as described in lecture.
+     * Replaces the contents with n unconnected root nodes, reusing the
+     * existing storage when it is large enough.
+     * @param n The number of nodes the structure should hold
+     */
+    void reset(int n);
+
+    /**
+     * This function compresses paths by halving: every node visited on the
+     * way up is pointed at its grandparent. It never recurses, so long
+     * chains cannot overflow the stack.
      * @return the index of the root of the up-tree in which the parameter
      *  element resides.
      */
@@ -35,6 +46,22 @@ class DisjointSets
      * @param b Index of the second element to union
      */
     void setunion(int a, int b);
+
+    /**
+     * Finds the roots of many elements at once. The parent slots of
+     * upcoming elements are prefetched while earlier ones are resolved.
+     * @param elems The elements to look up
+     * @param roots Receives the root of each element, in the same order
+     */
+    void findMany(const std::vector<int> & elems, std::vector<int> & roots);
+
+    /**
+     * Calls setunion on each pair in order, prefetching the parent slots of
+     * upcoming pairs.
+     * @param pairs The pairs of elements to union
+     * @return the number of pairs that joined two different sets
+     */
+    int unionMany(const std::vector<std::pair<int, int>> & pairs);
     
     /**
      * This function should return the number of nodes in the up-tree containing 
@@ -2,45 +2,65 @@
 
 #include "maze.h"
 #include "dsets.h" // Include the DisjointSets header
+#include "mazesink.h"
+#include "mazefile.h"
+#include "mazeutil.h"
 #include <vector>
+#include <climits>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #include <queue>
 #include <stack>
 #include <random>
+#include <thread>
 #include <cassert>
-
-// Direction vectors corresponding to RIGHT, DOWN, LEFT, UP
-const int DX[4] = {1, 0, -1, 0}; // RIGHT, DOWN, LEFT, UP
-const int DY[4] = {0, 1, 0, -1};
+#include <bitset>
+#include <iostream>
+
+// Masks selecting the right and the down wall bits of every cell in a word
+const uint64_t RIGHT_BITS = 0x5555555555555555ULL;
+const uint64_t DOWN_BITS = 0xAAAAAAAAAAAAAAAAULL;
+
+// makeMaze and makeMazeParallel number cells with ints, as DisjointSets does
+static bool fitsInMemory(int width, int height) {
+    if(static_cast<long long>(width) * height <= INT_MAX)
+        return true;
+    std::cerr << "Cannot make a " << width << "x" << height << " maze in memory: more than "
+              << INT_MAX << " cells; use makeMazeStreaming" << std::endl;
+    return false;
+}
 
 // Constructor
-SquareMaze::SquareMaze() : width_(0), height_(0) {}
+SquareMaze::SquareMaze() : width_(0), height_(0), wordsPerRow_(0) {}
 
 void SquareMaze::makeMaze(int width, int height) {
+    if(!fitsInMemory(width, height)) {
+        width = height = 0;
+    }
+
     // Set dimensions
     width_ = width;
     height_ = height;
-    
-    // Initialize walls
-    right_.resize(height_);
-    down_.resize(height_);
-    for (int y = 0; y < height_; ++y) {
-        right_[y].resize(width_, true); // Initialize all right walls to true
-        down_[y].resize(width_, true);  // Initialize all down walls to true
-    }
+    wordsPerRow_ = (static_cast<size_t>(width_) + CELLS_PER_WORD - 1) / CELLS_PER_WORD;
+
+    // Start with every wall in place, a whole word at a time
+    walls_.assign(wordsPerRow_ * height_, ~0ULL);
 
-    // Initialize disjoint sets
-    dset_.addelements(width_ * height_);
-    
-    // Create list of all possible walls to remove
-    std::vector<std::pair<int, int>> walls;
+    // Start every cell in its own set, reusing the storage of an earlier maze
+    sets_.reset(width_ * height_);
+
+    // List every interior wall as cell * 2 + (0 for right, 1 for down),
+    // which fits 32 bits since cells fit an int
+    std::vector<uint32_t> walls;
+    walls.reserve(static_cast<size_t>(width_) * height_ * 2);
     for(int y = 0; y < height_; ++y) {
         for(int x = 0; x < width_; ++x) {
+            uint32_t cell = static_cast<uint32_t>(y) * width_ + x;
             if(x < width_ -1)
-                walls.emplace_back(y * width_ + x, y * width_ + (x+1)); // Right wall
+                walls.push_back(cell * 2);     // Right wall
             if(y < height_ -1)
-                walls.emplace_back(y * width_ + x, (y+1) * width_ + x); // Down wall
+                walls.push_back(cell * 2 + 1); // Down wall
         }
     }
 
@@ -50,44 +70,241 @@ void SquareMaze::makeMaze(int width, int height) {
     std::shuffle(walls.begin(), walls.end(), g);
 
     // Iterate through walls and remove if it doesn't create a cycle
-    for(auto &[cell1, cell2] : walls) {
-        if(dset_.find(cell1) != dset_.find(cell2)) {
-            // Determine the direction of the wall
-            int x1 = cell1 % width_;
-            int y1 = cell1 / width_;
-            int x2 = cell2 % width_;
-            int y2 = cell2 / width_;
-            
-            if(x1 == x2) { // Down wall
-                setWall(x1, y1, DOWN, false);
+    for(uint32_t wall : walls) {
+        int cell1 = static_cast<int>(wall / 2);
+        bool down = wall & 1;
+        int cell2 = down ? cell1 + width_ : cell1 + 1;
+        if(sets_.find(cell1) != sets_.find(cell2)) {
+            setWall(cell1 % width_, cell1 / width_, down ? DOWN : RIGHT, false);
+            sets_.setunion(cell1, cell2);
+        }
+    }
+}
+
+void SquareMaze::makeMazeParallel(int width, int height, unsigned threads, int blockSize) {
+    if(!fitsInMemory(width, height)) {
+        width = height = 0;
+    }
+    width_ = width;
+    height_ = height;
+    wordsPerRow_ = (static_cast<size_t>(width_) + CELLS_PER_WORD - 1) / CELLS_PER_WORD;
+    walls_.assign(wordsPerRow_ * height_, ~0ULL);
+    if(width_ <= 0 || height_ <= 0)
+        return;
+
+    // Blocks are whole words wide, so workers never write the same word
+    int side = std::max(blockSize, 1);
+    side = (side + CELLS_PER_WORD - 1) / CELLS_PER_WORD * CELLS_PER_WORD;
+    int blocksX = (width_ + side - 1) / side;
+    int blocksY = (height_ + side - 1) / side;
+    int numBlocks = blocksX * blocksY;
+
+    // One seed per block, so the workers' generators are independent
+    std::random_device rd;
+    std::vector<unsigned> seeds(numBlocks);
+    for(unsigned &seed : seeds)
+        seed = rd();
+
+    // Carve each block with Kruskal on its own cells
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    parallelFor(numBlocks, threads, 1, [&](unsigned, size_t begin, size_t end) {
+        std::vector<unsigned> walls;
+        DisjointSets sets;
+        for(int block = static_cast<int>(begin); block < static_cast<int>(end); ++block) {
+            int x0 = (block % blocksX) * side;
+            int y0 = (block / blocksX) * side;
+            int bw = std::min(side, width_ - x0);
+            int bh = std::min(side, height_ - y0);
+
+            walls.clear();
+            for(int y = 0; y < bh; ++y) {
+                for(int x = 0; x < bw; ++x) {
+                    unsigned cell = y * bw + x;
+                    if(x < bw - 1)
+                        walls.push_back(cell * 2);
+                    if(y < bh - 1)
+                        walls.push_back(cell * 2 + 1);
+                }
             }
-            else { // Right wall
-                setWall(x1, y1, RIGHT, false);
+            std::mt19937 g(seeds[block]);
+            std::shuffle(walls.begin(), walls.end(), g);
+
+            sets.reset(bw * bh);
+            for(unsigned wall : walls) {
+                int cell1 = wall / 2;
+                bool down = wall & 1;
+                int cell2 = down ? cell1 + bw : cell1 + 1;
+                if(sets.find(cell1) != sets.find(cell2)) {
+                    setWall(x0 + cell1 % bw, y0 + cell1 / bw, down ? DOWN : RIGHT, false);
+                    sets.setunion(cell1, cell2);
+                }
             }
-            dset_.setunion(cell1, cell2);
         }
+    });
+
+    // Every block is now connected inside, so joining the blocks only needs
+    // Kruskal over the block graph: block * 2 + (0 for right, 1 for down)
+    std::vector<int> boundaries;
+    for(int block = 0; block < numBlocks; ++block) {
+        if(block % blocksX < blocksX - 1)
+            boundaries.push_back(block * 2);
+        if(block / blocksX < blocksY - 1)
+            boundaries.push_back(block * 2 + 1);
     }
+    std::mt19937 g(rd());
+    std::shuffle(boundaries.begin(), boundaries.end(), g);
+
+    DisjointSets blocks;
+    blocks.addelements(numBlocks);
+    for(int boundary : boundaries) {
+        int block1 = boundary / 2;
+        bool down = boundary & 1;
+        int block2 = down ? block1 + blocksX : block1 + 1;
+        if(blocks.find(block1) == blocks.find(block2))
+            continue;
+
+        // Open one random wall along the shared edge
+        int x0 = (block1 % blocksX) * side;
+        int y0 = (block1 / blocksX) * side;
+        if(down) {
+            int length = std::min(side, width_ - x0);
+            int x = x0 + std::uniform_int_distribution<int>(0, length - 1)(g);
+            setWall(x, y0 + side - 1, DOWN, false);
+        } else {
+            int length = std::min(side, height_ - y0);
+            int y = y0 + std::uniform_int_distribution<int>(0, length - 1)(g);
+            setWall(x0 + side - 1, y, RIGHT, false);
+        }
+        blocks.setunion(block1, block2);
+    }
+}
+
+bool SquareMaze::makeMazeStreaming(int width, int height, MazeSink & sink) {
+    if(width <= 0 || height <= 0 || !sink.begin(width, height))
+        return false;
+
+    size_t words = (static_cast<size_t>(width) + CELLS_PER_WORD - 1) / CELLS_PER_WORD;
+    std::vector<uint64_t> row(words);
+    // Set label of each cell in the current row; labels are always < width
+    std::vector<int> label(width);
+    // Union-find over the labels of one row, rebuilt for every row
+    std::vector<int> parent(width);
+    // Per label: whether it already goes down, and a random cell to open if not
+    std::vector<char> goesDown(width);
+    std::vector<int> seen(width), pick(width);
+    std::vector<char> used(width);
+
+    auto find = [&](int l) {
+        while(parent[l] != l) {
+            parent[l] = parent[parent[l]];
+            l = parent[l];
+        }
+        return l;
+    };
+    auto open = [&](int x, unsigned bit) {
+        row[x / CELLS_PER_WORD] &= ~(1ULL << (2 * (x % CELLS_PER_WORD) + bit));
+    };
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::bernoulli_distribution coin(0.5);
+
+    for(int x = 0; x < width; ++x)
+        label[x] = x;
+
+    for(int y = 0; y < height; ++y) {
+        bool last = (y == height - 1);
+        std::fill(row.begin(), row.end(), ~0ULL);
+        for(int l = 0; l < width; ++l)
+            parent[l] = l;
+
+        // Join neighbours of different sets at random (always, in the last row)
+        for(int x = 0; x + 1 < width; ++x) {
+            int a = find(label[x]);
+            int b = find(label[x + 1]);
+            if(a != b && (last || coin(g))) {
+                open(x, 0);
+                parent[b] = a;
+            }
+        }
+        for(int x = 0; x < width; ++x)
+            label[x] = find(label[x]);
+
+        if(!last) {
+            // Open some down walls, and at least one for every set
+            std::fill(goesDown.begin(), goesDown.end(), 0);
+            std::fill(seen.begin(), seen.end(), 0);
+            for(int x = 0; x < width; ++x) {
+                int l = label[x];
+                if(coin(g)) {
+                    open(x, 1);
+                    goesDown[l] = 1;
+                }
+                // Reservoir-sample one cell of each set
+                if(std::uniform_int_distribution<int>(0, seen[l]++)(g) == 0)
+                    pick[l] = x;
+            }
+            for(int x = 0; x < width; ++x) {
+                int l = label[x];
+                if(!goesDown[l]) {
+                    open(pick[l], 1);
+                    goesDown[l] = 1;
+                }
+            }
+        }
+
+        if(!sink.writeRow(row.data()))
+            return false;
+        if(last)
+            break;
+
+        // Cells below an open wall keep their set, the others get a fresh one
+        std::fill(used.begin(), used.end(), 0);
+        for(int x = 0; x < width; ++x) {
+            if(!(row[x / CELLS_PER_WORD] >> (2 * (x % CELLS_PER_WORD) + 1) & 1))
+                used[label[x]] = 1;
+        }
+        int fresh = 0;
+        for(int x = 0; x < width; ++x) {
+            if(!(row[x / CELLS_PER_WORD] >> (2 * (x % CELLS_PER_WORD) + 1) & 1))
+                continue;
+            while(used[fresh])
+                ++fresh;
+            label[x] = fresh;
+            used[fresh] = 1;
+        }
+    }
+    return sink.finish();
+}
+
+bool SquareMaze::writeRows(MazeSink & sink) const {
+    if(!sink.begin(width_, height_))
+        return false;
+    for(int y = 0; y < height_; ++y) {
+        if(!sink.writeRow(wallRow(y)))
+            return false;
+    }
+    return sink.finish();
 }
 
+unsigned SquareMaze::_walls(int x, int y) const {
+    const uint64_t *row = wallRow(y);
+    return (row[x / CELLS_PER_WORD] >> (2 * (x % CELLS_PER_WORD))) & 0x3;
+}
 
-bool SquareMaze::canTravel(int x, int y, int dir) const {
+bool SquareMaze::canTravel(int x, int y, Direction dir) const {
     if(x >= width_ || y >= height_ || x < 0 || y < 0) return false;
-    
-    if(dir == 0) { // RIGHT
-        if(x + 1 >= width_ || right_[y][x] == true) return false;
-        else return true;
-    } 
-    else if(dir == 1) { // DOWN
-        if(y + 1 >= height_ || down_[y][x] == true) return false;
-        else return true;
-    } 
-    else if(dir == 2) { // LEFT
-        if(x - 1 < 0 || right_[y][x - 1] == true) return false;
-        else return true;
-    } 
-    else if(dir == 3) { // UP
-        if(y - 1 < 0 || down_[y - 1][x] == true) return false;
-        else return true;
+
+    switch(dir) {
+        case RIGHT:
+            return x + 1 < width_ && !(_walls(x, y) & 0x1);
+        case DOWN:
+            return y + 1 < height_ && !(_walls(x, y) & 0x2);
+        case LEFT:
+            return x > 0 && !(_walls(x - 1, y) & 0x1);
+        case UP:
+            return y > 0 && !(_walls(x, y - 1) & 0x2);
     }
     return false;
 }
@@ -96,90 +313,145 @@ bool SquareMaze::canTravel(int x, int y, int dir) const {
 void SquareMaze::setWall(int x, int y, Direction dir, bool exists) {
     if(x < 0 || x >= width_ || y < 0 || y >= height_)
         return;
+    if(dir != RIGHT && dir != DOWN)
+        return;
 
-    if(dir == RIGHT) {
-        if(exists)
-            maze_[y * width_ + x] |= 0x01; // Set right wall
-        else
-            maze_[y * width_ + x] &= ~0x01; // Remove right wall
-    }
-    else if(dir == DOWN) {
-        if(exists)
-            maze_[y * width_ + x] |= 0x02; // Set down wall
-        else
-            maze_[y * width_ + x] &= ~0x02; // Remove down wall
-    }
+    uint64_t &word = walls_[static_cast<size_t>(y) * wordsPerRow_ + x / CELLS_PER_WORD];
+    uint64_t bit = 1ULL << (2 * (x % CELLS_PER_WORD) + (dir == DOWN ? 1 : 0));
+    if(exists)
+        word |= bit;
+    else
+        word &= ~bit;
+}
+
+const uint64_t *SquareMaze::wallRow(int y) const {
+    return walls_.data() + static_cast<size_t>(y) * wordsPerRow_;
+}
+
+int SquareMaze::width() const {
+    return width_;
+}
+
+int SquareMaze::height() const {
+    return height_;
+}
+
+size_t SquareMaze::wordsPerRow() const {
+    return wordsPerRow_;
+}
+
+size_t SquareMaze::countPassages(int y, Direction dir) const {
+    if(y < 0 || y >= height_ || (dir != RIGHT && dir != DOWN))
+        return 0;
+
+    // Padding bits are always walls, so a plain popcount of the open bits works
+    const uint64_t *row = wallRow(y);
+    uint64_t mask = dir == RIGHT ? RIGHT_BITS : DOWN_BITS;
+    size_t count = 0;
+    for(size_t i = 0; i < wordsPerRow_; ++i)
+        count += std::bitset<64>(~row[i] & mask).count();
+    return count;
+}
+
+unsigned SquareMaze::openDirections(int x, int y) const {
+    // Branch-free: in a random maze every one of these tests is a coin flip
+    const uint64_t *row = wallRow(y);
+    unsigned walls = (row[x / CELLS_PER_WORD] >> (2 * (x % CELLS_PER_WORD))) & 0x3;
+    int left = x > 0 ? x - 1 : x;
+    unsigned leftWalls = (row[left / CELLS_PER_WORD] >> (2 * (left % CELLS_PER_WORD))) & 0x1;
+    const uint64_t *above = y > 0 ? row - wordsPerRow_ : row;
+    unsigned upWalls = (above[x / CELLS_PER_WORD] >> (2 * (x % CELLS_PER_WORD) + 1)) & 0x1;
+
+    unsigned open = (~walls & 0x3) & ((x + 1 < width_) | (y + 1 < height_) << 1);
+    open |= (!leftWalls & (x > 0)) << LEFT;
+    open |= (!upWalls & (y > 0)) << UP;
+    return open;
 }
 
 // solveMaze implementation
 std::vector<Direction> SquareMaze::solveMaze(int startX) {
-    // BFS variables
-    std::vector<int> distance(width_ * height_, -1);
-    std::vector<int> predecessor(width_ * height_, -1);
-    std::queue<int> q;
-
-    int start = startX;
-    distance[start] = 0;
-    q.push(start);
-
-    // BFS to compute distances
-    while(!q.empty()) {
-        int current = q.front();
-        q.pop();
-
-        int x = current % width_;
-        int y = current / width_;
-
-        for(int d = 0; d < 4; ++d) {
-            Direction dir = static_cast<Direction>(d);
-            if(canTravel(x, y, dir)) {
-                int newX = x + DX[d];
-                int newY = y + DY[d];
-                int neighbor = newY * width_ + newX;
-                if(distance[neighbor] == -1) {
-                    distance[neighbor] = distance[current] + 1;
-                    predecessor[neighbor] = current;
-                    q.push(neighbor);
-                }
-            }
+    if(width_ <= 0 || height_ <= 0)
+        return std::vector<Direction>();
+
+    // A perfect maze is a tree, so a depth-first walk that never steps back
+    // to its parent reaches every cell exactly once. The walk needs no stack:
+    // each cell stores the direction of its parent in 2 bits, which is how
+    // it finds its way back up, and depth is kept only for the bottom row.
+    size_t cells = static_cast<size_t>(width_) * height_;
+    std::vector<uint64_t> parent((cells + 31) / 32);
+    std::vector<int> bottomDepth(width_, -1);
+    auto parentOf = [&](size_t cell) {
+        return static_cast<int>((parent[cell / 32] >> (2 * (cell % 32))) & 0x3);
+    };
+
+    const ptrdiff_t step[4] = {1, width_, -1, -static_cast<ptrdiff_t>(width_)};
+    auto setParent = [&](size_t c, int up) {
+        uint64_t &word = parent[c / 32];
+        word = (word & ~(0x3ULL << (2 * (c % 32)))) | (static_cast<uint64_t>(up) << (2 * (c % 32)));
+    };
+
+    int x = startX, y = 0, depth = 0, dir = 0;
+    int back = -1; // direction of the parent of the current cell, -1 at the start
+    size_t cell = startX;
+    size_t descents = 0;
+    if(height_ == 1)
+        bottomDepth[x] = 0;
+    while(true) {
+        // Open directions other than the way back, from dir onwards
+        unsigned open = openDirections(x, y) & (~0u << dir);
+        if(back >= 0)
+            open &= ~(1u << back);
+
+        if(open) {
+            dir = __builtin_ctz(open);
+            if(++descents >= cells)
+                return solveMazeParallel(startX); // more edges than a tree: not perfect
+
+            int cx = x + DX[dir], cy = y + DY[dir];
+            size_t child = cell + step[dir];
+            int up = (dir + 2) % 4;
+            setParent(child, up);
+            if(cy == height_ - 1)
+                bottomDepth[cx] = depth + 1;
+
+            // Step down into the child
+            x = cx;
+            y = cy;
+            cell = child;
+            back = up;
+            ++depth;
+            dir = 0;
+            continue;
         }
-    }
 
-    // Find the cell in the bottom row with the maximum distance
-    int maxDist = -1;
-    int endCell = -1;
-    for(int x = 0; x < width_; ++x) {
-        int cell = (height_ -1) * width_ + x;
-        if(distance[cell] > maxDist) {
-            maxDist = distance[cell];
-            endCell = cell;
-        }
-        else if(distance[cell] == maxDist && x < (endCell % width_)) {
-            endCell = cell;
-        }
+        // Every child is done; go back up and try the parent's next direction
+        if(depth == 0)
+            break;
+        x += DX[back];
+        y += DY[back];
+        cell += step[back];
+        --depth;
+        dir = (back + 2) % 4 + 1;
+        back = depth > 0 ? parentOf(cell) : -1;
     }
 
-    // Reconstruct the path from endCell to start
-    std::vector<Direction> path;
-    int current = endCell;
-    while(current != start) {
-        int pred = predecessor[current];
-        assert(pred != -1); // Ensure there is a predecessor
-        int dx = (current % width_) - (pred % width_);
-        int dy = (current / width_) - (pred / width_);
-        if(dx == 1 && dy == 0)
-            path.push_back(RIGHT);
-        else if(dx == -1 && dy == 0)
-            path.push_back(LEFT);
-        else if(dx == 0 && dy == 1)
-            path.push_back(DOWN);
-        else if(dx == 0 && dy == -1)
-            path.push_back(UP);
-        current = pred;
+    // Farthest bottom-row cell, smallest x on ties
+    int endX = 0;
+    for(int i = 1; i < width_; ++i) {
+        if(bottomDepth[i] > bottomDepth[endX])
+            endX = i;
     }
 
-    // Reverse the path to start from the beginning
-    std::reverse(path.begin(), path.end());
+    // Follow the parent directions back up to the start
+    std::vector<Direction> path(bottomDepth[endX] > 0 ? bottomDepth[endX] : 0);
+    x = endX;
+    y = height_ - 1;
+    for(size_t i = path.size(); i-- > 0; ) {
+        int up = parentOf(static_cast<size_t>(y) * width_ + x);
+        path[i] = static_cast<Direction>((up + 2) % 4);
+        x += DX[up];
+        y += DY[up];
+    }
     return path;
 }
 
@@ -223,12 +495,13 @@ cs225::PNG *SquareMaze::drawMaze(int start) const {
         pixel.a = 1.0;
     }
 
-    // Draw the walls
+    // Draw the walls, reading each packed word once
     for(int y = 0; y < height_; ++y) {
+        const uint64_t *row = wallRow(y);
         for(int x = 0; x < width_; ++x) {
-            int cell = y * width_ + x;
+            unsigned walls = (row[x / CELLS_PER_WORD] >> (2 * (x % CELLS_PER_WORD))) & 0x3;
             // Right wall
-            if(maze_[cell] & 0x01) {
+            if(walls & 0x01) {
                 for(int k = 0; k <=10; ++k) {
                     int px = (x +1)*10;
                     int py = y*10 +k;
@@ -242,7 +515,7 @@ cs225::PNG *SquareMaze::drawMaze(int start) const {
                 }
             }
             // Down wall
-            if(maze_[cell] & 0x02) {
+            if(walls & 0x02) {
                 for(int k = 0; k <=10; ++k) {
                     int px = x*10 +k;
                     int py = (y +1)*10;
@@ -281,69 +554,68 @@ cs225::PNG *SquareMaze::drawMazeWithSolution(int start) {
     // Starting coordinates (center of the starting cell)
     int x = start * 10 + 5;
     int y = 5;
+    png->getPixel(x, y) = red;
 
-    // Draw the solution path
+    // Draw the solution path: each step colors 11 pixels, sharing its
+    // first pixel with the end of the previous step
     for(auto dir : solution) {
-        // Draw a segment of 10 pixels in the specified direction
         for(int i = 0; i < 10; ++i) {
-            // Ensure coordinates are within bounds before coloring
-            if(x < 0 || y < 0 || x >= static_cast<int>(width_) * 10 || y >= static_cast<int>(height_) * 10) {
-                std::cerr << "Error: Path drawing out of bounds at (" << x << ", " << y << ")." << std::endl;
-                assert(false); // Or handle the error gracefully
-            }
-
-            // Color the current pixel red
-            cs225::HSLAPixel & pixel = png->getPixel(x, y);
-            pixel = red;
-
-            // Update coordinates based on direction
-            if(dir == RIGHT)
-                x++;
-            else if(dir == DOWN)
-                y++;
-            else if(dir == LEFT && x > 0)
-                x--;
-            else if(dir == UP && y > 0)
-                y--;
+            x += DX[dir];
+            y += DY[dir];
+            png->getPixel(x, y) = red;
         }
     }
 
-    // Determine the end cell based on the solution path
-    int endX = start;
-    int endY = 0;
-    for(auto dir : solution) {
-        endX += DX[dir];
-        endY += DY[dir];
+    // The path ends at the center of the destination cell
+    int endX = (x - 5) / 10;
+    int endY = (y - 5) / 10;
+
+    // Whiten the bottom wall of the destination cell to make the exit
+    for(int k = 1; k < 10; ++k) {
+        cs225::HSLAPixel & pixel = png->getPixel(endX * 10 + k, (endY + 1) * 10);
+        pixel.h = 0;
+        pixel.s = 0;
+        pixel.l = 1.0;
+        pixel.a = 1.0;
     }
 
-    // Remove the down wall of the end cell to create an exit
-    setWall(endX, endY, DOWN, false);
+    return png;
+}
 
-    // Draw the exit path (one final step down)
-    for(int i = 0; i < 10; ++i) {
-        int px = endX * 10 + 5; // Center of the cell
-        int py = (endY + 1) * 10 + i;
+bool SquareMaze::renderMaze(std::string const & fileName, int start, int cellSize) const {
+    MazeImageSink image(fileName, start, cellSize);
+    return writeRows(image);
+}
 
-        // Ensure exit pixels are within bounds
-        if(px < static_cast<int>(png->width()) && py < static_cast<int>(png->height())) {
-            cs225::HSLAPixel & pixel = png->getPixel(px, py);
-            pixel = red; // Optionally, keep it red to show the exit path
-        }
-    }
+bool SquareMaze::renderMazeWithSolution(std::string const & fileName, int start, int cellSize) {
+    MazeImageSink image(fileName, start, cellSize);
+    image.setSolution(solveMaze(start));
+    return writeRows(image);
+}
 
-    // Whiten the exit pixels to visually indicate the exit
-    for(int k = 1; k < 10; ++k) {
-        int px = endX * 10 + k;
-        int py = (endY + 1) * 10;
-        if(px < static_cast<int>(png->width()) && py < static_cast<int>(png->height())) {
-            cs225::HSLAPixel & pixel = png->getPixel(px, py);
-            pixel.h = 0;
-            pixel.s = 0;
-            pixel.l = 1.0;
-            pixel.a = 1.0;
-        }
-    }
+bool SquareMaze::saveMaze(std::string const & fileName) const {
+    MazeFileSink file(fileName);
+    return writeRows(file);
+}
 
-    return png;
+bool SquareMaze::saveMazeWithSolution(std::string const & fileName, int start) {
+    MazeFileSink file(fileName);
+    file.setSolution(start, solveMaze(start));
+    return writeRows(file);
 }
 
+bool SquareMaze::loadMaze(std::string const & fileName) {
+    MazeFile file;
+    if(!file.open(fileName))
+        return false;
+
+    // The file's rows have exactly our layout, padding bits included
+    width_ = file.width();
+    height_ = file.height();
+    wordsPerRow_ = file.wordsPerRow();
+    walls_.resize(wordsPerRow_ * height_);
+    if(!walls_.empty())
+        std::memcpy(walls_.data(), file.wallRow(0), walls_.size() * sizeof(uint64_t));
+    sets_.reset(0);
+    return true;
+}
@@ -6,9 +6,15 @@
  */
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
 #include <vector>
 #include "cs225/PNG.h"
 #include "cs225/HSLAPixel.h"
+#include "dsets.h"
+
+class MazeSink;
 
 
 /**
@@ -62,11 +68,59 @@ public:
    * Hints: You only need to store 2 bits per square: the "down" and
    * "right" walls. The finished maze is always a tree of corridors.)
    *
+   * Cells are numbered with ints, so a maze of more than INT_MAX cells is
+   * refused with a message on stderr and this becomes an empty maze; use
+   * makeMazeStreaming() for those.
+   *
    * @param width The width of the SquareMaze (number of cells)
    * @param height The height of the SquareMaze (number of cells)
    */
   void makeMaze(int width, int height);
 
+  /**
+   * Makes a new SquareMaze of the given height and width on several
+   * threads.
+   *
+   * The grid is cut into square blocks. Each block is carved into a
+   * spanning tree of its own cells on a worker thread. A final Kruskal pass
+   * over the block adjacency graph then opens one random wall on the
+   * boundaries that join the blocks together, so the result is still a
+   * perfect maze (a spanning tree of the whole grid).
+   *
+   * Like makeMaze(), refuses mazes of more than INT_MAX cells.
+   *
+   * @param width The width of the SquareMaze (number of cells)
+   * @param height The height of the SquareMaze (number of cells)
+   * @param threads Number of worker threads; 0 uses
+   *  std::thread::hardware_concurrency()
+   * @param blockSize Side of a block in cells, rounded up to a multiple of
+   *  CELLS_PER_WORD so no two blocks share a word of the wall grid
+   */
+  void makeMazeParallel(int width, int height, unsigned threads = 0,
+                        int blockSize = 256);
+
+  /**
+   * Generates a maze row by row with Eller's algorithm and hands each row
+   * of walls to a sink as soon as it is final.
+   *
+   * Only the set membership of the current row is kept, so memory use is
+   * O(width) no matter how tall the maze is. The result is a perfect maze.
+   * This is the way to make mazes too large for makeMaze() to hold.
+   *
+   * @param width The width of the maze (number of cells)
+   * @param height The height of the maze (number of cells)
+   * @param sink Receives the rows, in the layout of wallRow()
+   * @return true, if every row was accepted by the sink
+   */
+  static bool makeMazeStreaming(int width, int height, MazeSink & sink);
+
+  /**
+   * Hands every row of this maze to a sink, from the top down.
+   * @param sink Receives the rows, in the layout of wallRow()
+   * @return true, if every row was accepted by the sink
+   */
+  bool writeRows(MazeSink & sink) const;
+
   /**
    * This uses your representation of the maze to determine whether it is
    * possible to travel in the given direction from the square at
@@ -128,10 +182,30 @@ public:
    * HINT: this function should run in time linear in the number of cells
    * in the maze.
    *
+   * A perfect maze is walked as a tree, keeping only a 2-bit parent
+   * direction per cell. Mazes with loops fall back to solveMazeParallel().
+   *
    * @return a vector of directions taken to solve the maze
    */
   std::vector<Direction> solveMaze(int startX);
 
+  /**
+   * Solves this SquareMaze like solveMaze(), with a breadth-first search
+   * that also handles mazes with loops, on several threads.
+   *
+   * The search is level-synchronous. Narrow levels keep their frontier as
+   * a list of cells and expand it top-down; wide levels switch to bitmap
+   * frontiers and a bottom-up step in which every unvisited cell looks for
+   * a neighbour in the frontier. The distances, and therefore the chosen
+   * destination, are the same as a serial BFS.
+   *
+   * @param startX The x coordinate of the start cell in the top row
+   * @param threads Number of worker threads; 0 uses
+   *  std::thread::hardware_concurrency()
+   * @return a vector of directions taken to solve the maze
+   */
+  std::vector<Direction> solveMazeParallel(int startX, unsigned threads = 0) const;
+
   /**
    * Draws the maze without the solution.
    *
@@ -174,10 +248,123 @@ public:
    */
   cs225::PNG *drawMazeWithSolution(int start);
 
+  /**
+   * Writes the picture of drawMaze() straight to a PNG file, one row of
+   * cells at a time, as a 1-bit palette image. The image is never held in
+   * memory, so mazes far too large for drawMaze() can be drawn.
+   *
+   * @param fileName Name of the PNG file to be written
+   * @param start The x coordinate of the entrance in the top row
+   * @param cellSize Pixels from one wall line to the next; at least 2.
+   *  drawMaze() uses 10.
+   * @return true, if the file was written
+   */
+  bool renderMaze(std::string const & fileName, int start, int cellSize = 10) const;
+
+  /**
+   * Like renderMaze(), but with the solution and exit of
+   * drawMazeWithSolution(), as a 2-bit palette image.
+   *
+   * @param fileName Name of the PNG file to be written
+   * @param start The x coordinate of the entrance in the top row
+   * @param cellSize Pixels from one wall line to the next; at least 2
+   * @return true, if the file was written
+   */
+  bool renderMazeWithSolution(std::string const & fileName, int start, int cellSize = 10);
+
+  /**
+   * Saves the packed wall grid in the binary format of MazeFileSink.
+   *
+   * @param fileName Name of the file to be written
+   * @return true, if the file was written
+   */
+  bool saveMaze(std::string const & fileName) const;
+
+  /**
+   * Saves the packed wall grid followed by the result of solveMaze(start).
+   *
+   * @param fileName Name of the file to be written
+   * @param start The x coordinate of the entrance in the top row
+   * @return true, if the file was written
+   */
+  bool saveMazeWithSolution(std::string const & fileName, int start);
+
+  /**
+   * Replaces this maze with one saved by saveMaze(). The file is
+   * memory-mapped and its rows copied in with one memcpy, so loading costs
+   * about as much as reading the bytes; see MazeFile to look at a saved
+   * maze, and its solution, without copying it at all.
+   *
+   * @param fileName Name of the file to be read
+   * @return true, if the file held a maze; otherwise this maze is unchanged
+   */
+  bool loadMaze(std::string const & fileName);
+
+  /**
+   * Number of cells packed into one word of the wall grid.
+   */
+  static const int CELLS_PER_WORD = 32;
 
-  private: 
-    int width_;
-    int height_;
-    std::vector<unsigned char> maze_;
+  /**
+   * Gets the packed walls of one row of the maze.
+   *
+   * Cell x of the row is stored in word x / CELLS_PER_WORD, at bit
+   * 2 * (x % CELLS_PER_WORD) for its right wall and the bit above that for
+   * its down wall. A set bit means the wall exists. Bits past the last cell
+   * of the row are always set.
+   *
+   * @param y The row to look at
+   * @return pointer to wordsPerRow() words
+   */
+  const uint64_t *wallRow(int y) const;
 
-};
\ No newline at end of file
+  /**
+   * Gets the number of words used by each row of the wall grid.
+   * @return words per row
+   */
+  size_t wordsPerRow() const;
+
+  /**
+   * Counts the passages leaving a row in the given direction, a whole word
+   * of cells at a time.
+   *
+   * @param y The row to look at
+   * @param dir RIGHT or DOWN
+   * @return the number of cells in row y with no wall on that side
+   */
+  size_t countPassages(int y, Direction dir) const;
+
+  /**
+   * Gets every direction canTravel would allow from (x, y) at once.
+   * @param x The x coordinate of the cell, inside the maze
+   * @param y The y coordinate of the cell, inside the maze
+   * @return a mask with bit d set if there is a passage in Direction d
+   */
+  unsigned openDirections(int x, int y) const;
+
+  /**
+   * Gets the width of the maze.
+   * @return the number of cells in each row
+   */
+  int width() const;
+
+  /**
+   * Gets the height of the maze.
+   * @return the number of rows
+   */
+  int height() const;
+
+  private:
+    int width_;                   /*< Width of the maze in cells */
+    int height_;                  /*< Height of the maze in cells */
+    size_t wordsPerRow_;          /*< Words per row of walls_ */
+    std::vector<uint64_t> walls_; /*< 2 bits per cell, row-major */
+    DisjointSets sets_;           /*< Cell sets, reused by makeMaze */
+
+    /**
+     * Gets the two wall bits of cell (x, y): bit 0 is the right wall and
+     * bit 1 the down wall.
+     */
+    unsigned _walls(int x, int y) const;
+
+};
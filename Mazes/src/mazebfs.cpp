@@ -0,0 +1,165 @@
+/**
+ * @file mazebfs.cpp
+ * Level-synchronous, direction-optimizing parallel BFS over the packed
+ * wall grid of a SquareMaze.
+ */
+
+#include "maze.h"
+#include "mazeutil.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+  // Below this much work per level, threads cost more than they save
+  const size_t PARALLEL_MIN = 1024;
+
+  // Go bottom-up while the frontier is more than 1/14 of the unvisited
+  // cells and more than 1/64 of all cells. The second test keeps the long
+  // thin tails of a maze search top-down, since every bottom-up level scans
+  // the whole visited bitmap.
+  const size_t BOTTOM_UP_UNVISITED = 14;
+  const size_t BOTTOM_UP_CELLS = 64;
+}
+
+std::vector<Direction> SquareMaze::solveMazeParallel(int startX, unsigned threads) const {
+  if (width_ <= 0 || height_ <= 0) {
+    return std::vector<Direction>();
+  }
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  const size_t cells = static_cast<size_t>(width_) * height_;
+  const size_t words = (cells + 63) / 64;
+  const ptrdiff_t step[4] = {1, width_, -1, -static_cast<ptrdiff_t>(width_)};
+
+  std::vector<int> distance(cells, -1);
+  std::vector<std::atomic<uint64_t>> visited(words);
+  for (std::atomic<uint64_t> & word : visited) {
+    word.store(0, std::memory_order_relaxed);
+  }
+
+  // The frontier is a list of cells while narrow and a bitmap while wide
+  std::vector<size_t> frontier(1, startX);
+  std::vector<uint64_t> frontierBits, nextBits;
+  size_t frontierSize = 1;
+  bool bottomUp = false;
+  distance[startX] = 0;
+  visited[startX / 64].store(1ULL << (startX % 64), std::memory_order_relaxed);
+  size_t unvisited = cells - 1;
+
+  std::vector<std::vector<size_t>> found(threads);
+  std::vector<size_t> counts(threads);
+  for (int level = 0; frontierSize > 0; level++) {
+    bool wide = frontierSize * BOTTOM_UP_UNVISITED > unvisited && frontierSize * BOTTOM_UP_CELLS > cells;
+    if (!bottomUp && wide) {
+      frontierBits.assign(words, 0);
+      for (size_t cell : frontier) {
+        frontierBits[cell / 64] |= 1ULL << (cell % 64);
+      }
+      bottomUp = true;
+    } else if (bottomUp && !wide) {
+      frontier.clear();
+      for (size_t w = 0; w < words; w++) {
+        for (uint64_t bits = frontierBits[w]; bits; bits &= bits - 1) {
+          frontier.push_back(w * 64 + __builtin_ctzll(bits));
+        }
+      }
+      bottomUp = false;
+    }
+
+    if (!bottomUp) {
+      // Top-down: each frontier cell claims its unvisited neighbours
+      parallelFor(frontier.size(), threads, PARALLEL_MIN, [&](unsigned t, size_t begin, size_t end) {
+        std::vector<size_t> & out = found[t];
+        for (size_t i = begin; i < end; i++) {
+          size_t cell = frontier[i];
+          unsigned open = openDirections(static_cast<int>(cell % width_), static_cast<int>(cell / width_));
+          for (; open; open &= open - 1) {
+            size_t next = cell + step[__builtin_ctz(open)];
+            uint64_t bit = 1ULL << (next % 64);
+            if (visited[next / 64].load(std::memory_order_relaxed) & bit) {
+              continue;
+            }
+            if (!(visited[next / 64].fetch_or(bit, std::memory_order_relaxed) & bit)) {
+              distance[next] = level + 1;
+              out.push_back(next);
+            }
+          }
+        }
+      });
+      frontier.clear();
+      for (unsigned t = 0; t < threads; t++) {
+        frontier.insert(frontier.end(), found[t].begin(), found[t].end());
+        found[t].clear();
+      }
+      frontierSize = frontier.size();
+    } else {
+      // Bottom-up: each unvisited cell looks for a neighbour in the
+      // frontier. Threads own whole words, so no atomics are needed.
+      nextBits.assign(words, 0);
+      parallelFor(words, threads, PARALLEL_MIN, [&](unsigned t, size_t begin, size_t end) {
+        size_t count = 0;
+        for (size_t w = begin; w < end; w++) {
+          uint64_t todo = ~visited[w].load(std::memory_order_relaxed);
+          if (w == words - 1 && cells % 64) {
+            todo &= (1ULL << (cells % 64)) - 1;
+          }
+          uint64_t claimed = 0;
+          for (; todo; todo &= todo - 1) {
+            size_t cell = w * 64 + __builtin_ctzll(todo);
+            unsigned open = openDirections(static_cast<int>(cell % width_), static_cast<int>(cell / width_));
+            for (; open; open &= open - 1) {
+              size_t next = cell + step[__builtin_ctz(open)];
+              if (frontierBits[next / 64] >> (next % 64) & 1) {
+                distance[cell] = level + 1;
+                claimed |= 1ULL << (cell % 64);
+                count++;
+                break;
+              }
+            }
+          }
+          nextBits[w] = claimed;
+          visited[w].fetch_or(claimed, std::memory_order_relaxed);
+        }
+        counts[t] = count;
+      });
+      frontierBits.swap(nextBits);
+      frontierSize = 0;
+      for (unsigned t = 0; t < threads; t++) {
+        frontierSize += counts[t];
+        counts[t] = 0;
+      }
+    }
+    unvisited -= frontierSize;
+  }
+
+  // Farthest bottom-row cell, smallest x on ties
+  size_t bottom = cells - width_;
+  int endX = 0;
+  for (int x = 1; x < width_; x++) {
+    if (distance[bottom + x] > distance[bottom + endX]) {
+      endX = x;
+    }
+  }
+
+  // Walk back down the distances, preferring directions in enum order
+  int length = distance[bottom + endX];
+  std::vector<Direction> path(length > 0 ? length : 0);
+  size_t cell = bottom + endX;
+  for (size_t i = path.size(); i-- > 0; ) {
+    unsigned open = openDirections(static_cast<int>(cell % width_), static_cast<int>(cell / width_));
+    for (; open; open &= open - 1) {
+      int dir = __builtin_ctz(open);
+      size_t prev = cell + step[dir];
+      if (distance[prev] == static_cast<int>(i)) {
+        path[i] = static_cast<Direction>((dir + 2) % 4);
+        cell = prev;
+        break;
+      }
+    }
+  }
+  return path;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file mazefile.cpp
+ * Implementation of the memory-mapped maze file reader.
+ */
+
+#include "mazefile.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  const size_t HEADER_BYTES = 32;
+  const size_t SOLUTION_HEADER_BYTES = 16;
+  const uint32_t FLAG_SOLUTION = 1;
+
+  template <typename T>
+  T readField(const unsigned char *bytes, size_t offset) {
+    T value;
+    std::memcpy(&value, bytes + offset, sizeof(T));
+    return value;
+  }
+}
+
+MazeFile::MazeFile()
+  : data_(NULL), size_(0), width_(0), height_(0), wordsPerRow_(0), rows_(NULL),
+    solutionStart_(0), solutionSize_(0), solved_(false), solution_(NULL) {}
+
+MazeFile::~MazeFile() {
+  close();
+}
+
+void MazeFile::close() {
+  if (data_ != NULL) {
+    munmap(data_, size_);
+  }
+  data_ = NULL;
+  size_ = 0;
+  width_ = 0;
+  height_ = 0;
+  wordsPerRow_ = 0;
+  rows_ = NULL;
+  solutionStart_ = 0;
+  solutionSize_ = 0;
+  solved_ = false;
+  solution_ = NULL;
+}
+
+bool MazeFile::open(std::string const & fileName) {
+  close();
+
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Unable to open " << fileName << std::endl;
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < HEADER_BYTES) {
+    std::cerr << fileName << " is not a maze file" << std::endl;
+    ::close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "Unable to map " << fileName << std::endl;
+    return false;
+  }
+  data_ = data;
+  size_ = size;
+
+  // Every field is checked against the file size before it is trusted
+  const unsigned char *bytes = static_cast<const unsigned char *>(data_);
+  uint32_t width = readField<uint32_t>(bytes, 12);
+  uint32_t height = readField<uint32_t>(bytes, 16);
+  uint32_t flags = readField<uint32_t>(bytes, 20);
+  uint64_t words = readField<uint64_t>(bytes, 24);
+  uint64_t expectedWords = (static_cast<uint64_t>(width) + SquareMaze::CELLS_PER_WORD - 1) / SquareMaze::CELLS_PER_WORD;
+  size_t rowBytes = static_cast<size_t>(words) * height * sizeof(uint64_t);
+  if (std::memcmp(bytes, "CS225MAZ", 8) != 0 || readField<uint32_t>(bytes, 8) != 1
+      || width > 0x7fffffff || height > 0x7fffffff || words != expectedWords
+      || size - HEADER_BYTES < rowBytes) {
+    std::cerr << fileName << " is not a maze file" << std::endl;
+    close();
+    return false;
+  }
+  width_ = static_cast<int>(width);
+  height_ = static_cast<int>(height);
+  wordsPerRow_ = static_cast<size_t>(words);
+  rows_ = reinterpret_cast<const uint64_t *>(bytes + HEADER_BYTES);
+
+  if (flags & FLAG_SOLUTION) {
+    size_t offset = HEADER_BYTES + rowBytes;
+    if (size - offset < SOLUTION_HEADER_BYTES) {
+      std::cerr << fileName << " has a truncated solution" << std::endl;
+      close();
+      return false;
+    }
+    uint32_t start = readField<uint32_t>(bytes, offset);
+    uint64_t steps = readField<uint64_t>(bytes, offset + 8);
+    uint64_t stepWords = steps / SquareMaze::CELLS_PER_WORD + (steps % SquareMaze::CELLS_PER_WORD != 0);
+    offset += SOLUTION_HEADER_BYTES;
+    if (start >= width || stepWords > (size - offset) / sizeof(uint64_t)) {
+      std::cerr << fileName << " has a truncated solution" << std::endl;
+      close();
+      return false;
+    }
+    solved_ = true;
+    solutionStart_ = static_cast<int>(start);
+    solutionSize_ = static_cast<size_t>(steps);
+    solution_ = reinterpret_cast<const uint64_t *>(bytes + offset);
+  }
+  return true;
+}
+
+int MazeFile::width() const {
+  return width_;
+}
+
+int MazeFile::height() const {
+  return height_;
+}
+
+size_t MazeFile::wordsPerRow() const {
+  return wordsPerRow_;
+}
+
+const uint64_t *MazeFile::wallRow(int y) const {
+  return rows_ + static_cast<size_t>(y) * wordsPerRow_;
+}
+
+bool MazeFile::canTravel(int x, int y, Direction dir) const {
+  if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+    return false;
+  }
+  // Left and up are the right and down walls of the neighbour
+  unsigned bit = dir == RIGHT || dir == LEFT ? 0 : 1;
+  if (dir == LEFT) {
+    x--;
+  } else if (dir == UP) {
+    y--;
+  }
+  if (x < 0 || y < 0 || (dir == RIGHT && x + 1 >= width_) || (dir == DOWN && y + 1 >= height_)) {
+    return false;
+  }
+  const uint64_t *row = wallRow(y);
+  return !((row[x / SquareMaze::CELLS_PER_WORD] >> (2 * (x % SquareMaze::CELLS_PER_WORD) + bit)) & 1);
+}
+
+bool MazeFile::hasSolution() const {
+  return solved_;
+}
+
+int MazeFile::solutionStart() const {
+  return solutionStart_;
+}
+
+size_t MazeFile::solutionSize() const {
+  return solutionSize_;
+}
+
+Direction MazeFile::solutionAt(size_t i) const {
+  uint64_t word = solution_[i / SquareMaze::CELLS_PER_WORD];
+  return static_cast<Direction>((word >> (2 * (i % SquareMaze::CELLS_PER_WORD))) & 0x3);
+}
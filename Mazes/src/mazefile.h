@@ -0,0 +1,107 @@
+/**
+ * @file mazefile.h
+ * Read-only, memory-mapped view of a maze file written by MazeFileSink.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "maze.h"
+
+/**
+ * Maps a maze file into memory and reads the walls and the stored solution
+ * in place.
+ *
+ * Opening a file only checks its header and size; nothing is copied or
+ * decoded, so even a maze of a hundred million cells opens in about the
+ * time of the mmap() call. Pages are read from disk as they are touched.
+ */
+class MazeFile
+{
+public:
+  MazeFile();
+
+  /**
+   * Unmaps the file, if one is open.
+   */
+  ~MazeFile();
+
+  MazeFile(MazeFile const & other) = delete;
+  MazeFile const & operator= (MazeFile const & other) = delete;
+
+  /**
+   * Maps a maze file, closing any file that was open before.
+   * @param fileName Name of the file to be read
+   * @return true, if the file is a complete maze file
+   */
+  bool open(std::string const & fileName);
+
+  /**
+   * Unmaps the file.
+   */
+  void close();
+
+  /**
+   * @return the width of the maze (number of cells)
+   */
+  int width() const;
+
+  /**
+   * @return the height of the maze (number of cells)
+   */
+  int height() const;
+
+  /**
+   * @return the number of words in each packed row
+   */
+  size_t wordsPerRow() const;
+
+  /**
+   * Gets the packed walls of one row, in the layout of
+   * SquareMaze::wallRow().
+   * @param y The row to look at
+   * @return pointer to wordsPerRow() words inside the mapping
+   */
+  const uint64_t *wallRow(int y) const;
+
+  /**
+   * Determines whether you can travel in the given direction from a
+   * square, like SquareMaze::canTravel().
+   */
+  bool canTravel(int x, int y, Direction dir) const;
+
+  /**
+   * @return true, if the file stores a solution
+   */
+  bool hasSolution() const;
+
+  /**
+   * @return the x coordinate of the entrance the solution starts from
+   */
+  int solutionStart() const;
+
+  /**
+   * @return the number of steps in the stored solution
+   */
+  size_t solutionSize() const;
+
+  /**
+   * Gets one step of the stored solution.
+   * @param i The index of the step, below solutionSize()
+   */
+  Direction solutionAt(size_t i) const;
+
+private:
+  void *data_;                 /*< Start of the mapping, or NULL */
+  size_t size_;                /*< Length of the mapping */
+  int width_;                  /*< Width of the maze */
+  int height_;                 /*< Height of the maze */
+  size_t wordsPerRow_;         /*< Words in each row */
+  const uint64_t *rows_;       /*< First word of the wall grid */
+  int solutionStart_;          /*< Entrance column of the solution */
+  size_t solutionSize_;        /*< Steps in the solution, 0 if none */
+  bool solved_;                /*< Whether the file stores a solution */
+  const uint64_t *solution_;   /*< First word of the packed solution */
+};
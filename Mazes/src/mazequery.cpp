@@ -0,0 +1,199 @@
+/**
+ * @file mazequery.cpp
+ * Implementation of constant-time maze distance queries.
+ */
+
+#include "mazequery.h"
+#include "mazeutil.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+  // Cells per block of the Euler tour; one bit of a mask per position
+  const uint32_t BLOCK = 64;
+
+  // Below this many items per thread, threads cost more than they save
+  const size_t PARALLEL_MIN = 1024;
+}
+
+MazeQuery::MazeQuery() : width_(0), height_(0) {}
+
+bool MazeQuery::build(SquareMaze const & maze, unsigned threads) {
+  width_ = maze.width();
+  height_ = maze.height();
+  size_t cells = width_ > 0 && height_ > 0 ? static_cast<size_t>(width_) * height_ : 0;
+  if (cells > MAX_CELLS) {
+    *this = MazeQuery();
+    return false;
+  }
+  depth_.assign(cells, -1);
+  parent_.assign(cells, 0);
+  first_.assign(cells, UNREACHED);
+  euler_.clear();
+  stackMask_.clear();
+  table_.clear();
+  if (cells == 0) {
+    return true;
+  }
+
+  // Euler tour by the same stackless walk as solveMaze: the parent
+  // directions lead back up, so only the current cell is kept. The walk
+  // is inherently sequential and runs on this thread.
+  euler_.reserve(2 * cells - 1);
+  int x = 0, y = 0, depth = 0, dir = 0, back = -1;
+  size_t cell = 0, descents = 0;
+  depth_[0] = 0;
+  first_[0] = 0;
+  euler_.push_back(0);
+  while (true) {
+    unsigned open = maze.openDirections(x, y) & (~0u << dir);
+    if (back >= 0) {
+      open &= ~(1u << back);
+    }
+
+    if (open) {
+      dir = __builtin_ctz(open);
+      if (++descents >= cells) {
+        // More edges than a tree can have: the maze has a loop
+        *this = MazeQuery();
+        return false;
+      }
+      x += DX[dir];
+      y += DY[dir];
+      cell = static_cast<size_t>(y) * width_ + x;
+      back = (dir + 2) % 4;
+      parent_[cell] = back;
+      depth_[cell] = ++depth;
+      first_[cell] = static_cast<uint32_t>(euler_.size());
+      euler_.push_back(static_cast<uint32_t>(cell));
+      dir = 0;
+      continue;
+    }
+
+    if (depth == 0) {
+      break;
+    }
+    x += DX[back];
+    y += DY[back];
+    cell = static_cast<size_t>(y) * width_ + x;
+    --depth;
+    dir = (back + 2) % 4 + 1;
+    back = depth > 0 ? parent_[cell] : -1;
+    euler_.push_back(static_cast<uint32_t>(cell));
+  }
+
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t size = euler_.size();
+  size_t blocks = (size + BLOCK - 1) / BLOCK;
+
+  // Blocks are independent: build each one's minimum stack masks
+  stackMask_.resize(size);
+  table_.emplace_back(blocks);
+  parallelFor(blocks, threads, PARALLEL_MIN, [&](unsigned, size_t begin, size_t end) {
+    for (size_t b = begin; b < end; b++) {
+      size_t start = b * BLOCK;
+      size_t stop = std::min(size, start + BLOCK);
+      uint64_t mask = 0;
+      for (size_t i = start; i < stop; i++) {
+        int d = depth_[euler_[i]];
+        while (mask) {
+          int top = 63 - __builtin_clzll(mask);
+          if (depth_[euler_[start + top]] < d) {
+            break;
+          }
+          mask &= ~(1ULL << top);
+        }
+        mask |= 1ULL << (i - start);
+        stackMask_[i] = mask;
+      }
+      table_[0][b] = _blockMin(static_cast<uint32_t>(start), static_cast<uint32_t>(stop - 1));
+    }
+  });
+
+  // Sparse table over block minima, one level at a time
+  for (size_t span = 1; 2 * span <= blocks; span *= 2) {
+    std::vector<uint32_t> const & below = table_.back();
+    std::vector<uint32_t> level(blocks - 2 * span + 1);
+    parallelFor(level.size(), threads, PARALLEL_MIN, [&](unsigned, size_t begin, size_t end) {
+      for (size_t b = begin; b < end; b++) {
+        level[b] = _shallower(below[b], below[b + span]);
+      }
+    });
+    table_.push_back(std::move(level));
+  }
+  return true;
+}
+
+uint32_t MazeQuery::_shallower(uint32_t a, uint32_t b) const {
+  return depth_[euler_[b]] < depth_[euler_[a]] ? b : a;
+}
+
+uint32_t MazeQuery::_blockMin(uint32_t l, uint32_t r) const {
+  uint32_t start = l & ~(BLOCK - 1);
+  uint64_t mask = stackMask_[r] & (~0ULL << (l - start));
+  return start + __builtin_ctzll(mask);
+}
+
+uint32_t MazeQuery::_rangeMin(uint32_t l, uint32_t r) const {
+  uint32_t bl = l / BLOCK, br = r / BLOCK;
+  if (bl == br) {
+    return _blockMin(l, r);
+  }
+  uint32_t best = _shallower(_blockMin(l, bl * BLOCK + BLOCK - 1), _blockMin(br * BLOCK, r));
+  uint32_t span = br - bl - 1;
+  if (span > 0) {
+    int k = 31 - __builtin_clz(span);
+    std::vector<uint32_t> const & level = table_[k];
+    best = _shallower(best, _shallower(level[bl + 1], level[br - (1u << k)]));
+  }
+  return best;
+}
+
+int MazeQuery::lca(int x1, int y1, int x2, int y2) const {
+  size_t a = static_cast<size_t>(y1) * width_ + x1, b = static_cast<size_t>(y2) * width_ + x2;
+  if (first_[a] == UNREACHED || first_[b] == UNREACHED) {
+    return -1;
+  }
+  uint32_t l = std::min(first_[a], first_[b]);
+  uint32_t r = std::max(first_[a], first_[b]);
+  return static_cast<int>(euler_[_rangeMin(l, r)]);
+}
+
+int MazeQuery::distance(int x1, int y1, int x2, int y2) const {
+  int meet = lca(x1, y1, x2, y2);
+  if (meet < 0) {
+    return -1;
+  }
+  return depth_[y1 * width_ + x1] + depth_[y2 * width_ + x2] - 2 * depth_[meet];
+}
+
+std::vector<Direction> MazeQuery::path(int x1, int y1, int x2, int y2) const {
+  int meet = lca(x1, y1, x2, y2);
+  if (meet < 0) {
+    return std::vector<Direction>();
+  }
+
+  int a = y1 * width_ + x1, b = y2 * width_ + x2;
+  std::vector<Direction> steps(depth_[a] + depth_[b] - 2 * depth_[meet]);
+
+  // Climb from the first cell up to the meeting point...
+  size_t i = 0;
+  for (int x = x1, y = y1; y * width_ + x != meet; i++) {
+    int up = parent_[y * width_ + x];
+    steps[i] = static_cast<Direction>(up);
+    x += DX[up];
+    y += DY[up];
+  }
+  // ...then fill in the way down to the second cell from its end
+  size_t j = steps.size();
+  for (int x = x2, y = y2; y * width_ + x != meet; ) {
+    int up = parent_[y * width_ + x];
+    steps[--j] = static_cast<Direction>((up + 2) % 4);
+    x += DX[up];
+    y += DY[up];
+  }
+  return steps;
+}
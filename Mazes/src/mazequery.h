@@ -0,0 +1,103 @@
+/**
+ * @file mazequery.h
+ * Constant-time distance queries between any two cells of a perfect maze.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "maze.h"
+
+/**
+ * Answers distance and path queries on one fixed perfect maze.
+ *
+ * The maze is rooted at cell (0, 0). build() records the depth and parent
+ * direction of every cell and an Euler tour of the tree. The lowest common
+ * ancestor of two cells is the shallowest cell of the tour between their
+ * first visits, found with a range-minimum structure: the tour is cut into
+ * blocks of 64 positions, a sparse table covers the block minima, and
+ * inside a block a 64-bit mask per position (the minimum stack seen from
+ * that position) answers in one count-trailing-zeros. Distance is then
+ * depth(a) + depth(b) - 2 depth(lca).
+ */
+class MazeQuery
+{
+public:
+  /**
+   * Largest maze build() accepts. The tour visits 2 * cells - 1 positions,
+   * which are stored as 32-bit indices.
+   */
+  static constexpr size_t MAX_CELLS = size_t(1) << 31;
+
+  /**
+   * Creates an empty query structure; call build() before querying.
+   */
+  MazeQuery();
+
+  /**
+   * Preprocesses a maze. Runs in time linear in the number of cells. The
+   * Euler tour is walked on the calling thread; the range-minimum tables
+   * are built on several threads.
+   *
+   * @param maze The maze to answer queries for; it must be a tree of at
+   *  most MAX_CELLS cells
+   * @param threads Number of worker threads; 0 uses
+   *  std::thread::hardware_concurrency()
+   * @return true, if the maze is acyclic and not too large. Cells that
+   *  cannot be reached from (0, 0) are allowed, and are at distance -1
+   *  from everything else.
+   */
+  bool build(SquareMaze const & maze, unsigned threads = 0);
+
+  /**
+   * Gets the length of the path between two cells in O(1).
+   * @return the number of steps, or -1 if there is no path
+   */
+  int distance(int x1, int y1, int x2, int y2) const;
+
+  /**
+   * Gets the path between two cells in O(path length).
+   * @return the directions leading from (x1, y1) to (x2, y2), or an empty
+   *  vector if there is no path
+   */
+  std::vector<Direction> path(int x1, int y1, int x2, int y2) const;
+
+  /**
+   * Gets the lowest common ancestor of two cells in the tree rooted at
+   * (0, 0), i.e. the place where the paths from the two cells to (0, 0)
+   * meet.
+   * @return the cell index y * width + x, or -1 if either cell is
+   *  unreachable
+   */
+  int lca(int x1, int y1, int x2, int y2) const;
+
+private:
+  int width_;                         /*< Width of the maze */
+  int height_;                        /*< Height of the maze */
+  std::vector<int> depth_;            /*< Depth of each cell, -1 if unreached */
+  std::vector<uint8_t> parent_;       /*< Direction from each cell to its parent */
+  std::vector<uint32_t> first_;       /*< First position of each cell in the tour, UNREACHED if none */
+  std::vector<uint32_t> euler_;       /*< Cells in Euler tour order */
+  std::vector<uint64_t> stackMask_;   /*< In-block minimum stack per position */
+  std::vector<std::vector<uint32_t>> table_; /*< Sparse table of block minimum positions */
+
+  static constexpr uint32_t UNREACHED = UINT32_MAX;
+
+  /**
+   * Gets the tour position of the minimum depth in [l, r].
+   */
+  uint32_t _rangeMin(uint32_t l, uint32_t r) const;
+
+  /**
+   * Gets the tour position of the minimum depth in [l, r], which must lie
+   * within one block.
+   */
+  uint32_t _blockMin(uint32_t l, uint32_t r) const;
+
+  /**
+   * Picks the shallower of two tour positions.
+   */
+  uint32_t _shallower(uint32_t a, uint32_t b) const;
+};
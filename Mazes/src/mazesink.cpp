@@ -0,0 +1,276 @@
+/**
+ * @file mazesink.cpp
+ * Implementation of the maze row sinks.
+ */
+
+#include "mazesink.h"
+#include "maze.h"
+#include "mazeutil.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+  // Palette indices of the drawn maze
+  const unsigned char BLACK = 0;
+  const unsigned char WHITE = 1;
+  const unsigned char RED = 2;
+
+  // A trail entry holds the cell index above these bits: one bit for each
+  // direction the red line leaves the cell in, and one for its center
+  const unsigned TRAIL_CENTER = 1u << 4;
+  const unsigned TRAIL_SHIFT = 5;
+
+  inline bool hasWall(const uint64_t *walls, int x, unsigned bit) {
+    return (walls[x / SquareMaze::CELLS_PER_WORD] >> (2 * (x % SquareMaze::CELLS_PER_WORD) + bit)) & 1;
+  }
+}
+
+MazeFileSink::MazeFileSink(std::string const & fileName)
+  : fileName_(fileName), wordsPerRow_(0), solved_(false), start_(0) {}
+
+void MazeFileSink::setSolution(int start, std::vector<Direction> const & path) {
+  solved_ = true;
+  start_ = start;
+  path_ = path;
+}
+
+bool MazeFileSink::begin(int width, int height) {
+  out_.open(fileName_, std::ios::binary | std::ios::trunc);
+  if (!out_) {
+    std::cerr << "Unable to open " << fileName_ << std::endl;
+    return false;
+  }
+
+  wordsPerRow_ = (static_cast<size_t>(width) + SquareMaze::CELLS_PER_WORD - 1) / SquareMaze::CELLS_PER_WORD;
+  unsigned char header[32] = {0};
+  const uint32_t version = 1;
+  const uint32_t w = width, h = height;
+  const uint32_t flags = solved_ ? 1 : 0;
+  const uint64_t words = wordsPerRow_;
+  std::memcpy(header, "CS225MAZ", 8);
+  std::memcpy(header + 8, &version, 4);
+  std::memcpy(header + 12, &w, 4);
+  std::memcpy(header + 16, &h, 4);
+  std::memcpy(header + 20, &flags, 4);
+  std::memcpy(header + 24, &words, 8);
+  out_.write(reinterpret_cast<const char *>(header), sizeof(header));
+  return out_.good();
+}
+
+bool MazeFileSink::writeRow(const uint64_t *walls) {
+  out_.write(reinterpret_cast<const char *>(walls), wordsPerRow_ * sizeof(uint64_t));
+  return out_.good();
+}
+
+bool MazeFileSink::finish() {
+  if (solved_) {
+    unsigned char header[16] = {0};
+    const uint32_t start = start_;
+    const uint64_t steps = path_.size();
+    std::memcpy(header, &start, 4);
+    std::memcpy(header + 8, &steps, 8);
+    out_.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+    std::vector<uint64_t> packed((path_.size() + SquareMaze::CELLS_PER_WORD - 1) / SquareMaze::CELLS_PER_WORD, 0);
+    for (size_t i = 0; i < path_.size(); i++) {
+      packed[i / SquareMaze::CELLS_PER_WORD] |= static_cast<uint64_t>(path_[i]) << (2 * (i % SquareMaze::CELLS_PER_WORD));
+    }
+    out_.write(reinterpret_cast<const char *>(packed.data()), packed.size() * sizeof(uint64_t));
+  }
+  out_.close();
+  return !out_.fail();
+}
+
+MazeImageSink::MazeImageSink(std::string const & fileName, int start, int cellSize)
+  : fileName_(fileName), start_(start), cellSize_(cellSize), width_(0), height_(0), rows_(0),
+    bitDepth_(1), solved_(false), exitX_(0), exitY_(-1), trailPos_(0), encoder_(NULL) {}
+
+MazeImageSink::~MazeImageSink() {
+  delete encoder_;
+}
+
+void MazeImageSink::setSolution(std::vector<Direction> const & path) {
+  path_ = path;
+  solved_ = true;
+}
+
+bool MazeImageSink::begin(int width, int height) {
+  if (cellSize_ < 2 || start_ < 0 || start_ >= width) {
+    std::cerr << "Cannot draw a maze with cell size " << cellSize_ << " and entrance " << start_ << std::endl;
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  rows_ = 0;
+
+  // Sorted by cell, so each row's part of the path is one run of entries
+  trail_.clear();
+  trailPos_ = 0;
+  exitY_ = -1;
+  if (solved_) {
+    int x = start_, y = 0;
+    trail_.reserve(2 * path_.size() + 1);
+    trail_.push_back(static_cast<uint64_t>(x) << TRAIL_SHIFT | TRAIL_CENTER);
+    for (Direction dir : path_) {
+      uint64_t cell = static_cast<uint64_t>(y) * width_ + x;
+      trail_.push_back(cell << TRAIL_SHIFT | 1u << dir);
+      x += DX[dir];
+      y += DY[dir];
+      if (x < 0 || x >= width_ || y < 0 || y >= height_) {
+        std::cerr << "The solution leaves the maze" << std::endl;
+        return false;
+      }
+      cell = static_cast<uint64_t>(y) * width_ + x;
+      trail_.push_back(cell << TRAIL_SHIFT | TRAIL_CENTER | 1u << (dir + 2) % 4);
+    }
+    exitX_ = x;
+    exitY_ = y;
+
+    std::sort(trail_.begin(), trail_.end());
+    size_t count = 0;
+    for (size_t i = 0; i < trail_.size(); i++) {
+      if (count > 0 && trail_[count - 1] >> TRAIL_SHIFT == trail_[i] >> TRAIL_SHIFT) {
+        trail_[count - 1] |= trail_[i];
+      } else {
+        trail_[count++] = trail_[i];
+      }
+    }
+    trail_.resize(count);
+  }
+
+  size_t lineWidth = static_cast<size_t>(width_) * cellSize_ + 1;
+  bitDepth_ = solved_ ? 2 : 1;
+  delete encoder_;
+  encoder_ = new cs225::PNGEncoder(fileName_, lineWidth, static_cast<unsigned>(height_) * cellSize_ + 1,
+                                   cs225::PNGColorType::PALETTE, bitDepth_);
+  // Black and white, then red when there is a solution to draw
+  std::vector<unsigned char> palette = {0, 0, 0, 255, 255, 255, 255, 255, 255, 0, 0, 255};
+  palette.resize(solved_ ? 12 : 8);
+  encoder_->setPalette(palette);
+
+  previous_.assign((static_cast<size_t>(width_) + SquareMaze::CELLS_PER_WORD - 1) / SquareMaze::CELLS_PER_WORD, ~0ULL);
+  line_.assign(lineWidth, WHITE);
+  pixels_.assign(encoder_->rowBytes() * cellSize_, 0);
+
+  // Top border, with the entrance above the start cell
+  std::fill(line_.begin(), line_.end(), BLACK);
+  std::fill(line_.begin() + start_ * cellSize_ + 1, line_.begin() + (start_ + 1) * cellSize_, WHITE);
+  _pack(pixels_.data());
+  return encoder_->writeRows(pixels_.data(), 1);
+}
+
+void MazeImageSink::_pack(unsigned char *out) const {
+  unsigned perByte = 8 / bitDepth_;
+  std::memset(out, 0, encoder_->rowBytes());
+  for (size_t i = 0; i < line_.size(); i++) {
+    out[i / perByte] |= line_[i] << (8 - bitDepth_ * (i % perByte + 1));
+  }
+}
+
+void MazeImageSink::_boundaryLine(const uint64_t *next, size_t trail, size_t trailEnd) {
+  const uint64_t *walls = previous_.data();
+  int c = cellSize_;
+  line_[0] = BLACK;
+  for (int x = 0; x < width_; x++) {
+    std::fill(line_.begin() + x * c + 1, line_.begin() + (x + 1) * c, hasWall(walls, x, 1) ? BLACK : WHITE);
+
+    // The corner right of the cell touches four possible walls
+    bool corner = hasWall(walls, x, 0) || hasWall(walls, x, 1)
+               || (x + 1 < width_ && hasWall(walls, x + 1, 1))
+               || (next != NULL && hasWall(next, x, 0));
+    line_[(x + 1) * c] = corner ? BLACK : WHITE;
+  }
+
+  // The red line crossing up into the row below
+  size_t rowStart = static_cast<size_t>(rows_) * width_;
+  for (size_t i = trail; i < trailEnd; i++) {
+    if (trail_[i] & 1u << UP) {
+      line_[((trail_[i] >> TRAIL_SHIFT) - rowStart) * c + c / 2] = RED;
+    }
+  }
+
+  if (exitY_ == rows_ - 1) {
+    std::fill(line_.begin() + exitX_ * c + 1, line_.begin() + (exitX_ + 1) * c, WHITE);
+  }
+}
+
+bool MazeImageSink::writeRow(const uint64_t *walls) {
+  if (encoder_ == NULL || rows_ >= height_) {
+    return false;
+  }
+
+  int c = cellSize_, half = cellSize_ / 2;
+  size_t rowBytes = encoder_->rowBytes();
+  size_t rowStart = static_cast<size_t>(rows_) * width_;
+  size_t trail = trailPos_, trailEnd = trailPos_;
+  while (trailEnd < trail_.size() && (trail_[trailEnd] >> TRAIL_SHIFT) < rowStart + width_) {
+    trailEnd++;
+  }
+
+  // Scanline k of the row goes to pixels_ line k; line 0 is the boundary
+  // above the row, which the top border replaces in the first row
+  if (rows_ > 0) {
+    _boundaryLine(walls, trail, trailEnd);
+    _pack(pixels_.data());
+  }
+
+  // The lines crossing the cells differ only in the red line: vertical
+  // above the centers, through the centers, and vertical below them
+  std::fill(line_.begin(), line_.end(), WHITE);
+  line_[0] = BLACK;
+  for (int x = 0; x < width_; x++) {
+    if (hasWall(walls, x, 0)) {
+      line_[(x + 1) * c] = BLACK;
+    }
+  }
+  const unsigned parts[2] = {1u << UP, 1u << DOWN};
+  const int firstLine[2] = {1, half + 1};
+  const int lastLine[2] = {half, c};
+  for (int part = 0; part < 2; part++) {
+    if (firstLine[part] >= lastLine[part]) {
+      continue;
+    }
+    for (size_t i = trail; i < trailEnd; i++) {
+      if (trail_[i] & parts[part]) {
+        line_[((trail_[i] >> TRAIL_SHIFT) - rowStart) * c + half] = RED;
+      }
+    }
+    unsigned char *first = pixels_.data() + firstLine[part] * rowBytes;
+    _pack(first);
+    for (int k = firstLine[part] + 1; k < lastLine[part]; k++) {
+      std::memcpy(pixels_.data() + k * rowBytes, first, rowBytes);
+    }
+    for (size_t i = trail; i < trailEnd; i++) {
+      line_[((trail_[i] >> TRAIL_SHIFT) - rowStart) * c + half] = WHITE;
+    }
+  }
+  for (size_t i = trail; i < trailEnd; i++) {
+    size_t x = (trail_[i] >> TRAIL_SHIFT) - rowStart;
+    unsigned bits = trail_[i];
+    size_t left = x * c + (bits & 1u << LEFT ? 0 : half);
+    size_t right = x * c + (bits & 1u << RIGHT ? c : half);
+    std::fill(line_.begin() + left, line_.begin() + right + 1, RED);
+  }
+  _pack(pixels_.data() + half * rowBytes);
+
+  std::copy(walls, walls + previous_.size(), previous_.begin());
+  trailPos_ = trailEnd;
+  unsigned char *rows = rows_ > 0 ? pixels_.data() : pixels_.data() + rowBytes;
+  unsigned lines = rows_ > 0 ? c : c - 1;
+  rows_++;
+  return encoder_->writeRows(rows, lines);
+}
+
+bool MazeImageSink::finish() {
+  if (encoder_ == NULL || rows_ != height_) {
+    return false;
+  }
+  _boundaryLine(NULL, trailPos_, trailPos_);
+  _pack(pixels_.data());
+  bool ok = encoder_->writeRows(pixels_.data(), 1) && encoder_->finish();
+  delete encoder_;
+  encoder_ = NULL;
+  return ok;
+}
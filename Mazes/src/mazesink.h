@@ -0,0 +1,157 @@
+/**
+ * @file mazesink.h
+ * Destinations for mazes that are produced one row of walls at a time.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cs225/PNGEncoder.h"
+#include "maze.h"
+
+/**
+ * Receives the wall rows of a maze from top to bottom.
+ *
+ * Each row is passed in the packed layout of SquareMaze::wallRow(): two
+ * bits per cell (right wall, then down wall), CELLS_PER_WORD cells per
+ * word, with the bits past the last cell set.
+ */
+class MazeSink
+{
+public:
+  virtual ~MazeSink() {}
+
+  /**
+   * Called once before the first row.
+   * @param width The width of the maze (number of cells)
+   * @param height The height of the maze (number of cells)
+   * @return true, if the sink is ready for rows
+   */
+  virtual bool begin(int width, int height) = 0;
+
+  /**
+   * Called once per row, in order from y = 0.
+   * @param walls The packed walls of the row
+   * @return true, if the row was accepted
+   */
+  virtual bool writeRow(const uint64_t *walls) = 0;
+
+  /**
+   * Called once after the last row.
+   * @return true, if the whole maze was written
+   */
+  virtual bool finish() = 0;
+};
+
+/**
+ * Writes the packed wall grid to a file, which MazeFile can map back in.
+ *
+ * The file starts with a 32-byte header: the magic "CS225MAZ", a uint32
+ * version, uint32 width and height, uint32 flags and the uint64 number of
+ * words per row. The rows follow as native-endian uint64 words.
+ *
+ * If flag bit 0 is set, a solution follows the rows: a uint32 start
+ * column, 4 reserved bytes, the uint64 number of steps, and the steps
+ * packed like the walls, 2 bits per Direction and 32 steps per word.
+ */
+class MazeFileSink : public MazeSink
+{
+public:
+  /**
+   * @param fileName Name of the file to be written
+   */
+  MazeFileSink(std::string const & fileName);
+
+  /**
+   * Stores a solution after the rows. Must be called before begin().
+   * @param start The x coordinate of the entrance in the top row
+   * @param path The directions taken from the entrance cell
+   */
+  void setSolution(int start, std::vector<Direction> const & path);
+
+  bool begin(int width, int height) override;
+  bool writeRow(const uint64_t *walls) override;
+  bool finish() override;
+
+private:
+  std::string fileName_;         /*< Name of the output file */
+  std::ofstream out_;            /*< Output file */
+  size_t wordsPerRow_;           /*< Words in each row */
+  bool solved_;                  /*< Whether a solution was set */
+  int start_;                    /*< Entrance column of the solution */
+  std::vector<Direction> path_;  /*< Solution to store */
+};
+
+/**
+ * Draws the maze into a palette PNG file as its rows arrive, using the
+ * layout of SquareMaze::drawMaze() scaled to any cell size, without ever
+ * holding the image.
+ *
+ * Pixels are palette indices: black and white at one bit per pixel, or
+ * black, white and red at two bits per pixel once a solution is set. The
+ * line of pixels between two maze rows depends on both of them, so the
+ * sink keeps the previous row of walls, the scanlines of one maze row and
+ * the cells of the solution path.
+ */
+class MazeImageSink : public MazeSink
+{
+public:
+  /**
+   * @param fileName Name of the PNG file to be written
+   * @param start The x coordinate of the entrance in the top row
+   * @param cellSize Pixels from one wall line to the next; at least 2.
+   *  drawMaze() uses 10.
+   */
+  MazeImageSink(std::string const & fileName, int start = 0, int cellSize = 10);
+
+  ~MazeImageSink();
+
+  /**
+   * Draws a solution like SquareMaze::drawMazeWithSolution(): a red line
+   * through the centers of the cells it visits from the entrance, and an
+   * exit in the bottom wall of the last cell. Must be called before
+   * begin().
+   * @param path The directions taken from the entrance cell
+   */
+  void setSolution(std::vector<Direction> const & path);
+
+  bool begin(int width, int height) override;
+  bool writeRow(const uint64_t *walls) override;
+  bool finish() override;
+
+private:
+  std::string fileName_;                 /*< Name of the output file */
+  int start_;                            /*< Entrance column */
+  int cellSize_;                         /*< Pixels per cell, one wall line included */
+  int width_;                            /*< Width of the maze in cells */
+  int height_;                           /*< Height of the maze in cells */
+  int rows_;                             /*< Maze rows received so far */
+  unsigned bitDepth_;                    /*< Bits per palette index */
+  std::vector<Direction> path_;          /*< Solution to draw, if any */
+  bool solved_;                          /*< Whether a solution was set */
+  int exitX_;                            /*< Cell whose bottom wall is the exit */
+  int exitY_;                            /*< Row of that cell, -1 for none */
+  std::vector<uint64_t> trail_;          /*< Sorted cell << 5 | TRAIL_* bits */
+  size_t trailPos_;                      /*< First trail_ entry not yet drawn */
+  std::vector<uint64_t> previous_;       /*< Walls of the previous row */
+  std::vector<unsigned char> line_;      /*< One scanline, a byte per pixel */
+  std::vector<unsigned char> pixels_;    /*< Packed scanlines of one maze row */
+  cs225::PNGEncoder *encoder_;           /*< Encoder, between begin and finish */
+
+  /**
+   * Fills line_ with the line of pixels below the previous row.
+   * @param next The walls of the row below, or NULL after the last row
+   * @param trail The trail entries of the row below
+   * @param trailEnd End of those entries
+   */
+  void _boundaryLine(const uint64_t *next, size_t trail, size_t trailEnd);
+
+  /**
+   * Packs line_ into one scanline of the encoder's format.
+   */
+  void _pack(unsigned char *out) const;
+};
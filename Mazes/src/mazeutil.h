@@ -0,0 +1,37 @@
+/**
+ * @file mazeutil.h
+ * Helpers shared by the maze sources: direction vectors and splitting a
+ * loop over threads.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Direction vectors corresponding to RIGHT, DOWN, LEFT, UP
+constexpr int DX[4] = {1, 0, -1, 0};
+constexpr int DY[4] = {0, 1, 0, -1};
+
+/**
+ * Runs body(thread, begin, end) over [0, count), split into one range per
+ * thread. The calling thread takes the first range.
+ * @param count The number of items
+ * @param threads The most threads to use
+ * @param minPerThread Fewer threads are used so that each gets at least
+ *  this many items; smaller loops run on the calling thread alone
+ * @param body Called once per thread with its index and range
+ */
+template <typename Body>
+void parallelFor(size_t count, unsigned threads, size_t minPerThread, Body body) {
+  threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count / std::max<size_t>(minPerThread, 1))));
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; t++) {
+    pool.emplace_back(body, t, count * t / threads, count * (t + 1) / threads);
+  }
+  body(0u, size_t(0), count / threads);
+  for (std::thread & thread : pool) {
+    thread.join();
+  }
+}
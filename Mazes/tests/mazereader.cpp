@@ -1,4 +1,5 @@
 #include "mazereader.h"
+#include "mazefile.h"
 
 MazeReader::MazeReader(const PNG & image)
 	: width((image.width() - 1) / 10),
@@ -12,9 +13,9 @@ MazeReader::MazeReader(const PNG & image)
 		{
 			//Check if pixel is black
 			if (image.getPixel(x * 10 + 10, y * 10 + 5).l == 0)
-				walls[y*height + x] |= RIGHTWALL;
+				walls[y*width + x] |= RIGHTWALL;
 			if (image.getPixel(x*10 + 5, y * 10 + 10).l == 0)
-				walls[y*height + x] |= DOWNWALL;
+				walls[y*width + x] |= DOWNWALL;
 		}
 	}
 
@@ -50,6 +51,40 @@ MazeReader::MazeReader(const PNG & image)
 	destination_y = y;
 }
 
+// Reads a maze saved with its solution; no image is decoded
+MazeReader::MazeReader(const string & mazeFile)
+	: width(0), height(0), destination_x(0), destination_y(0)
+{
+	MazeFile file;
+	if (!file.open(mazeFile))
+		return;
+
+	width = file.width();
+	height = file.height();
+	walls.resize(width * height);
+	for (int y = 0; y < height; y++)
+	{
+		const uint64_t *row = file.wallRow(y);
+		for (int x = 0; x < width; x++)
+			walls[y*width + x] = (row[x / SquareMaze::CELLS_PER_WORD] >> (2 * (x % SquareMaze::CELLS_PER_WORD))) & BOTHWALLS;
+	}
+
+	int x = file.solutionStart();
+	int y = 0;
+	solution.resize(file.solutionSize());
+	for (size_t i = 0; i < solution.size(); i++)
+	{
+		solution[i] = static_cast<dir_t>(file.solutionAt(i));
+		if (solution[i] == RIGHT) x++;
+		else if (solution[i] == DOWN) y++;
+		else if (solution[i] == LEFT) x--;
+		else y--;
+	}
+
+	destination_x = x;
+	destination_y = y;
+}
+
 bool MazeReader::isWallInDir(int x, int y, int dir) const
 {
 	if (dir == LEFT) { x--; dir = RIGHT; }
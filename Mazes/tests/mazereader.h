@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 #include "cs225/PNG.h"
 #include "cs225/HSLAPixel.h"
@@ -47,7 +48,8 @@ class MazeReader
 
 	public:
 	MazeReader(const PNG & image);
-	bool isWall(int x, int y, wall_t wall) const { return (walls[y*height + x] & wall) != 0; }
+	MazeReader(const string & mazeFile);
+	bool isWall(int x, int y, wall_t wall) const { return (walls[y*width + x] & wall) != 0; }
 	bool isWallInDir(int x, int y, int dir) const;
 	int getWidth() const { return width; }
 	int getHeight() const { return height; }
@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "concurrentdsets.h"
+#include "dsets.h"
+
+TEST_CASE("Equal sized unions point the second root at the first", "[dsets]") {
+  DisjointSets sets;
+  sets.addelements(4);
+  sets.setunion(0, 1);
+  REQUIRE( sets.getValue(1) == 0 );
+  sets.setunion(3, 2);
+  REQUIRE( sets.getValue(2) == 3 );
+  sets.setunion(2, 0);
+  REQUIRE( sets.getValue(0) == 3 );
+  REQUIRE( sets.size(1) == 4 );
+}
+
+TEST_CASE("Batch operations match one at a time", "[dsets]") {
+  const int n = 5000;
+  std::vector<std::pair<int, int>> pairs;
+  for (int i = 0; i + 7 < n; i += 3) {
+    pairs.emplace_back(i, (i * 37 + 11) % n);
+    pairs.emplace_back(i + 7, i);
+  }
+
+  DisjointSets single, batch;
+  single.addelements(n);
+  batch.addelements(n);
+  int joined = 0;
+  for (auto const & p : pairs) {
+    if (single.find(p.first) != single.find(p.second)) { joined++; }
+    single.setunion(p.first, p.second);
+  }
+  REQUIRE( batch.unionMany(pairs) == joined );
+
+  std::vector<int> elems, roots;
+  for (int i = 0; i < n; i++) { elems.push_back((i * 7919) % n); }
+  batch.findMany(elems, roots);
+  REQUIRE( roots.size() == elems.size() );
+  for (size_t i = 0; i < elems.size(); i++) {
+    REQUIRE( roots[i] == batch.find(elems[i]) );
+    REQUIRE( (single.find(elems[i]) == single.find(0)) == (roots[i] == batch.find(0)) );
+  }
+}
+
+TEST_CASE("Reset starts over with unconnected elements", "[dsets]") {
+  DisjointSets sets;
+  sets.addelements(10);
+  sets.setunion(2, 3);
+  sets.reset(6);
+  for (int i = 0; i < 6; i++) {
+    REQUIRE( sets.find(i) == i );
+    REQUIRE( sets.size(i) == 1 );
+  }
+  sets.addelements(1);
+  REQUIRE( sets.find(6) == 6 );
+}
+
+TEST_CASE("Concurrent unions build the same partition as serial ones", "[dsets]") {
+  const int width = 120, height = 90, n = width * height;
+  std::vector<std::pair<int, int>> pairs;
+  for (int cell = 0; cell < n; cell++) {
+    if (cell % width + 1 < width && (cell * 2654435761u) % 3) { pairs.emplace_back(cell, cell + 1); }
+    if (cell + width < n && (cell * 40503u) % 5 < 2) { pairs.emplace_back(cell, cell + width); }
+  }
+
+  DisjointSets serial;
+  serial.reset(n);
+  int joined = serial.unionMany(pairs);
+
+  const unsigned numThreads = 8;
+  ConcurrentDisjointSets sets(n);
+  std::vector<int> joinedBy(numThreads);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < numThreads; t++) {
+    threads.emplace_back([&, t]() {
+      // Interleave the pairs so threads keep hitting the same regions
+      for (size_t i = t; i < pairs.size(); i += numThreads) {
+        joinedBy[t] += sets.setunion(pairs[i].first, pairs[i].second);
+      }
+    });
+  }
+  for (std::thread & thread : threads) { thread.join(); }
+
+  int total = 0;
+  for (int count : joinedBy) { total += count; }
+  REQUIRE( total == joined );
+  for (int cell = 0; cell < n; cell += 7) {
+    int other = (cell * 31 + 5) % n;
+    REQUIRE( sets.sameSet(cell, other) == (serial.find(cell) == serial.find(other)) );
+  }
+  REQUIRE_FALSE( sets.setunion(pairs[0].first, pairs[0].second) );
+}
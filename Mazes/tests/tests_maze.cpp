@@ -0,0 +1,456 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <queue>
+#include <vector>
+
+#include "cs225/PNG.h"
+#include "maze.h"
+#include "mazefile.h"
+#include "mazequery.h"
+#include "mazereader.h"
+#include "mazesink.h"
+
+namespace {
+  // A maze is perfect if it is connected and has one passage less than cells.
+  bool isPerfect(SquareMaze const & maze, int width, int height) {
+    size_t passages = 0;
+    for (int y = 0; y < height; y++) {
+      passages += maze.countPassages(y, RIGHT) + maze.countPassages(y, DOWN);
+    }
+
+    const int dx[4] = {1, 0, -1, 0}, dy[4] = {0, 1, 0, -1};
+    std::vector<bool> seen((size_t)width * height);
+    std::queue<int> queue;
+    queue.push(0);
+    seen[0] = true;
+    size_t reached = 0;
+    while (!queue.empty()) {
+      int cell = queue.front();
+      queue.pop();
+      reached++;
+      int x = cell % width, y = cell / width;
+      for (int d = 0; d < 4; d++) {
+        int next = (y + dy[d]) * width + x + dx[d];
+        if (maze.canTravel(x, y, Direction(d)) && !seen[next]) {
+          seen[next] = true;
+          queue.push(next);
+        }
+      }
+    }
+    return reached == seen.size() && passages == seen.size() - 1;
+  }
+
+  // Checks a solution against distances from a plain breadth-first search.
+  bool solvesFarthest(SquareMaze const & maze, int width, int height, int startX,
+                      std::vector<Direction> const & path) {
+    const int dx[4] = {1, 0, -1, 0}, dy[4] = {0, 1, 0, -1};
+    std::vector<int> distance((size_t)width * height, -1);
+    std::queue<int> queue;
+    distance[startX] = 0;
+    queue.push(startX);
+    while (!queue.empty()) {
+      int cell = queue.front();
+      queue.pop();
+      int x = cell % width, y = cell / width;
+      for (int d = 0; d < 4; d++) {
+        int next = (y + dy[d]) * width + x + dx[d];
+        if (maze.canTravel(x, y, Direction(d)) && distance[next] < 0) {
+          distance[next] = distance[cell] + 1;
+          queue.push(next);
+        }
+      }
+    }
+
+    int best = 0;
+    for (int x = 1; x < width; x++) {
+      if (distance[(height - 1) * width + x] > distance[(height - 1) * width + best]) { best = x; }
+    }
+    int x = startX, y = 0;
+    for (Direction dir : path) {
+      if (!maze.canTravel(x, y, dir)) { return false; }
+      x += dx[dir];
+      y += dy[dir];
+    }
+    return x == best && y == height - 1 && (int)path.size() == distance[(height - 1) * width + best];
+  }
+
+  // Copies the streamed rows into an in-memory maze.
+  class CollectSink : public MazeSink {
+  public:
+    SquareMaze maze;
+    int width = 0, height = 0, rows = 0;
+
+    bool begin(int w, int h) override {
+      width = w;
+      height = h;
+      maze.makeMaze(w, h);
+      return true;
+    }
+    bool writeRow(const uint64_t * walls) override {
+      for (int x = 0; x < width; x++) {
+        uint64_t bits = walls[x / SquareMaze::CELLS_PER_WORD] >> (2 * (x % SquareMaze::CELLS_PER_WORD));
+        maze.setWall(x, rows, RIGHT, bits & 1);
+        maze.setWall(x, rows, DOWN, bits & 2);
+      }
+      rows++;
+      return true;
+    }
+    bool finish() override { return rows == height; }
+  };
+}
+
+TEST_CASE("Packed wall grid keeps rows independent", "[maze]") {
+  const int width = 70, height = 3;
+  SquareMaze maze;
+  maze.makeMaze(width, height);
+  REQUIRE( maze.wordsPerRow() == 3 );
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      maze.setWall(x, y, RIGHT, true);
+      maze.setWall(x, y, DOWN, true);
+    }
+  }
+  for (int y = 0; y < height; y++) {
+    REQUIRE( maze.countPassages(y, RIGHT) == 0 );
+    REQUIRE( maze.countPassages(y, DOWN) == 0 );
+  }
+
+  maze.setWall(31, 1, RIGHT, false);
+  maze.setWall(32, 1, DOWN, false);
+  maze.setWall(69, 0, DOWN, false);
+  REQUIRE( maze.canTravel(31, 1, RIGHT) );
+  REQUIRE( maze.canTravel(32, 1, LEFT) );
+  REQUIRE( maze.canTravel(32, 2, UP) );
+  REQUIRE( maze.canTravel(69, 1, UP) );
+  REQUIRE_FALSE( maze.canTravel(32, 1, RIGHT) );
+  REQUIRE_FALSE( maze.canTravel(31, 0, RIGHT) );
+  REQUIRE( maze.countPassages(1, RIGHT) == 1 );
+  REQUIRE( maze.countPassages(1, DOWN) == 1 );
+  REQUIRE( maze.countPassages(0, DOWN) == 1 );
+  REQUIRE( maze.countPassages(2, DOWN) == 0 );
+}
+
+TEST_CASE("Generated maze has one passage less than it has cells", "[maze]") {
+  const int width = 45, height = 37;
+  SquareMaze maze;
+  maze.makeMaze(width, height);
+
+  size_t passages = 0;
+  for (int y = 0; y < height; y++) {
+    passages += maze.countPassages(y, RIGHT) + maze.countPassages(y, DOWN);
+    REQUIRE_FALSE( maze.canTravel(width - 1, y, RIGHT) );
+  }
+  REQUIRE( passages == (size_t)width * height - 1 );
+  REQUIRE( maze.countPassages(height - 1, DOWN) == 0 );
+}
+
+TEST_CASE("Making a second maze starts from fresh sets", "[maze]") {
+  SquareMaze maze;
+  maze.makeMaze(30, 20);
+  maze.makeMaze(12, 40);
+  REQUIRE( isPerfect(maze, 12, 40) );
+  maze.makeMaze(33, 33);
+  REQUIRE( isPerfect(maze, 33, 33) );
+}
+
+TEST_CASE("Parallel generation stitches blocks into a perfect maze", "[maze]") {
+  SquareMaze maze;
+  maze.makeMazeParallel(300, 170, 4, 64);
+  REQUIRE( isPerfect(maze, 300, 170) );
+
+  maze.makeMazeParallel(47, 5, 3, 1);
+  REQUIRE( isPerfect(maze, 47, 5) );
+
+  maze.makeMazeParallel(1, 1);
+  REQUIRE( isPerfect(maze, 1, 1) );
+}
+
+TEST_CASE("Streaming generation produces a perfect maze", "[maze]") {
+  CollectSink sink;
+  REQUIRE( SquareMaze::makeMazeStreaming(70, 41, sink) );
+  REQUIRE( sink.rows == 41 );
+  REQUIRE( isPerfect(sink.maze, 70, 41) );
+
+  CollectSink column;
+  REQUIRE( SquareMaze::makeMazeStreaming(1, 9, column) );
+  REQUIRE( isPerfect(column.maze, 1, 9) );
+
+  MazeFileSink file("stream-actual.maze");
+  REQUIRE( SquareMaze::makeMazeStreaming(70, 41, file) );
+  std::ifstream in("stream-actual.maze", std::ios::binary | std::ios::ate);
+  REQUIRE( (size_t)in.tellg() == 32 + 41 * 3 * sizeof(uint64_t) );
+}
+
+TEST_CASE("Streamed image matches drawMaze", "[maze]") {
+  SquareMaze maze;
+  maze.makeMaze(37, 23);
+  MazeImageSink image("stream-actual.png", 3);
+  REQUIRE( maze.writeRows(image) );
+
+  cs225::PNG streamed;
+  REQUIRE( streamed.readFromFile("stream-actual.png") );
+  cs225::PNG *drawn = maze.drawMaze(3);
+  REQUIRE( streamed == *drawn );
+  delete drawn;
+}
+
+TEST_CASE("Palette rendering matches drawMazeWithSolution", "[maze]") {
+  SquareMaze maze;
+  maze.makeMaze(45, 31);
+  REQUIRE( maze.renderMazeWithSolution("render-actual.png", 12) );
+
+  cs225::PNG rendered;
+  REQUIRE( rendered.readFromFile("render-actual.png") );
+  cs225::PNG *drawn = maze.drawMazeWithSolution(12);
+  REQUIRE( rendered == *drawn );
+  delete drawn;
+
+  // Smaller cells scale the same picture down
+  REQUIRE( maze.renderMazeWithSolution("render-small-actual.png", 12, 4) );
+  cs225::PNG small;
+  REQUIRE( small.readFromFile("render-small-actual.png") );
+  REQUIRE( small.width() == 45 * 4 + 1 );
+  REQUIRE( small.height() == 31 * 4 + 1 );
+  REQUIRE( small.getPixel(12 * 4 + 2, 2).s == 1.0 );
+  REQUIRE( small.getPixel(12 * 4 + 2, 0).l == 1.0 );
+  REQUIRE( small.getPixel(0, 2).l == 0.0 );
+
+  REQUIRE_FALSE( maze.renderMaze("render-small-actual.png", 0, 1) );
+}
+
+TEST_CASE("Binary maze files round-trip walls and solution", "[maze]") {
+  SquareMaze maze;
+  maze.makeMaze(70, 41);
+  maze.setWall(69, 40, DOWN, false);
+  REQUIRE( maze.saveMazeWithSolution("binary-actual.maze", 5) );
+
+  MazeFile file;
+  REQUIRE( file.open("binary-actual.maze") );
+  REQUIRE( file.width() == 70 );
+  REQUIRE( file.height() == 41 );
+  std::vector<Direction> solution = maze.solveMaze(5);
+  REQUIRE( file.hasSolution() );
+  REQUIRE( file.solutionStart() == 5 );
+  REQUIRE( file.solutionSize() == solution.size() );
+  for (size_t i = 0; i < solution.size(); i++) {
+    REQUIRE( file.solutionAt(i) == solution[i] );
+  }
+
+  SquareMaze loaded;
+  REQUIRE( loaded.loadMaze("binary-actual.maze") );
+  REQUIRE( loaded.width() == 70 );
+  REQUIRE( loaded.height() == 41 );
+  for (int y = 0; y < 41; y++) {
+    for (size_t w = 0; w < maze.wordsPerRow(); w++) {
+      REQUIRE( loaded.wallRow(y)[w] == maze.wallRow(y)[w] );
+    }
+    for (int x = 0; x < 70; x++) {
+      for (int dir = RIGHT; dir <= UP; dir++) {
+        REQUIRE( file.canTravel(x, y, (Direction)dir) == maze.canTravel(x, y, (Direction)dir) );
+      }
+    }
+  }
+  REQUIRE( loaded.solveMaze(5) == solution );
+
+  // Without a solution, and refusing anything that is not a maze file
+  REQUIRE( maze.saveMaze("binary-actual.maze") );
+  REQUIRE( file.open("binary-actual.maze") );
+  REQUIRE_FALSE( file.hasSolution() );
+  REQUIRE_FALSE( file.open("../data/testSolveMazeSmall-expected.png") );
+  REQUIRE_FALSE( loaded.loadMaze("../data/testSolveMazeSmall-expected.png") );
+  REQUIRE( loaded.width() == 70 );
+}
+
+TEST_CASE("Maze readers agree on non-square mazes", "[maze]") {
+  SquareMaze maze;
+  maze.makeMaze(70, 41);
+  REQUIRE( maze.saveMazeWithSolution("binary-actual.maze", 0) );
+  cs225::PNG *image = maze.drawMazeWithSolution(0);
+  MazeReader fromImage(*image);
+  MazeReader fromFile(std::string("binary-actual.maze"));
+  delete image;
+
+  std::vector<Direction> solution = maze.solveMaze(0);
+  for (MazeReader const * reader : {&fromImage, &fromFile}) {
+    REQUIRE( reader->getWidth() == 70 );
+    REQUIRE( reader->getHeight() == 41 );
+    REQUIRE( reader->getSolutionSize() == solution.size() );
+    for (size_t i = 0; i < solution.size(); i++) {
+      REQUIRE( (int)reader->getSolutionAt(i) == (int)solution[i] );
+    }
+    // The drawing opens the exit in the bottom border, so only inner
+    // walls are compared
+    for (int y = 0; y < 41; y++) {
+      for (int x = 0; x < 70; x++) {
+        REQUIRE( reader->isWallInDir(x, y, RIGHT) == !maze.canTravel(x, y, RIGHT) );
+        if (y < 40)
+          REQUIRE( reader->isWallInDir(x, y, DOWN) == !maze.canTravel(x, y, DOWN) );
+      }
+    }
+  }
+}
+
+TEST_CASE("Expected images convert to binary mazes", "[maze]") {
+  const char *names[] = {"testSolveMazeValidPath", "testSolutionBottomRow", "testSolutionCorrectSquare",
+                         "testSolveMazeSmall", "testSolveMazeLarge"};
+  for (const char *name : names) {
+    cs225::PNG image;
+    REQUIRE( image.readFromFile(std::string("../data/") + name + "-expected.png") );
+    MazeReader fromImage(image);
+
+    // Copy the walls and the drawn solution into a maze file
+    SquareMaze maze;
+    maze.makeMaze(fromImage.getWidth(), fromImage.getHeight());
+    for (int y = 0; y < fromImage.getHeight(); y++) {
+      for (int x = 0; x < fromImage.getWidth(); x++) {
+        if (x < fromImage.getWidth() - 1)
+          maze.setWall(x, y, RIGHT, fromImage.isWall(x, y, MazeReader::RIGHTWALL));
+        if (y < fromImage.getHeight() - 1)
+          maze.setWall(x, y, DOWN, fromImage.isWall(x, y, MazeReader::DOWNWALL));
+      }
+    }
+    std::vector<Direction> solution;
+    for (size_t i = 0; i < fromImage.getSolutionSize(); i++) {
+      solution.push_back((Direction)fromImage.getSolutionAt(i));
+    }
+    MazeFileSink sink("converted-actual.maze");
+    sink.setSolution(0, solution);
+    REQUIRE( maze.writeRows(sink) );
+    MazeReader fromFile(std::string("converted-actual.maze"));
+
+    REQUIRE( fromFile.getWidth() == fromImage.getWidth() );
+    REQUIRE( fromFile.getHeight() == fromImage.getHeight() );
+    REQUIRE( fromFile.getDestinationX() == fromImage.getDestinationX() );
+    REQUIRE( fromFile.getDestinationY() == fromImage.getDestinationY() );
+    REQUIRE( fromFile.getSolutionSize() == fromImage.getSolutionSize() );
+    for (size_t i = 0; i < fromImage.getSolutionSize(); i++) {
+      REQUIRE( fromFile.getSolutionAt(i) == fromImage.getSolutionAt(i) );
+    }
+    for (int y = 0; y < fromImage.getHeight(); y++) {
+      for (int x = 0; x < fromImage.getWidth(); x++) {
+        REQUIRE( fromFile.isWallInDir(x, y, RIGHT) == fromImage.isWallInDir(x, y, RIGHT) );
+        if (y < fromImage.getHeight() - 1)
+          REQUIRE( fromFile.isWallInDir(x, y, DOWN) == fromImage.isWallInDir(x, y, DOWN) );
+      }
+    }
+  }
+}
+
+TEST_CASE("In-memory generators refuse more than INT_MAX cells", "[maze]") {
+  SquareMaze maze;
+  maze.makeMaze(65536, 32768);
+  REQUIRE( maze.width() == 0 );
+  REQUIRE( maze.height() == 0 );
+  maze.makeMazeParallel(65536, 32768, 2);
+  REQUIRE( maze.width() == 0 );
+  REQUIRE( maze.height() == 0 );
+
+  maze.makeMaze(7, 5);
+  REQUIRE( isPerfect(maze, 7, 5) );
+}
+
+TEST_CASE("Tree solver finds the farthest bottom-row cell", "[maze]") {
+  SquareMaze maze;
+  maze.makeMaze(61, 47);
+  REQUIRE( solvesFarthest(maze, 61, 47, 0, maze.solveMaze(0)) );
+  REQUIRE( solvesFarthest(maze, 61, 47, 33, maze.solveMaze(33)) );
+
+  maze.makeMaze(9, 1);
+  REQUIRE( solvesFarthest(maze, 9, 1, 4, maze.solveMaze(4)) );
+
+  // Opening extra walls adds loops; the solver must still be right
+  maze.makeMaze(40, 30);
+  for (int y = 0; y < 29; y += 3) {
+    for (int x = 0; x < 39; x += 5) {
+      maze.setWall(x, y, RIGHT, false);
+      maze.setWall(x, y, DOWN, false);
+    }
+  }
+  REQUIRE( solvesFarthest(maze, 40, 30, 7, maze.solveMaze(7)) );
+}
+
+TEST_CASE("LCA queries give tree distances and paths", "[maze]") {
+  const int width = 53, height = 41;
+  SquareMaze maze;
+  maze.makeMaze(width, height);
+  MazeQuery query;
+  REQUIRE( query.build(maze, 3) );
+
+  const int dx[4] = {1, 0, -1, 0}, dy[4] = {0, 1, 0, -1};
+  for (int source : {0, 777, width * height - 1}) {
+    // Distances from one cell by breadth-first search
+    std::vector<int> distance((size_t)width * height, -1);
+    std::queue<int> queue;
+    distance[source] = 0;
+    queue.push(source);
+    while (!queue.empty()) {
+      int cell = queue.front();
+      queue.pop();
+      for (int d = 0; d < 4; d++) {
+        int next = cell + dy[d] * width + dx[d];
+        if (maze.canTravel(cell % width, cell / width, Direction(d)) && distance[next] < 0) {
+          distance[next] = distance[cell] + 1;
+          queue.push(next);
+        }
+      }
+    }
+
+    int sx = source % width, sy = source / width;
+    for (int cell = 0; cell < width * height; cell += 13) {
+      int x = cell % width, y = cell / width;
+      REQUIRE( query.distance(sx, sy, x, y) == distance[cell] );
+
+      std::vector<Direction> steps = query.path(sx, sy, x, y);
+      REQUIRE( (int)steps.size() == distance[cell] );
+      int px = sx, py = sy;
+      for (Direction dir : steps) {
+        REQUIRE( maze.canTravel(px, py, dir) );
+        px += dx[dir];
+        py += dy[dir];
+      }
+      REQUIRE( px == x );
+      REQUIRE( py == y );
+    }
+  }
+
+  maze.setWall(0, 0, RIGHT, false);
+  maze.setWall(0, 0, DOWN, false);
+  maze.setWall(1, 0, DOWN, false);
+  maze.setWall(0, 1, RIGHT, false);
+  REQUIRE_FALSE( query.build(maze) );
+}
+
+TEST_CASE("Parallel BFS matches the tree solver and handles loops", "[maze]") {
+  SquareMaze maze;
+  maze.makeMaze(80, 60);
+  REQUIRE( maze.solveMazeParallel(5, 4) == maze.solveMaze(5) );
+
+  // With every inner wall gone the last levels are wide enough to run
+  // bottom-up
+  maze.makeMaze(40, 30);
+  for (int y = 0; y < 30; y++) {
+    for (int x = 0; x < 40; x++) {
+      maze.setWall(x, y, RIGHT, x == 39);
+      maze.setWall(x, y, DOWN, y == 29);
+    }
+  }
+  std::vector<Direction> open = maze.solveMazeParallel(3, 4);
+  REQUIRE( open.size() == 65 );
+  REQUIRE( solvesFarthest(maze, 40, 30, 3, open) );
+
+  // Remove many walls, so there are many shortest paths to agree on
+  const int width = 300, height = 200;
+  maze.makeMaze(width, height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      if ((x * 7 + y * 13) % 3 == 0) { maze.setWall(x, y, RIGHT, false); }
+      if ((x * 11 + y * 5) % 4 == 0) { maze.setWall(x, y, DOWN, false); }
+    }
+  }
+  std::vector<Direction> serial = maze.solveMazeParallel(17, 1);
+  REQUIRE( solvesFarthest(maze, width, height, 17, serial) );
+  REQUIRE( maze.solveMazeParallel(17, 4) == serial );
+}
@@ -10,6 +10,15 @@ set(assignment_clean_rm
         "kdtree_2_20-actual.kd"
         "kdtree_3_10-actual.kd"
         "kdtree_3_14-actual.kd"
-        "kdtree_3_31-actual.kd") # Generated files that should be removed with "make clean"
+        "kdtree_3_31-actual.kd"
+        "encoder-actual.png"
+        "palette-actual.png"
+        "raw-actual.raw"
+        "rawcache-source.png"
+        "rawcache-source.png.rawcache"
+        "oversized-actual.png"
+        "interlaced-actual.png"
+        "rawcache-stored.png"
+        "rawcache-stored.png.rawcache") # Generated files that should be removed with "make clean"
 set(assignment_container "fa23") # Container we are targetting
 set(assignment_uid "UIUC_CS225_FA23_mp_mosaics") # Unique ID for the assignment
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <vector>
@@ -14,7 +15,7 @@ using namespace cs225;
 
 void makePhotoMosaic(const string& inFile, const string& tileDir, int numTiles,
                      int pixelsPerTile, const string& outFile);
-vector<TileImage> getTiles(string tileDir);
+vector<TileImage> getTiles(string tileDir, int pixelsPerTile);
 bool hasImageExtension(const string& fileName);
 
 namespace opts
@@ -67,7 +68,7 @@ void makePhotoMosaic(const string& inFile, const string& tileDir, int numTiles,
     PNG inImage;
     inImage.readFromFile(inFile);
     SourceImage source(inImage, numTiles);
-    vector<TileImage> tiles = getTiles(tileDir);
+    vector<TileImage> tiles = getTiles(tileDir, pixelsPerTile);
 
     if (tiles.empty()) {
         cerr << "ERROR: No tile images found in " << tileDir << endl;
@@ -85,12 +86,12 @@ void makePhotoMosaic(const string& inFile, const string& tileDir, int numTiles,
 
     PNG result = mosaic->drawMosaic(pixelsPerTile);
     cerr << "Saving Output Image... ";
-    result.writeToFile(outFile);
+    result.writeToFile(outFile, EncodeOptions());
     cerr << "Done" << endl;
     delete mosaic;
 }
 
-vector<TileImage> getTiles(string tileDir)
+vector<TileImage> getTiles(string tileDir, int pixelsPerTile)
 {
 #if 1
     if (tileDir[tileDir.length() - 1] != '/')
@@ -112,8 +113,15 @@ vector<TileImage> getTiles(string tileDir)
              << (i + 1) << "/" << imageFiles.size()
              << ")" << string(20, ' ') << "\r";
         cerr.flush();
+        // Tiles are never drawn larger than pixelsPerTile, so only decode
+        // them at the smallest size that still covers it.
+        unsigned scale = 1;
+        PNGInfo info;
+        if (pixelsPerTile > 0 && PNG::probe(imageFiles.at(i), info))
+            scale = max(1u, min(info.width, info.height) / pixelsPerTile);
+
         PNG png;
-        png.readFromFile(imageFiles.at(i));
+        png.readFromFile(imageFiles.at(i), scale);
         TileImage next(png);
 
         LUVAPixel avg = next.getAverageColor();
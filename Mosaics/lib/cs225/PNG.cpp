@@ -16,8 +16,21 @@ using std::string;
 using std::vector;
 
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <algorithm>
 #include <functional>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "lodepng/lodepng.h"
 #include "PNG.h"
@@ -25,9 +38,22 @@ using std::vector;
 #include "LUVAPixel.h"
 
 namespace cs225 {
+  bool PNG::useRawCache = false;
+
+  void PNG::_release() {
+    if (mapping_ != NULL) {
+      munmap(mapping_, mappingLength_);
+      mapping_ = NULL;
+      mappingLength_ = 0;
+    } else {
+      delete[] imageData_;
+    }
+    imageData_ = NULL;
+  }
+
   void PNG::_copy(PNG const & other) {
     // Clear self
-    delete[] imageData_;
+    _release();
 
     // Copy `other` to self
     width_ = other.width_;
@@ -42,21 +68,27 @@ namespace cs225 {
     width_ = 0;
     height_ = 0;
     imageData_ = NULL;
+    mapping_ = NULL;
+    mappingLength_ = 0;
   }
 
   PNG::PNG(unsigned int width, unsigned int height) {
     width_ = width;
     height_ = height;
+    mapping_ = NULL;
+    mappingLength_ = 0;
     imageData_ = new LUVAPixel[width * height];
   }
 
   PNG::PNG(PNG const & other) {
     imageData_ = NULL;
+    mapping_ = NULL;
+    mappingLength_ = 0;
     _copy(other);
   }
 
   PNG::~PNG() {
-    delete[] imageData_;
+    _release();
   }
 
   PNG const & PNG::operator=(PNG const & other) {
@@ -121,33 +153,287 @@ namespace cs225 {
 
   const LUVAPixel & PNG::getPixel(unsigned int x, unsigned int y) const { return _getPixelHelper(x,y); }
 
+  namespace {
+    /** Magic bytes at the start of a raw pixel file. */
+    const char RAW_MAGIC[8] = {'C', 'S', '2', '2', '5', 'R', 'A', 'W'};
+
+    /** Version of the raw pixel file layout. */
+    const uint32_t RAW_VERSION = 2;
+
+    /** Pixel type stored in raw files: 1 is HSLAPixel, 2 is LUVAPixel. */
+    const uint32_t RAW_PIXEL_FORMAT = 2;
+
+    /** Offset of the first pixel row, one page so the mapped rows are aligned. */
+    const uint64_t RAW_DATA_OFFSET = 4096;
+
+    /** Header at the start of a raw pixel file. */
+    struct RawHeader {
+      char magic[8];
+      uint32_t version;
+      uint32_t pixelFormat;
+      uint32_t width;
+      uint32_t height;
+      uint64_t rowStride;    // bytes from one row to the next
+      uint64_t dataOffset;   // bytes from the start of the file to the first row
+      int64_t sourceMtime;   // modification time of the PNG a cache was made from, else 0
+      int64_t sourceMtimeNsec; // nanoseconds of that modification time
+      uint64_t sourceSize;   // size of that PNG, else 0
+    };
+
+    static_assert(std::is_trivially_copyable<LUVAPixel>::value,
+                  "raw files store pixels exactly as they are laid out in memory");
+
+    /** Largest ratio of inflated to deflated bytes that deflate can reach. */
+    const uint64_t MAX_INFLATE_RATIO = 1032;
+
+    /**
+     * Checks that a file of fileSize bytes could hold the scanlines of the
+     * image its header declares, before memory is set aside for them.
+     * @return 0, or the lodepng error for an impossible IDAT size
+     */
+    unsigned checkDeclaredSize(unsigned width, unsigned height, LodePNGColorMode const & color, size_t fileSize) {
+      uint64_t rowBytes = (static_cast<uint64_t>(width) * lodepng_get_bpp(&color) + 7) / 8 + 1;
+      return height > static_cast<uint64_t>(fileSize) * MAX_INFLATE_RATIO / rowBytes ? 91 : 0;
+    }
+
+    /** Destination of the scanlines produced by lodepng_decode_rows. */
+    struct DecodeTarget {
+      LUVAPixel * pixels;
+      unsigned width;
+    };
+
+    /** Converts one RGBA scanline straight into its row of pixels. */
+    unsigned decodeRow(void * user, unsigned y, unsigned char const * row) {
+      DecodeTarget * target = static_cast<DecodeTarget *>(user);
+      LUVAPixel * pixels = target->pixels + static_cast<size_t>(y) * target->width;
+      for (unsigned x = 0; x < target->width; x++) {
+        rgbaColor rgb;
+        rgb.r = row[x * 4];
+        rgb.g = row[x * 4 + 1];
+        rgb.b = row[x * 4 + 2];
+        rgb.a = row[x * 4 + 3];
+
+        luvaColor luv = rgb2luv(rgb);
+        LUVAPixel & pixel = pixels[x];
+        pixel.l = luv.l;
+        pixel.u = luv.u;
+        pixel.v = luv.v;
+        pixel.a = luv.a;
+      }
+      return 0;
+    }
+  }
+
   bool PNG::readFromFile(string const & fileName) {
-    vector<unsigned char> byteData;
-    unsigned error = lodepng::decode(byteData, width_, height_, fileName);
+    string cacheFile = fileName + ".rawcache";
+    RawSource source;
+    struct stat info;
+    bool cacheable = useRawCache && stat(fileName.c_str(), &info) == 0;
+    if (cacheable) {
+      source.mtime = static_cast<long long>(info.st_mtim.tv_sec);
+      source.mtimeNsec = static_cast<long long>(info.st_mtim.tv_nsec);
+      source.size = static_cast<unsigned long long>(info.st_size);
+      if (_readRawFile(cacheFile, &source)) { return true; }
+    }
+
+    vector<unsigned char> fileData;
+    lodepng::State state; // decodes to 8-bit RGBA by default
+    unsigned width = 0, height = 0;
+
+    unsigned error = lodepng::load_file(fileData, fileName);
+    if (!error) {
+      error = lodepng_inspect(&width, &height, &state, fileData.data(), fileData.size());
+    }
+    if (!error) {
+      // The header alone is not trusted with the size of the allocation.
+      error = checkDeclaredSize(width, height, state.info_png.color, fileData.size());
+    }
+
+    // Scanlines are decoded straight into the new pixel array, so no
+    // intermediate copy of the whole image is ever made.
+    DecodeTarget target;
+    target.pixels = error ? nullptr : new (std::nothrow) LUVAPixel[static_cast<size_t>(width) * height];
+    target.width = width;
+    if (!error && target.pixels == nullptr) {
+      error = 83; // memory allocation failed
+    }
+    if (!error) {
+      error = lodepng_decode_rows(&width, &height, &state, fileData.data(), fileData.size(), decodeRow, &target);
+    }
 
     if (error) {
       cerr << "PNG decoder error " << error << ": " << lodepng_error_text(error) << endl;
+      delete[] target.pixels;
       return false;
     }
 
-    delete[] imageData_;
-    imageData_ = new LUVAPixel[width_ * height_];
+    _release();
+    imageData_ = target.pixels;
+    width_ = width;
+    height_ = height;
+
+    if (cacheable) {
+      // Best effort: a missing cache only costs the next load a decode.
+      _writeRawFile(cacheFile, &source);
+    }
+    return true;
+  }
+
+  bool PNG::readFromFile(string const & fileName, unsigned scale) {
+    vector<unsigned char> fileData;
+    unsigned char * byteData = nullptr;
+    unsigned width = 0, height = 0;
+    lodepng::State state;
+
+    unsigned error = lodepng::load_file(fileData, fileName);
+    if (!error) {
+      error = lodepng_decode_reduced32(&byteData, &width, &height, &state,
+                                       fileData.data(), fileData.size(), scale);
+    }
+
+    if (error) {
+      cerr << "PNG decoder error " << error << ": " << lodepng_error_text(error) << endl;
+      return false;
+    }
+
+    DecodeTarget target;
+    target.pixels = new (std::nothrow) LUVAPixel[static_cast<size_t>(width) * height];
+    target.width = width;
+    if (target.pixels == nullptr) {
+      cerr << "PNG decoder error 83: " << lodepng_error_text(83) << endl;
+      free(byteData);
+      return false;
+    }
+    for (unsigned y = 0; y < height; y++) {
+      decodeRow(&target, y, byteData + static_cast<size_t>(y) * width * 4);
+    }
+    free(byteData);
+
+    _release();
+    imageData_ = target.pixels;
+    width_ = width;
+    height_ = height;
+    return true;
+  }
 
-    for (unsigned i = 0; i < byteData.size(); i += 4) {
-      rgbaColor rgb;
-      rgb.r = byteData[i];
-      rgb.g = byteData[i + 1];
-      rgb.b = byteData[i + 2];
-      rgb.a = byteData[i + 3];
+  bool PNG::probe(string const & fileName, PNGInfo & info) {
+    // The signature and IHDR chunk are the first 33 bytes of every PNG.
+    unsigned char header[33];
+    std::ifstream file(fileName, std::ios::binary);
+    file.read(reinterpret_cast<char *>(header), sizeof(header));
 
-      luvaColor luv = rgb2luv(rgb);
-      LUVAPixel & pixel = imageData_[i/4];
-      pixel.l = luv.l;
-      pixel.u = luv.u;
-      pixel.v = luv.v;
-      pixel.a = luv.a;
+    lodepng::State state;
+    unsigned width = 0, height = 0;
+    unsigned error = lodepng_inspect(&width, &height, &state, header, static_cast<size_t>(file.gcount()));
+    if (error) {
+      cerr << "PNG decoder error " << error << ": " << lodepng_error_text(error) << endl;
+      return false;
     }
 
+    info.width = width;
+    info.height = height;
+    info.colorType = static_cast<PNGColorType>(state.info_png.color.colortype);
+    info.bitDepth = state.info_png.color.bitdepth;
+    info.interlaced = state.info_png.interlace_method != 0;
+    return true;
+  }
+
+  bool PNG::readRawFile(string const & fileName) {
+    return _readRawFile(fileName, NULL);
+  }
+
+  bool PNG::writeRawFile(string const & fileName) const {
+    return _writeRawFile(fileName, NULL);
+  }
+
+  bool PNG::_readRawFile(string const & fileName, RawSource const * source) {
+    bool report = (source == NULL);
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+      if (report) { cerr << "PNG raw file error: cannot open " << fileName << endl; }
+      return false;
+    }
+
+    struct stat info;
+    RawHeader header;
+    bool valid = fstat(fd, &info) == 0
+        && static_cast<uint64_t>(info.st_size) >= sizeof(header)
+        && pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header))
+        && memcmp(header.magic, RAW_MAGIC, sizeof(RAW_MAGIC)) == 0
+        && header.version == RAW_VERSION
+        && header.pixelFormat == RAW_PIXEL_FORMAT
+        && header.rowStride >= header.width * sizeof(LUVAPixel)
+        && header.dataOffset % alignof(LUVAPixel) == 0
+        && header.dataOffset <= static_cast<uint64_t>(info.st_size)
+        && (header.rowStride == 0
+            || header.height <= (static_cast<uint64_t>(info.st_size) - header.dataOffset) / header.rowStride);
+    if (valid && source != NULL) {
+      valid = header.sourceMtime == source->mtime && header.sourceMtimeNsec == source->mtimeNsec
+          && header.sourceSize == source->size;
+    }
+
+    void * mapping = MAP_FAILED;
+    if (valid) {
+      // Private mapping: pages are shared with the page cache until written.
+      mapping = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+      if (report) { cerr << "PNG raw file error: " << fileName << " is not a valid LUVA raw file" << endl; }
+      return false;
+    }
+
+    LUVAPixel * pixels = reinterpret_cast<LUVAPixel *>(static_cast<char *>(mapping) + header.dataOffset);
+    _release();
+    width_ = header.width;
+    height_ = header.height;
+    if (header.rowStride == header.width * sizeof(LUVAPixel)) {
+      mapping_ = mapping;
+      mappingLength_ = info.st_size;
+      imageData_ = pixels;
+    } else {
+      // Padded rows do not match the in-memory layout, so copy them out.
+      imageData_ = new LUVAPixel[static_cast<size_t>(width_) * height_];
+      for (unsigned y = 0; y < height_; y++) {
+        memcpy(imageData_ + static_cast<size_t>(y) * width_,
+               reinterpret_cast<char *>(pixels) + y * header.rowStride, width_ * sizeof(LUVAPixel));
+      }
+      munmap(mapping, info.st_size);
+    }
+    return true;
+  }
+
+  bool PNG::_writeRawFile(string const & fileName, RawSource const * source) const {
+    RawHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RAW_MAGIC, sizeof(RAW_MAGIC));
+    header.version = RAW_VERSION;
+    header.pixelFormat = RAW_PIXEL_FORMAT;
+    header.width = width_;
+    header.height = height_;
+    header.rowStride = width_ * sizeof(LUVAPixel);
+    header.dataOffset = RAW_DATA_OFFSET;
+    if (source != NULL) {
+      header.sourceMtime = source->mtime;
+      header.sourceMtimeNsec = source->mtimeNsec;
+      header.sourceSize = source->size;
+    }
+
+    // Write to a temporary name and rename, so readers never map a partial file.
+    string tempFile = fileName + "." + std::to_string(getpid()) + ".tmp";
+    std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+    vector<char> padding(RAW_DATA_OFFSET - sizeof(header), 0);
+    out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    out.write(padding.data(), padding.size());
+    out.write(reinterpret_cast<char const *>(imageData_), static_cast<std::streamsize>(header.rowStride * height_));
+    out.close();
+
+    if (!out || std::rename(tempFile.c_str(), fileName.c_str()) != 0) {
+      std::remove(tempFile.c_str());
+      if (source == NULL) { cerr << "PNG raw file error: cannot write " << fileName << endl; }
+      return false;
+    }
     return true;
   }
 
@@ -178,6 +464,43 @@ namespace cs225 {
     return (error == 0);
   }
 
+  bool PNG::writeToFile(string const & fileName, EncodeOptions const & options) {
+    vector<unsigned char> byteData((size_t)width_ * height_ * 4);
+
+    // The color space conversion is as expensive as the compression, so it is
+    // split across the same number of threads by bands of rows.
+    unsigned numThreads = options.threads;
+    if (numThreads == 0) { numThreads = std::max(1u, std::thread::hardware_concurrency()); }
+    numThreads = std::max(1u, std::min(numThreads, height_));
+
+    auto convertRows = [&](unsigned yBegin, unsigned yEnd) {
+      for (size_t i = (size_t)yBegin * width_; i < (size_t)yEnd * width_; i++) {
+        luvaColor luv;
+        luv.l = imageData_[i].l;
+        luv.u = imageData_[i].u;
+        luv.v = imageData_[i].v;
+        luv.a = imageData_[i].a;
+
+        rgbaColor rgb = luv2rgb(luv);
+
+        byteData[(i * 4)]     = rgb.r;
+        byteData[(i * 4) + 1] = rgb.g;
+        byteData[(i * 4) + 2] = rgb.b;
+        byteData[(i * 4) + 3] = rgb.a;
+      }
+    };
+
+    vector<std::thread> threads;
+    for (unsigned t = 1; t < numThreads; t++) {
+      threads.emplace_back(convertRows, height_ * t / numThreads, height_ * (t + 1) / numThreads);
+    }
+    convertRows(0, height_ / numThreads);
+    for (std::thread & thread : threads) { thread.join(); }
+
+    return PNGEncoder::encode(fileName, byteData.data(), width_, height_,
+                              PNGColorType::RGBA, 8, options);
+  }
+
   unsigned int PNG::width() const {
     return width_;
   }
@@ -203,7 +526,7 @@ namespace cs225 {
     }
 
     // Clear the existing image
-    delete[] imageData_;
+    _release();
 
     // Update the image to reflect the new image size and data
     width_ = newWidth;
@@ -0,0 +1,150 @@
+/**
+ * @file PNGEncoder.h
+ * Multi-threaded, row-streaming PNG encoder.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace cs225 {
+  /**
+   * PNG color types (IHDR field values) supported by PNGEncoder.
+   */
+  enum class PNGColorType {
+    GREY = 0,
+    RGB = 2,
+    PALETTE = 3,
+    GREY_ALPHA = 4,
+    RGBA = 6
+  };
+
+  /**
+   * Tuning knobs for PNGEncoder.
+   */
+  struct EncodeOptions {
+    /** Compression level, from 0 (stored, fastest) to 8 (smallest output); higher levels act as 8. */
+    int level = 6;
+
+    /** Number of worker threads; 0 uses std::thread::hardware_concurrency(). */
+    unsigned threads = 0;
+
+    /** Scanlines per independently compressed group; 0 picks about 1 MiB of pixel data. */
+    unsigned rowsPerGroup = 0;
+  };
+
+  /**
+   * Writes a PNG file scanline by scanline.
+   *
+   * Scanlines are collected into row groups. Each group is filtered and
+   * deflated on its own worker thread, ending in a full flush so the
+   * compressed groups can simply be concatenated (pigz-style) into the one
+   * zlib stream of the image. Only `threads * rowsPerGroup` raw scanlines are
+   * buffered at a time, so the full image never has to exist in memory.
+   */
+  class PNGEncoder {
+  public:
+    /**
+      * Opens a PNG file for writing.
+      * @param fileName Name of the file to be written.
+      * @param width Width of the image in pixels.
+      * @param height Height of the image in pixels.
+      * @param colorType Color type of the scanlines passed to writeRows.
+      * @param bitDepth Bits per channel (or per palette index).
+      * @param options Compression level and threading settings.
+      */
+    PNGEncoder(std::string const & fileName, unsigned width, unsigned height,
+               PNGColorType colorType, unsigned bitDepth,
+               EncodeOptions const & options = EncodeOptions());
+
+    /**
+      * Finishes the file if finish() has not been called yet.
+      */
+    ~PNGEncoder();
+
+    PNGEncoder(PNGEncoder const & other) = delete;
+    PNGEncoder const & operator= (PNGEncoder const & other) = delete;
+
+    /**
+      * Sets the palette of a PALETTE image. Must be called before the first
+      * call to writeRows.
+      * @param rgba Palette entries as consecutive RGBA byte quadruples.
+      */
+    void setPalette(std::vector<unsigned char> const & rgba);
+
+    /**
+      * Appends scanlines to the image.
+      * @param rows Packed scanlines of rowBytes() bytes each, without filter bytes.
+      * @param numRows Number of scanlines in `rows`.
+      * @return true, if the scanlines were accepted.
+      */
+    bool writeRows(unsigned char const * rows, unsigned numRows);
+
+    /**
+      * Compresses any buffered scanlines and completes the file.
+      * @return true, if the whole image was written successfully.
+      */
+    bool finish();
+
+    /**
+      * Gets the number of bytes in one packed scanline.
+      * @return Bytes per scanline.
+      */
+    size_t rowBytes() const;
+
+    /**
+      * Encodes a complete image held in memory.
+      * @param fileName Name of the file to be written.
+      * @param data Packed scanlines of the whole image.
+      * @param width Width of the image in pixels.
+      * @param height Height of the image in pixels.
+      * @param colorType Color type of `data`.
+      * @param bitDepth Bits per channel of `data`.
+      * @param options Compression level and threading settings.
+      * @return true, if the image was successfully written.
+      */
+    static bool encode(std::string const & fileName, unsigned char const * data,
+                       unsigned width, unsigned height,
+                       PNGColorType colorType, unsigned bitDepth,
+                       EncodeOptions const & options = EncodeOptions());
+
+  private:
+    std::ofstream out_;                  /*< Output file */
+    unsigned width_;                     /*< Width of the image */
+    unsigned height_;                    /*< Height of the image */
+    PNGColorType colorType_;             /*< Color type of the scanlines */
+    unsigned bitDepth_;                  /*< Bits per channel */
+    EncodeOptions options_;              /*< Resolved options (no zero fields) */
+    size_t rowBytes_;                    /*< Bytes per packed scanline */
+    unsigned bytesPerPixel_;             /*< Filter distance, at least 1 */
+    std::vector<unsigned char> palette_; /*< RGBA palette entries */
+    std::vector<unsigned char> batch_;   /*< Buffered raw scanlines */
+    std::vector<unsigned char> prevRow_; /*< Last scanline of the previous batch */
+    unsigned batchRows_;                 /*< Scanlines in batch_ */
+    unsigned rowsWritten_;               /*< Scanlines compressed so far */
+    unsigned adler_;                     /*< Adler-32 of the filtered data so far */
+    bool headerWritten_;                 /*< Whether signature and IHDR are out */
+    bool finished_;                      /*< Whether finish() has run */
+    bool ok_;                            /*< Whether every step has succeeded */
+
+    /**
+     * Writes the signature, IHDR and (for palette images) PLTE/tRNS.
+     */
+    void _writeHeader();
+
+    /**
+     * Filters and compresses all buffered scanlines in parallel and
+     * appends them to the file as IDAT chunks.
+     */
+    void _flushBatch();
+
+    /**
+     * Writes one chunk (length, type, data, CRC).
+     */
+    void _writeChunk(char const * type, unsigned char const * data, size_t length);
+  };
+}
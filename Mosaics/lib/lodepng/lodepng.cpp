@@ -34,6 +34,11 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 #include <stdio.h>
 #include <stdlib.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LODEPNG_SSE2 /*use the SSE2 unfilter and Adler-32 kernels*/
+#endif
+
 #if defined(_MSC_VER) && (_MSC_VER >= 1310) /*Visual Studio: A few warning types are not desired here.*/
 #pragma warning( disable : 4244 ) /*implicit conversions: not warned by gcc -Wall -Wextra and requires too much casts*/
 #pragma warning( disable : 4996 ) /*VS does not like fopen, but fopen_s is not standard C so unusable here*/
@@ -279,6 +284,29 @@ static unsigned ucvector_push_back(ucvector* p, unsigned char c)
 }
 #endif /*defined(LODEPNG_COMPILE_PNG) || defined(LODEPNG_COMPILE_ENCODER)*/
 
+#ifdef LODEPNG_COMPILE_DECODER
+/*
+Receives the inflated data while lodepng_inflatev runs, so that the out buffer only
+has to hold a sliding window instead of the whole result.
+*/
+typedef struct InflateSink
+{
+  /*called with the next bytes of the result, in order; a nonzero return value stops inflating*/
+  unsigned (*write)(void* data, const unsigned char* bytes, size_t size);
+  void* data; /*passed to write*/
+  size_t done; /*bytes at the start of the out buffer that were already written*/
+  unsigned adler; /*Adler-32 of everything written so far*/
+} InflateSink;
+
+static void InflateSink_init(InflateSink* sink, unsigned (*write)(void*, const unsigned char*, size_t), void* data)
+{
+  sink->write = write;
+  sink->data = data;
+  sink->done = 0;
+  sink->adler = 1;
+}
+#endif /*LODEPNG_COMPILE_DECODER*/
+
 
 /* ////////////////////////////////////////////////////////////////////////// */
 
@@ -507,6 +535,7 @@ typedef struct HuffmanTree
   unsigned* tree2d;
   unsigned* tree1d;
   unsigned* lengths; /*the lengths of the codes of the 1d-tree*/
+  unsigned* table; /*lookup table for fast decoding, see HuffmanTree_makeTable*/
   unsigned maxbitlen; /*maximum number of bits a single code can get*/
   unsigned numcodes; /*number of symbols in the alphabet = number of codes*/
 } HuffmanTree;
@@ -529,6 +558,7 @@ static void HuffmanTree_init(HuffmanTree* tree)
   tree->tree2d = 0;
   tree->tree1d = 0;
   tree->lengths = 0;
+  tree->table = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
@@ -536,6 +566,7 @@ static void HuffmanTree_cleanup(HuffmanTree* tree)
   lodepng_free(tree->tree2d);
   lodepng_free(tree->tree1d);
   lodepng_free(tree->lengths);
+  lodepng_free(tree->table);
 }
 
 /*the tree representation used by the decoder. return value is error*/
@@ -959,6 +990,196 @@ static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
     if(treepos >= codetree->numcodes) return (unsigned)(-1); /*error: it appeared outside the codetree*/
   }
 }
+
+/*
+Table-driven Huffman decoding. Deflate packs the bits of a code starting at its most
+significant bit into the stream least significant bit first, so the next
+HUFFMAN_FIRSTBITS bits of the stream index the head of the table directly with the
+bit-reversed code. Codes longer than that continue in a second-level table that is
+indexed with the following bits. Each unsigned entry packs:
+bits 0-15: the symbol, the first literal of a pair, or the offset of a second-level table
+bits 16-20: number of bits the entry consumes (for links: the index bits of the second-level table)
+bits 21-22: kind of entry, one of the HUFFMAN_ENTRY_* values
+bits 23-30: the second literal of a pair
+A pair entry decodes two literals with a single lookup when both codes together fit
+in HUFFMAN_FIRSTBITS bits, which is the common case for the short literal codes of images.
+*/
+#define HUFFMAN_FIRSTBITS 10u
+#define HUFFMAN_FIRSTMASK ((1u << HUFFMAN_FIRSTBITS) - 1u)
+#define HUFFMAN_ENTRY_INVALID 0u
+#define HUFFMAN_ENTRY_SYMBOL 1u
+#define HUFFMAN_ENTRY_LINK 2u
+#define HUFFMAN_ENTRY_PAIR 3u
+#define HUFFMAN_ENTRY(value, length, kind) ((unsigned)(value) | ((unsigned)(length) << 16) | ((unsigned)(kind) << 21))
+#define HUFFMAN_VALUE(entry) ((entry) & 65535u)
+#define HUFFMAN_LENGTH(entry) (((entry) >> 16) & 31u)
+#define HUFFMAN_KIND(entry) (((entry) >> 21) & 3u)
+#define HUFFMAN_SECOND(entry) (((entry) >> 23) & 255u)
+
+static unsigned reverseBits(unsigned bits, unsigned num)
+{
+  unsigned i, result = 0;
+  for(i = 0; i < num; ++i) result |= ((bits >> (num - i - 1)) & 1u) << i;
+  return result;
+}
+
+/*
+Builds tree->table from tree->tree1d and tree->lengths. If pairs is nonzero, head entries
+whose bits hold two complete literal codes decode both literals at once. return value is error.
+*/
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree, unsigned pairs)
+{
+  const unsigned headsize = 1u << HUFFMAN_FIRSTBITS;
+  unsigned maxlens[1u << HUFFMAN_FIRSTBITS]; /*longest code sharing each head index*/
+  unsigned i, j, size, pointer;
+
+  for(i = 0; i != headsize; ++i) maxlens[i] = 0;
+  for(i = 0; i != tree->numcodes; ++i)
+  {
+    unsigned l = tree->lengths[i];
+    if(l <= HUFFMAN_FIRSTBITS) continue;
+    j = reverseBits(tree->tree1d[i] >> (l - HUFFMAN_FIRSTBITS), HUFFMAN_FIRSTBITS);
+    if(l > maxlens[j]) maxlens[j] = l;
+  }
+
+  size = headsize;
+  for(i = 0; i != headsize; ++i)
+  {
+    if(maxlens[i] > HUFFMAN_FIRSTBITS) size += 1u << (maxlens[i] - HUFFMAN_FIRSTBITS);
+  }
+
+  tree->table = (unsigned*)lodepng_malloc(size * sizeof(unsigned));
+  if(!tree->table) return 83; /*alloc fail*/
+  for(i = 0; i != size; ++i) tree->table[i] = HUFFMAN_ENTRY(0, 0, HUFFMAN_ENTRY_INVALID);
+
+  /*second-level tables are stored after the head*/
+  pointer = headsize;
+  for(i = 0; i != headsize; ++i)
+  {
+    if(maxlens[i] <= HUFFMAN_FIRSTBITS) continue;
+    tree->table[i] = HUFFMAN_ENTRY(pointer, maxlens[i] - HUFFMAN_FIRSTBITS, HUFFMAN_ENTRY_LINK);
+    pointer += 1u << (maxlens[i] - HUFFMAN_FIRSTBITS);
+  }
+
+  for(i = 0; i != tree->numcodes; ++i)
+  {
+    unsigned l = tree->lengths[i];
+    unsigned reversed;
+    if(l == 0) continue;
+    reversed = reverseBits(tree->tree1d[i], l);
+    if(l <= HUFFMAN_FIRSTBITS)
+    {
+      /*every index that starts with this code decodes to it*/
+      for(j = reversed; j < headsize; j += 1u << l) tree->table[j] = HUFFMAN_ENTRY(i, l, HUFFMAN_ENTRY_SYMBOL);
+    }
+    else
+    {
+      unsigned link = tree->table[reversed & HUFFMAN_FIRSTMASK];
+      unsigned subbits = HUFFMAN_LENGTH(link);
+      unsigned sublength = l - HUFFMAN_FIRSTBITS;
+      /*a shorter code that is a prefix of this one: oversubscribed, see comment in lodepng_error_text*/
+      if(HUFFMAN_KIND(link) != HUFFMAN_ENTRY_LINK) return 55;
+      for(j = reversed >> HUFFMAN_FIRSTBITS; j < (1u << subbits); j += 1u << sublength)
+      {
+        tree->table[HUFFMAN_VALUE(link) + j] = HUFFMAN_ENTRY(i, sublength, HUFFMAN_ENTRY_SYMBOL);
+      }
+    }
+  }
+
+  if(pairs)
+  {
+    /*look up the second literal in a snapshot of the head, which still has single symbols only*/
+    unsigned* head = (unsigned*)lodepng_malloc(headsize * sizeof(unsigned));
+    if(!head) return 83; /*alloc fail*/
+    for(i = 0; i != headsize; ++i) head[i] = tree->table[i];
+    for(i = 0; i != headsize; ++i)
+    {
+      unsigned first = head[i], second, l1;
+      if(HUFFMAN_KIND(first) != HUFFMAN_ENTRY_SYMBOL || HUFFMAN_VALUE(first) > 255) continue;
+      l1 = HUFFMAN_LENGTH(first);
+      /*the top l1 bits of this index are unknown, so the second code must fit in the rest*/
+      second = head[i >> l1];
+      if(HUFFMAN_KIND(second) != HUFFMAN_ENTRY_SYMBOL || HUFFMAN_VALUE(second) > 255) continue;
+      if(l1 + HUFFMAN_LENGTH(second) > HUFFMAN_FIRSTBITS) continue;
+      tree->table[i] = HUFFMAN_ENTRY(HUFFMAN_VALUE(first), l1 + HUFFMAN_LENGTH(second), HUFFMAN_ENTRY_PAIR)
+                     | (HUFFMAN_VALUE(second) << 23);
+    }
+    lodepng_free(head);
+  }
+
+  return 0;
+}
+
+/*
+Reads the deflate stream through a 64-bit buffer: one refill makes at least 57 bits
+available, enough for a literal/length code, its extra bits, a distance code and its
+extra bits. Past the end of the input, zero bits are read; callers check bp against
+bitsize afterwards.
+*/
+typedef struct LodePNGBitReader
+{
+  const unsigned char* data;
+  size_t size; /*size of data in bytes*/
+  size_t bitsize; /*size of data in bits*/
+  size_t bp; /*bit pointer, same meaning as in the rest of the inflator*/
+  unsigned long long buffer; /*the bits starting at bp, least significant bit first*/
+} LodePNGBitReader;
+
+static void LodePNGBitReader_init(LodePNGBitReader* reader, const unsigned char* data, size_t size, size_t bp)
+{
+  reader->data = data;
+  reader->size = size;
+  reader->bitsize = size * 8;
+  reader->bp = bp;
+  reader->buffer = 0;
+}
+
+static void refillBits(LodePNGBitReader* reader)
+{
+  size_t start = reader->bp >> 3;
+  unsigned long long result = 0;
+  if(start + 8 <= reader->size)
+  {
+    const unsigned char* p = reader->data + start;
+    result = (unsigned long long)p[0] | ((unsigned long long)p[1] << 8)
+           | ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24)
+           | ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40)
+           | ((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+  }
+  else
+  {
+    size_t i;
+    for(i = 0; i != 8 && start + i < reader->size; ++i)
+    {
+      result |= (unsigned long long)reader->data[start + i] << (8 * i);
+    }
+  }
+  reader->buffer = result >> (reader->bp & 7u);
+}
+
+static unsigned peekBits(const LodePNGBitReader* reader, unsigned nbits)
+{
+  return (unsigned)(reader->buffer & ((1ull << nbits) - 1ull));
+}
+
+static void advanceBits(LodePNGBitReader* reader, unsigned nbits)
+{
+  reader->buffer >>= nbits;
+  reader->bp += nbits;
+}
+
+/*decodes one symbol with the table of tree, the reader must have enough bits buffered*/
+static unsigned huffmanDecodeTable(LodePNGBitReader* reader, const HuffmanTree* tree)
+{
+  unsigned entry = tree->table[peekBits(reader, HUFFMAN_FIRSTBITS)];
+  if(HUFFMAN_KIND(entry) == HUFFMAN_ENTRY_LINK)
+  {
+    advanceBits(reader, HUFFMAN_FIRSTBITS);
+    entry = tree->table[HUFFMAN_VALUE(entry) + peekBits(reader, HUFFMAN_LENGTH(entry))];
+  }
+  advanceBits(reader, HUFFMAN_LENGTH(entry));
+  return entry;
+}
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_DECODER
@@ -1123,14 +1344,39 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   return error;
 }
 
-/*inflate a block with dynamic of fixed Huffman tree*/
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len);
+
+/*distance codes reach back at most 32 KiB, the rest of the window can be handed on*/
+#define INFLATE_WINDOW_SIZE 32768u
+/*how much inflated data is collected before it goes to the sink*/
+#define INFLATE_FLUSH_SIZE 262144u
+
+/*writes out->data[sink->done..pos) to the sink and slides the window. return value is error*/
+static unsigned inflateFlush(ucvector* out, size_t* pos, InflateSink* sink)
+{
+  unsigned error;
+  if(*pos == sink->done) return 0;
+  sink->adler = update_adler32(sink->adler, &out->data[sink->done], (unsigned)(*pos - sink->done));
+  error = sink->write(sink->data, &out->data[sink->done], *pos - sink->done);
+  if(error) return error;
+  if(*pos > INFLATE_WINDOW_SIZE)
+  {
+    memmove(out->data, &out->data[*pos - INFLATE_WINDOW_SIZE], INFLATE_WINDOW_SIZE);
+    *pos = INFLATE_WINDOW_SIZE;
+    out->size = *pos;
+  }
+  sink->done = *pos;
+  return 0;
+}
+
+/*inflate a block with dynamic of fixed Huffman tree. If sink is not NULL, the output is flushed to it on the way*/
 static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp,
-                                    size_t* pos, size_t inlength, unsigned btype)
+                                    size_t* pos, size_t inlength, unsigned btype, InflateSink* sink)
 {
   unsigned error = 0;
   HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
   HuffmanTree tree_d; /*the huffman tree for distance codes*/
-  size_t inbitlength = inlength * 8;
+  LodePNGBitReader reader;
 
   HuffmanTree_init(&tree_ll);
   HuffmanTree_init(&tree_d);
@@ -1138,80 +1384,104 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
   if(btype == 1) getTreeInflateFixed(&tree_ll, &tree_d);
   else if(btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, in, bp, inlength);
 
+  if(!error) error = HuffmanTree_makeTable(&tree_ll, 1);
+  if(!error) error = HuffmanTree_makeTable(&tree_d, 0);
+
+  LodePNGBitReader_init(&reader, in, inlength, *bp);
+
   while(!error) /*decode all symbols until end reached, breaks at end code*/
   {
+    unsigned entry, code_ll;
+
+    if(sink && (*pos) >= INFLATE_FLUSH_SIZE)
+    {
+      error = inflateFlush(out, pos, sink);
+      if(error) break;
+    }
+    /*room for the longest match plus the overshoot of the 8-byte match copies below*/
+    if(!ucvector_reserve(out, (*pos) + 258 + 8)) ERROR_BREAK(83 /*alloc fail*/);
+
+    refillBits(&reader);
+    entry = huffmanDecodeTable(&reader, &tree_ll);
+    if(reader.bp > reader.bitsize) ERROR_BREAK(10); /*error: end of input memory reached without endcode*/
+
+    if(HUFFMAN_KIND(entry) == HUFFMAN_ENTRY_PAIR) /*two literal symbols*/
+    {
+      out->data[(*pos)++] = (unsigned char)HUFFMAN_VALUE(entry);
+      out->data[(*pos)++] = (unsigned char)HUFFMAN_SECOND(entry);
+      continue;
+    }
+    if(HUFFMAN_KIND(entry) != HUFFMAN_ENTRY_SYMBOL) ERROR_BREAK(11); /*error: code that is not in the tree*/
+
     /*code_ll is literal, length or end code*/
-    unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
+    code_ll = HUFFMAN_VALUE(entry);
     if(code_ll <= 255) /*literal symbol*/
     {
-      /*ucvector_push_back would do the same, but for some reason the two lines below run 10% faster*/
-      if(!ucvector_resize(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
-      out->data[*pos] = (unsigned char)code_ll;
-      ++(*pos);
+      out->data[(*pos)++] = (unsigned char)code_ll;
     }
     else if(code_ll >= FIRST_LENGTH_CODE_INDEX && code_ll <= LAST_LENGTH_CODE_INDEX) /*length code*/
     {
       unsigned code_d, distance;
       unsigned numextrabits_l, numextrabits_d; /*extra bits for length and distance*/
-      size_t start, forward, backward, length;
+      size_t start, length;
+      unsigned char* dst;
+      const unsigned char* src;
 
       /*part 1: get length base*/
       length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX];
 
       /*part 2: get extra bits and add the value of that to length*/
       numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
-      if((*bp + numextrabits_l) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-      length += readBitsFromStream(bp, in, numextrabits_l);
+      length += peekBits(&reader, numextrabits_l);
+      advanceBits(&reader, numextrabits_l);
 
       /*part 3: get distance code*/
-      code_d = huffmanDecodeSymbol(in, bp, &tree_d, inbitlength);
-      if(code_d > 29)
-      {
-        if(code_d == (unsigned)(-1)) /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
-        {
-          /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
-          (10=no endcode, 11=wrong jump outside of tree)*/
-          error = (*bp) > inlength * 8 ? 10 : 11;
-        }
-        else error = 18; /*error: invalid distance code (30-31 are never used)*/
-        break;
-      }
+      entry = huffmanDecodeTable(&reader, &tree_d);
+      if(HUFFMAN_KIND(entry) != HUFFMAN_ENTRY_SYMBOL) ERROR_BREAK(11); /*error: code that is not in the tree*/
+      code_d = HUFFMAN_VALUE(entry);
+      if(code_d > 29) ERROR_BREAK(18); /*error: invalid distance code (30-31 are never used)*/
       distance = DISTANCEBASE[code_d];
 
       /*part 4: get extra bits from distance*/
       numextrabits_d = DISTANCEEXTRA[code_d];
-      if((*bp + numextrabits_d) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-      distance += readBitsFromStream(bp, in, numextrabits_d);
+      distance += peekBits(&reader, numextrabits_d);
+      advanceBits(&reader, numextrabits_d);
+      if(reader.bp > reader.bitsize) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
 
       /*part 5: fill in all the out[n] values based on the length and dist*/
       start = (*pos);
       if(distance > start) ERROR_BREAK(52); /*too long backward distance*/
-      backward = start - distance;
+      dst = out->data + start;
+      src = dst - distance;
 
-      if(!ucvector_resize(out, (*pos) + length)) ERROR_BREAK(83 /*alloc fail*/);
-      if (distance < length) {
-        for(forward = 0; forward < length; ++forward)
-        {
-          out->data[(*pos)++] = out->data[backward++];
-        }
-      } else {
-        memcpy(out->data + *pos, out->data + backward, length);
-        *pos += length;
+      if(distance >= 8)
+      {
+        /*8 bytes at a time; the source of each word is already complete. May write up to
+        7 bytes past the match, into the reserved room*/
+        size_t i;
+        for(i = 0; i < length; i += 8) memcpy(dst + i, src + i, 8);
+      }
+      else if(distance == 1)
+      {
+        memset(dst, *src, length);
+      }
+      else
+      {
+        size_t i;
+        for(i = 0; i != length; ++i) dst[i] = src[i];
       }
+      *pos += length;
     }
     else if(code_ll == 256)
     {
       break; /*end code, break the loop*/
     }
-    else /*if(code == (unsigned)(-1))*/ /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
-    {
-      /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
-      (10=no endcode, 11=wrong jump outside of tree)*/
-      error = ((*bp) > inlength * 8) ? 10 : 11;
-      break;
-    }
+    else ERROR_BREAK(11); /*error: unused literal/length code 286 or 287*/
   }
 
+  *bp = reader.bp;
+  out->size = *pos;
+
   HuffmanTree_cleanup(&tree_ll);
   HuffmanTree_cleanup(&tree_d);
 
@@ -1221,7 +1491,7 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength)
 {
   size_t p;
-  unsigned LEN, NLEN, n, error = 0;
+  unsigned LEN, NLEN, error = 0;
 
   /*go to first boundary of byte*/
   while(((*bp) & 0x7) != 0) ++(*bp);
@@ -1239,16 +1509,19 @@ static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, siz
 
   /*read the literal data: LEN bytes are now stored in the out buffer*/
   if(p + LEN > inlength) return 23; /*error: reading outside of in buffer*/
-  for(n = 0; n < LEN; ++n) out->data[(*pos)++] = in[p++];
+  if(LEN > 0) memcpy(out->data + (*pos), in + p, LEN);
+  (*pos) += LEN;
+  p += LEN;
 
   (*bp) = p * 8;
 
   return error;
 }
 
+/*inflates in into out. If sink is not NULL, everything is written to it and out only keeps a sliding window*/
 static unsigned lodepng_inflatev(ucvector* out,
                                  const unsigned char* in, size_t insize,
-                                 const LodePNGDecompressSettings* settings)
+                                 const LodePNGDecompressSettings* settings, InflateSink* sink)
 {
   /*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)*/
   size_t bp = 0;
@@ -1268,8 +1541,9 @@ static unsigned lodepng_inflatev(ucvector* out,
 
     if(BTYPE == 3) return 20; /*error: invalid BTYPE*/
     else if(BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize); /*no compression*/
-    else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE); /*compression, BTYPE 01 or 10*/
+    else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE, sink); /*compression, BTYPE 01 or 10*/
 
+    if(!error && sink && (BFINAL || pos >= INFLATE_FLUSH_SIZE)) error = inflateFlush(out, &pos, sink);
     if(error) return error;
   }
 
@@ -1283,7 +1557,7 @@ unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
   unsigned error;
   ucvector v;
   ucvector_init_buffer(&v, *out, *outsize);
-  error = lodepng_inflatev(&v, in, insize, settings);
+  error = lodepng_inflatev(&v, in, insize, settings, 0);
   *out = v.data;
   *outsize = v.size;
   return error;
@@ -1646,26 +1920,27 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
 
 /* /////////////////////////////////////////////////////////////////////////// */
 
-static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize)
+static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize, unsigned final)
 {
   /*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
   2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
 
   size_t i, j, numdeflateblocks = (datasize + 65534) / 65535;
-  unsigned datapos = 0;
+  size_t datapos = 0;
+  if(numdeflateblocks == 0) numdeflateblocks = 1; /*empty input still needs one (empty) block*/
   for(i = 0; i != numdeflateblocks; ++i)
   {
     unsigned BFINAL, BTYPE, LEN, NLEN;
     unsigned char firstbyte;
 
-    BFINAL = (i == numdeflateblocks - 1);
+    BFINAL = final && (i == numdeflateblocks - 1);
     BTYPE = 0;
 
     firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1) << 1) + ((BTYPE & 2) << 1));
     ucvector_push_back(out, firstbyte);
 
     LEN = 65535;
-    if(datasize - datapos < 65535) LEN = (unsigned)datasize - datapos;
+    if(datasize - datapos < 65535) LEN = (unsigned)(datasize - datapos);
     NLEN = 65535 - LEN;
 
     ucvector_push_back(out, (unsigned char)(LEN & 255));
@@ -2010,8 +2285,13 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
   return error;
 }
 
+/*
+If final is 0, no block gets BFINAL set and the output is terminated with an empty
+stored block (a zlib "full flush"), leaving it byte aligned so another independently
+compressed piece can be appended directly after it.
+*/
 static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-                                 const LodePNGCompressSettings* settings)
+                                 const LodePNGCompressSettings* settings, unsigned final)
 {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
@@ -2019,7 +2299,7 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
   Hash hash;
 
   if(settings->btype > 2) return 61;
-  else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
+  else if(settings->btype == 0) return deflateNoCompression(out, in, insize, final);
   else if(settings->btype == 1) blocksize = insize;
   else /*if(settings->btype == 2)*/
   {
@@ -2037,13 +2317,23 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 
   for(i = 0; i != numdeflateblocks && !error; ++i)
   {
-    unsigned final = (i == numdeflateblocks - 1);
+    unsigned lastblock = final && (i == numdeflateblocks - 1);
     size_t start = i * blocksize;
     size_t end = start + blocksize;
     if(end > insize) end = insize;
 
-    if(settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, final);
-    else if(settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final);
+    if(settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, lastblock);
+    else if(settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, lastblock);
+  }
+
+  if(!error && !final)
+  {
+    /*empty stored block: BFINAL 0, BTYPE 00, pad to the byte boundary, LEN 0, NLEN 65535*/
+    addBitsToStream(&bp, out, 0, 3);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 255);
+    ucvector_push_back(out, 255);
   }
 
   hash_cleanup(&hash);
@@ -2054,11 +2344,18 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings)
+{
+  return lodepng_deflate_chunk(out, outsize, in, insize, settings, 1);
+}
+
+unsigned lodepng_deflate_chunk(unsigned char** out, size_t* outsize,
+                               const unsigned char* in, size_t insize,
+                               const LodePNGCompressSettings* settings, unsigned final)
 {
   unsigned error;
   ucvector v;
   ucvector_init_buffer(&v, *out, *outsize);
-  error = lodepng_deflatev(&v, in, insize, settings);
+  error = lodepng_deflatev(&v, in, insize, settings, final);
   *out = v.data;
   *outsize = v.size;
   return error;
@@ -2084,6 +2381,16 @@ static unsigned deflate(unsigned char** out, size_t* outsize,
 /* / Adler32                                                                  */
 /* ////////////////////////////////////////////////////////////////////////// */
 
+#ifdef LODEPNG_SSE2
+/*sum of the four 32-bit lanes of v*/
+static unsigned long long sumLanes32(__m128i v)
+{
+  unsigned lanes[4];
+  _mm_storeu_si128((__m128i*)lanes, v);
+  return (unsigned long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+#endif /*LODEPNG_SSE2*/
+
 static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len)
 {
   unsigned s1 = adler & 0xffff;
@@ -2094,6 +2401,46 @@ static unsigned update_adler32(unsigned adler, const unsigned char* data, unsign
     /*at least 5552 sums can be done before the sums overflow, saving a lot of module divisions*/
     unsigned amount = len > 5552 ? 5552 : len;
     len -= amount;
+#ifdef LODEPNG_SSE2
+    if(amount >= 16)
+    {
+      /*16 bytes per step: s1 gains the byte sum, s2 gains 16 * s1 plus the bytes weighted 16..1*/
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i weights_lo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+      const __m128i weights_hi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+      __m128i vs1 = zero, vs2 = zero, vprefix = zero;
+      unsigned chunks = amount / 16;
+      unsigned long long sum2;
+      unsigned i;
+      for(i = 0; i != chunks; ++i)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i*)data);
+        vprefix = _mm_add_epi32(vprefix, vs1);
+        vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(v, zero));
+        vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights_lo));
+        vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights_hi));
+        data += 16;
+      }
+      sum2 = s2 + (unsigned long long)s1 * 16u * chunks + 16u * sumLanes32(vprefix) + sumLanes32(vs2);
+      s1 += (unsigned)sumLanes32(vs1);
+      s2 = (unsigned)(sum2 % 65521u);
+      amount -= chunks * 16;
+    }
+#else /*LODEPNG_SSE2*/
+    while(amount >= 8)
+    {
+      s1 += data[0]; s2 += s1;
+      s1 += data[1]; s2 += s1;
+      s1 += data[2]; s2 += s1;
+      s1 += data[3]; s2 += s1;
+      s1 += data[4]; s2 += s1;
+      s1 += data[5]; s2 += s1;
+      s1 += data[6]; s2 += s1;
+      s1 += data[7]; s2 += s1;
+      data += 8;
+      amount -= 8;
+    }
+#endif /*LODEPNG_SSE2*/
     while(amount > 0)
     {
       s1 += (*data++);
@@ -2113,16 +2460,44 @@ static unsigned adler32(const unsigned char* data, unsigned len)
   return update_adler32(1L, data, len);
 }
 
+unsigned lodepng_adler32(const unsigned char* data, size_t len)
+{
+  unsigned adler = 1;
+  while(len > 0)
+  {
+    unsigned amount = len > 1073741824u ? 1073741824u : (unsigned)len;
+    adler = update_adler32(adler, data, amount);
+    data += amount;
+    len -= amount;
+  }
+  return adler;
+}
+
+unsigned lodepng_adler32_combine(unsigned adler1, unsigned adler2, size_t len2)
+{
+  /*same arithmetic as zlib's adler32_combine, kept below 2 * BASE to avoid overflow*/
+  const unsigned BASE = 65521;
+  unsigned rem = (unsigned)(len2 % BASE);
+  unsigned sum1 = adler1 & 0xffff;
+  unsigned sum2 = (unsigned)(((unsigned long long)rem * sum1) % BASE);
+  sum1 += (adler2 & 0xffff) + BASE - 1;
+  sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + BASE - rem;
+  if(sum1 >= BASE) sum1 -= BASE;
+  if(sum1 >= BASE) sum1 -= BASE;
+  if(sum2 >= (BASE << 1)) sum2 -= (BASE << 1);
+  if(sum2 >= BASE) sum2 -= BASE;
+  return (sum2 << 16) | sum1;
+}
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Zlib                                                                   / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-                                 size_t insize, const LodePNGDecompressSettings* settings)
+/*checks the 2-byte zlib header at the start of in. return value is error*/
+static unsigned zlib_checkHeader(const unsigned char* in, size_t insize)
 {
-  unsigned error = 0;
   unsigned CM, CINFO, FDICT;
 
   if(insize < 2) return 53; /*error, size of zlib data too small*/
@@ -2151,6 +2526,15 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
     return 26;
   }
 
+  return 0;
+}
+
+unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                 size_t insize, const LodePNGDecompressSettings* settings)
+{
+  unsigned error = zlib_checkHeader(in, insize);
+  if(error) return error;
+
   error = inflate(out, outsize, in + 2, insize - 2, settings);
   if(error) return error;
 
@@ -2177,6 +2561,41 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsi
   }
 }
 
+/*like zlib_decompress, but hands the data to sink as it is inflated instead of returning it*/
+static unsigned zlib_decompress_stream(const unsigned char* in, size_t insize,
+                                       const LodePNGDecompressSettings* settings, InflateSink* sink)
+{
+  unsigned error;
+  ucvector window;
+
+  if(settings->custom_zlib || settings->custom_inflate)
+  {
+    /*custom decompressors only work on whole buffers*/
+    unsigned char* buffer = 0;
+    size_t buffersize = 0;
+    error = zlib_decompress(&buffer, &buffersize, in, insize, settings);
+    if(!error) error = sink->write(sink->data, buffer, buffersize);
+    lodepng_free(buffer);
+    return error;
+  }
+
+  error = zlib_checkHeader(in, insize);
+  if(error) return error;
+
+  ucvector_init(&window);
+  error = lodepng_inflatev(&window, in + 2, insize - 2, settings, sink);
+  ucvector_cleanup(&window);
+  if(error) return error;
+
+  if(!settings->ignore_adler32)
+  {
+    unsigned ADLER32 = lodepng_read32bitInt(&in[insize - 4]);
+    if(sink->adler != ADLER32) return 58; /*error, adler checksum not correct, data must be corrupted*/
+  }
+
+  return 0; /*no error*/
+}
+
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -2247,6 +2666,18 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsi
   if(!settings->custom_zlib) return 87; /*no custom zlib function provided */
   return settings->custom_zlib(out, outsize, in, insize, settings);
 }
+
+/*the custom zlib function works on whole buffers, so the data goes to sink in one piece*/
+static unsigned zlib_decompress_stream(const unsigned char* in, size_t insize,
+                                       const LodePNGDecompressSettings* settings, InflateSink* sink)
+{
+  unsigned char* buffer = 0;
+  size_t buffersize = 0;
+  unsigned error = zlib_decompress(&buffer, &buffersize, in, insize, settings);
+  if(!error) error = sink->write(sink->data, buffer, buffersize);
+  lodepng_free(buffer);
+  return error;
+}
 #endif /*LODEPNG_COMPILE_DECODER*/
 #ifdef LODEPNG_COMPILE_ENCODER
 static unsigned zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
@@ -2351,12 +2782,50 @@ static unsigned lodepng_crc32_table[256] = {
   3009837614u, 3294710456u, 1567103746u,  711928724u, 3020668471u, 3272380065u, 1510334235u,  755167117u
 };
 
+/*
+Tables for slice-by-8: entry i of table k is the CRC contribution of byte value i
+followed by k zero bytes. Table 0 is lodepng_crc32_table.
+*/
+struct LodePNGCRC32Slices
+{
+  unsigned table[8][256];
+
+  LodePNGCRC32Slices()
+  {
+    unsigned i, k;
+    for(i = 0; i != 256; ++i) table[0][i] = lodepng_crc32_table[i];
+    for(k = 1; k != 8; ++k)
+    {
+      for(i = 0; i != 256; ++i) table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+    }
+  }
+};
+
+static const LodePNGCRC32Slices& getCRC32Slices()
+{
+  static const LodePNGCRC32Slices slices; /*built once, on first use*/
+  return slices;
+}
+
 /*Return the CRC of the bytes buf[0..len-1].*/
 unsigned lodepng_crc32(const unsigned char* data, size_t length)
 {
   unsigned r = 0xffffffffu;
-  size_t i;
-  for(i = 0; i < length; ++i)
+  size_t i = 0;
+  if(length >= 16)
+  {
+    /*eight bytes per step*/
+    const unsigned (*t)[256] = getCRC32Slices().table;
+    for(; i + 8 <= length; i += 8)
+    {
+      const unsigned char* p = data + i;
+      unsigned lo = r ^ (p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) | ((unsigned)p[3] << 24));
+      unsigned hi = p[4] | ((unsigned)p[5] << 8) | ((unsigned)p[6] << 16) | ((unsigned)p[7] << 24);
+      r = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+        ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+  }
+  for(; i < length; ++i)
   {
     r = lodepng_crc32_table[(r ^ data[i]) & 0xff] ^ (r >> 8);
   }
@@ -4182,6 +4651,109 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
   return state->error;
 }
 
+#ifdef LODEPNG_SSE2
+/*loads one pixel of 3 or 4 bytes into the low bytes of a register*/
+static __m128i loadPixel(const unsigned char* p, size_t bytewidth)
+{
+  unsigned v = 0;
+  memcpy(&v, p, bytewidth);
+  return _mm_cvtsi32_si128((int)v);
+}
+
+static void storePixel(unsigned char* p, __m128i v, size_t bytewidth)
+{
+  unsigned value = (unsigned)_mm_cvtsi128_si32(v);
+  memcpy(p, &value, bytewidth);
+}
+
+/*
+SSE2 versions of the filters for which it pays off. recon may alias scanline: every
+load of scanline happens before the store to the same or later bytes of recon.
+Return value is nonzero if the scanline was handled, otherwise the scalar code runs.
+*/
+static unsigned unfilterScanlineSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                     size_t bytewidth, unsigned char filterType, size_t length)
+{
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+
+  if(filterType == 2 && precon)
+  {
+    for(; i + 16 <= length; i += 16)
+    {
+      __m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(precon + i));
+      _mm_storeu_si128((__m128i*)(recon + i), _mm_add_epi8(x, b));
+    }
+    for(; i != length; ++i) recon[i] = scanline[i] + precon[i];
+    return 1;
+  }
+
+  if(filterType == 1 && bytewidth == 4)
+  {
+    /*prefix sum of four pixels in-register, plus the last pixel of the previous step*/
+    __m128i a = zero;
+    for(; i + 16 <= length; i += 16)
+    {
+      __m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi8(x, a);
+      _mm_storeu_si128((__m128i*)(recon + i), x);
+      a = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    for(; i != length; ++i) recon[i] = scanline[i] + (i >= 4 ? recon[i - 4] : 0);
+    return 1;
+  }
+
+  if((filterType == 3 || filterType == 4) && precon && (bytewidth == 3 || bytewidth == 4))
+  {
+    /*one pixel per step, the left neighbour a and upper-left neighbour c stay in registers*/
+    __m128i a = zero, c = zero;
+    if(filterType == 3)
+    {
+      const __m128i one = _mm_set1_epi8(1);
+      for(; i + bytewidth <= length; i += bytewidth)
+      {
+        __m128i b = loadPixel(precon + i, bytewidth);
+        /*floor((a + b) / 2): _mm_avg_epu8 rounds up when a + b is odd*/
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(loadPixel(scanline + i, bytewidth), avg);
+        storePixel(recon + i, a, bytewidth);
+      }
+    }
+    else
+    {
+      for(; i + bytewidth <= length; i += bytewidth)
+      {
+        __m128i b = _mm_unpacklo_epi8(loadPixel(precon + i, bytewidth), zero);
+        __m128i a16 = _mm_unpacklo_epi8(a, zero);
+        __m128i pa = _mm_sub_epi16(b, c); /*p - a*/
+        __m128i pb = _mm_sub_epi16(a16, c); /*p - b*/
+        __m128i pc = _mm_add_epi16(pa, pb); /*p - c*/
+        __m128i smallest, choose_a, choose_b, predictor;
+        pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+        pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+        pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+        smallest = _mm_min_epi16(pa, _mm_min_epi16(pb, pc));
+        /*ties prefer a, then b, as in paethPredictor*/
+        choose_a = _mm_cmpeq_epi16(smallest, pa);
+        choose_b = _mm_andnot_si128(choose_a, _mm_cmpeq_epi16(smallest, pb));
+        predictor = _mm_or_si128(_mm_and_si128(choose_a, a16),
+                    _mm_or_si128(_mm_and_si128(choose_b, b),
+                                 _mm_andnot_si128(_mm_or_si128(choose_a, choose_b), c)));
+        a = _mm_add_epi8(loadPixel(scanline + i, bytewidth), _mm_packus_epi16(predictor, zero));
+        storePixel(recon + i, a, bytewidth);
+        c = b;
+      }
+    }
+    return 1;
+  }
+
+  return 0;
+}
+#endif /*LODEPNG_SSE2*/
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
                                  size_t bytewidth, unsigned char filterType, size_t length)
 {
@@ -4195,6 +4767,9 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   */
 
   size_t i;
+#ifdef LODEPNG_SSE2
+  if(unfilterScanlineSSE2(recon, scanline, precon, bytewidth, filterType, length)) return 0;
+#endif /*LODEPNG_SSE2*/
   switch(filterType)
   {
     case 0:
@@ -4822,17 +5397,13 @@ static unsigned readChunk_iCCP(LodePNGInfo* info, const LodePNGDecompressSetting
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-                          LodePNGState* state,
-                          const unsigned char* in, size_t insize)
+/*reads all chunks into state->info_png and concatenates the IDAT data into idat, which must be initialized*/
+static void readChunks(unsigned* w, unsigned* h, LodePNGState* state,
+                       const unsigned char* in, size_t insize, ucvector* idat)
 {
   unsigned char IEND = 0;
   const unsigned char* chunk;
   size_t i;
-  ucvector idat; /*the data from idat chunks*/
-  ucvector scanlines;
-  size_t predict;
-  size_t outsize = 0;
 
   /*for unknown chunk order*/
   unsigned unknown = 0;
@@ -4840,9 +5411,6 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-  /*provide some proper output values if error will happen*/
-  *out = 0;
-
   state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
   if(state->error) return;
 
@@ -4851,7 +5419,6 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     CERROR_RETURN(state->error, 92); /*overflow possible due to amount of pixels*/
   }
 
-  ucvector_init(&idat);
   chunk = &in[33]; /*first byte of the first chunk after the header*/
 
   /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
@@ -4889,11 +5456,11 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     /*IDAT chunk, containing compressed image data*/
     if(lodepng_chunk_type_equals(chunk, "IDAT"))
     {
-      size_t oldsize = idat.size;
+      size_t oldsize = idat->size;
       size_t newsize;
       if(lodepng_addofl(oldsize, chunkLength, &newsize)) CERROR_BREAK(state->error, 95);
-      if(!ucvector_resize(&idat, newsize)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-      for(i = 0; i != chunkLength; ++i) idat.data[oldsize + i] = data[i];
+      if(!ucvector_resize(idat, newsize)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+      for(i = 0; i != chunkLength; ++i) idat->data[oldsize + i] = data[i];
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
       critical_pos = 3;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
@@ -5011,6 +5578,28 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 
     if(!IEND) chunk = lodepng_chunk_next_const(chunk);
   }
+}
+
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                          LodePNGState* state,
+                          const unsigned char* in, size_t insize)
+{
+  size_t i;
+  ucvector idat; /*the data from idat chunks*/
+  ucvector scanlines;
+  size_t predict;
+  size_t outsize = 0;
+
+  /*provide some proper output values if error will happen*/
+  *out = 0;
+
+  ucvector_init(&idat);
+  readChunks(w, h, state, in, insize, &idat);
+  if(state->error)
+  {
+    ucvector_cleanup(&idat);
+    return;
+  }
 
   ucvector_init(&scanlines);
   /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
@@ -5100,6 +5689,420 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
   return state->error;
 }
 
+/*state shared by the steps of lodepng_decode_rows*/
+typedef struct ScanlineStream
+{
+  LodePNGState* state;
+  unsigned w, h;
+  size_t linebytes; /*bytes per scanline in the PNG color mode, without filter type byte*/
+  size_t bytewidth; /*filter distance*/
+  unsigned char* filtered; /*filter type byte and filtered scanline while it is collected*/
+  size_t filled; /*bytes of filtered collected so far*/
+  unsigned char* lines; /*the previous and the current unfiltered scanline, alternating*/
+  unsigned char* converted; /*the current scanline in the info_raw color mode, NULL if no conversion*/
+  unsigned y; /*next scanline to finish*/
+  LodePNGRowCallback callback;
+  void* user;
+} ScanlineStream;
+
+/*converts a finished scanline in the PNG color mode if needed and hands it to the callback*/
+static unsigned ScanlineStream_emit(ScanlineStream* stream, const unsigned char* line)
+{
+  unsigned error;
+  if(stream->converted)
+  {
+    error = lodepng_convert(stream->converted, line, &stream->state->info_raw,
+                            &stream->state->info_png.color, stream->w, 1);
+    if(error) return error;
+    line = stream->converted;
+  }
+  error = stream->callback(stream->user, stream->y, line);
+  ++stream->y;
+  return error;
+}
+
+/*unfilters one scanline, given as filter type byte followed by the filtered bytes*/
+static unsigned ScanlineStream_unfilter(ScanlineStream* stream, const unsigned char* filtered)
+{
+  unsigned char* recon = &stream->lines[(stream->y & 1u) * stream->linebytes];
+  const unsigned char* precon = stream->y ? &stream->lines[((stream->y - 1) & 1u) * stream->linebytes] : 0;
+  CERROR_TRY_RETURN(unfilterScanline(recon, &filtered[1], precon, stream->bytewidth, filtered[0], stream->linebytes));
+  return ScanlineStream_emit(stream, recon);
+}
+
+/*InflateSink write function: cuts the inflated data into scanlines*/
+static unsigned ScanlineStream_write(void* data, const unsigned char* bytes, size_t size)
+{
+  ScanlineStream* stream = (ScanlineStream*)data;
+  const size_t fullsize = stream->linebytes + 1;
+  while(size > 0)
+  {
+    if(stream->y >= stream->h) return 91; /*more data than the image has scanlines*/
+    if(stream->filled == 0 && size >= fullsize)
+    {
+      /*whole scanline available, no need to copy it*/
+      CERROR_TRY_RETURN(ScanlineStream_unfilter(stream, bytes));
+      bytes += fullsize;
+      size -= fullsize;
+    }
+    else
+    {
+      size_t amount = fullsize - stream->filled;
+      if(amount > size) amount = size;
+      memcpy(&stream->filtered[stream->filled], bytes, amount);
+      stream->filled += amount;
+      bytes += amount;
+      size -= amount;
+      if(stream->filled == fullsize)
+      {
+        stream->filled = 0;
+        CERROR_TRY_RETURN(ScanlineStream_unfilter(stream, stream->filtered));
+      }
+    }
+  }
+  return 0;
+}
+
+/*allocates the conversion buffer if info_raw differs from the PNG color mode, once the chunks are read*/
+static unsigned ScanlineStream_prepareConvert(ScanlineStream* stream)
+{
+  LodePNGState* state = stream->state;
+  if(!state->decoder.color_convert || lodepng_color_mode_equal(&state->info_raw, &state->info_png.color)) return 0;
+  if(!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+     && !(state->info_raw.bitdepth == 8))
+  {
+    return 56; /*unsupported color mode conversion, same rule as lodepng_decode*/
+  }
+  stream->converted = (unsigned char*)lodepng_malloc(lodepng_get_raw_size(stream->w, 1, &state->info_raw));
+  if(!stream->converted) return 83; /*alloc fail*/
+  return 0;
+}
+
+/*lodepng_decode_rows for Adam7 images: decode whole, then hand out the rows*/
+static unsigned decodeRowsInterlaced(ScanlineStream* stream, const unsigned char* in, size_t insize)
+{
+  unsigned char* image = 0;
+  unsigned char* row = 0;
+  unsigned w, h, y;
+  unsigned error = 0;
+  unsigned color_convert = stream->state->decoder.color_convert;
+  unsigned bpp = lodepng_get_bpp(&stream->state->info_png.color);
+  size_t linebits = (size_t)stream->w * bpp;
+
+  /*rows stay in the PNG color mode until ScanlineStream_emit*/
+  stream->state->decoder.color_convert = 0;
+  decodeGeneric(&image, &w, &h, stream->state, in, insize);
+  stream->state->decoder.color_convert = color_convert;
+  error = stream->state->error;
+  if(!error) error = ScanlineStream_prepareConvert(stream);
+
+  if(!error && linebits % 8 != 0)
+  {
+    /*with less than 8 bits per pixel, rows are packed without padding and may start mid-byte*/
+    row = (unsigned char*)lodepng_malloc((linebits + 7) / 8);
+    if(!row) error = 83; /*alloc fail*/
+  }
+  for(y = 0; !error && y < h; ++y)
+  {
+    if(row)
+    {
+      size_t ibp = y * linebits, obp = 0, i;
+      for(i = 0; i != linebits; ++i) setBitOfReversedStream(&obp, row, readBitFromReversedStream(&ibp, image));
+      error = ScanlineStream_emit(stream, row);
+    }
+    else error = ScanlineStream_emit(stream, &image[y * (linebits / 8)]);
+  }
+
+  lodepng_free(row);
+  lodepng_free(image);
+  return error;
+}
+
+unsigned lodepng_decode_rows(unsigned* w, unsigned* h, LodePNGState* state,
+                             const unsigned char* in, size_t insize,
+                             LodePNGRowCallback callback, void* user)
+{
+  ScanlineStream stream;
+  ucvector idat;
+  InflateSink sink;
+
+  *w = *h = 0;
+  state->error = lodepng_inspect(w, h, state, in, insize);
+  if(state->error) return state->error;
+
+  stream.state = state;
+  stream.w = *w;
+  stream.h = *h;
+  stream.linebytes = lodepng_get_raw_size(*w, 1, &state->info_png.color);
+  stream.bytewidth = (lodepng_get_bpp(&state->info_png.color) + 7) / 8;
+  stream.filled = 0;
+  stream.y = 0;
+  stream.callback = callback;
+  stream.user = user;
+  stream.filtered = 0;
+  stream.lines = 0;
+  stream.converted = 0;
+
+  if(state->info_png.interlace_method != 0)
+  {
+    state->error = decodeRowsInterlaced(&stream, in, insize);
+    lodepng_free(stream.converted);
+    return state->error;
+  }
+
+  stream.filtered = (unsigned char*)lodepng_malloc(stream.linebytes + 1);
+  stream.lines = (unsigned char*)lodepng_malloc(stream.linebytes * 2);
+  ucvector_init(&idat);
+  if(!stream.filtered || !stream.lines) state->error = 83; /*alloc fail*/
+  if(!state->error) readChunks(w, h, state, in, insize, &idat);
+  if(!state->error) state->error = ScanlineStream_prepareConvert(&stream);
+  if(!state->error)
+  {
+    InflateSink_init(&sink, ScanlineStream_write, &stream);
+    state->error = zlib_decompress_stream(idat.data, idat.size, &state->decoder.zlibsettings, &sink);
+    /*the decompressed data must cover exactly all scanlines*/
+    if(!state->error && (stream.y != stream.h || stream.filled != 0)) state->error = 91;
+  }
+
+  ucvector_cleanup(&idat);
+  lodepng_free(stream.filtered);
+  lodepng_free(stream.lines);
+  lodepng_free(stream.converted);
+  return state->error;
+}
+
+/*state of lodepng_decode_into*/
+typedef struct StridedTarget
+{
+  unsigned char* out;
+  size_t stride;
+  size_t linebytes;
+} StridedTarget;
+
+static unsigned StridedTarget_write(void* user, unsigned y, const unsigned char* row)
+{
+  StridedTarget* target = (StridedTarget*)user;
+  memcpy(&target->out[y * target->stride], row, target->linebytes);
+  return 0;
+}
+
+unsigned lodepng_decode_into(unsigned char* out, size_t stride, unsigned w, unsigned h,
+                             LodePNGState* state, const unsigned char* in, size_t insize)
+{
+  StridedTarget target;
+  unsigned pngw, pngh;
+
+  state->error = lodepng_inspect(&pngw, &pngh, state, in, insize);
+  if(state->error) return state->error;
+  target.linebytes = lodepng_get_raw_size(w, 1, state->decoder.color_convert ? &state->info_raw : &state->info_png.color);
+  if(pngw != w || pngh != h || stride < target.linebytes)
+  {
+    CERROR_RETURN_ERROR(state->error, 105); /*the image does not fit the output buffer*/
+  }
+  target.out = out;
+  target.stride = stride;
+  return lodepng_decode_rows(&pngw, &pngh, state, in, insize, StridedTarget_write, &target);
+}
+
+/*state of the box filter of lodepng_decode_reduced32*/
+typedef struct BoxReducer
+{
+  unsigned char* out; /*reduced RGBA image*/
+  unsigned w, h; /*size of the full image*/
+  unsigned rw; /*width of the reduced image*/
+  unsigned scale;
+  unsigned* sums; /*per reduced pixel and channel: sum over the current band of scanlines*/
+} BoxReducer;
+
+static unsigned BoxReducer_write(void* user, unsigned y, const unsigned char* row)
+{
+  BoxReducer* box = (BoxReducer*)user;
+  unsigned x, c;
+  for(x = 0; x != box->w; ++x)
+  {
+    for(c = 0; c != 4; ++c) box->sums[(x / box->scale) * 4 + c] += row[x * 4 + c];
+  }
+  if(y % box->scale == box->scale - 1 || y == box->h - 1)
+  {
+    /*band complete: average it into one reduced scanline*/
+    unsigned bandh = y % box->scale + 1;
+    unsigned char* line = &box->out[(size_t)(y / box->scale) * box->rw * 4];
+    for(x = 0; x != box->rw; ++x)
+    {
+      unsigned boxw = (x + 1) * box->scale <= box->w ? box->scale : box->w - x * box->scale;
+      unsigned count = boxw * bandh;
+      for(c = 0; c != 4; ++c)
+      {
+        line[x * 4 + c] = (unsigned char)((box->sums[x * 4 + c] + count / 2) / count);
+        box->sums[x * 4 + c] = 0;
+      }
+    }
+  }
+  return 0;
+}
+
+/*returned by AdamPrefix_write once enough passes are in, to stop inflating early*/
+#define ADAM7_PREFIX_COMPLETE 0xffffffffu
+
+/*collects the start of the inflated data of an Adam7 image, see lodepng_decode_reduced32*/
+typedef struct AdamPrefix
+{
+  ucvector data;
+  size_t needed;
+} AdamPrefix;
+
+static unsigned AdamPrefix_write(void* user, const unsigned char* bytes, size_t size)
+{
+  AdamPrefix* prefix = (AdamPrefix*)user;
+  size_t oldsize = prefix->data.size;
+  if(!ucvector_resize(&prefix->data, oldsize + size)) return 83; /*alloc fail*/
+  memcpy(&prefix->data.data[oldsize], bytes, size);
+  return prefix->data.size >= prefix->needed ? ADAM7_PREFIX_COMPLETE : 0;
+}
+
+/*lodepng_decode_reduced32 for Adam7 images: samples the pixels of the first passes*/
+static unsigned decodeReducedInterlaced(unsigned char** out, unsigned rw, unsigned rh, unsigned scale,
+                                        LodePNGState* state, const unsigned char* in, size_t insize)
+{
+  unsigned w, h, i, x, y, pass, passes, grid;
+  unsigned bpp = lodepng_get_bpp(&state->info_png.color);
+  unsigned passw[7], passh[7];
+  size_t filter_passstart[8], padded_passstart[8], passstart[8];
+  unsigned char* reduced = 0;
+  ucvector idat;
+  InflateSink sink;
+  AdamPrefix prefix;
+  LodePNGColorMode rgba;
+
+  ucvector_init(&idat);
+  readChunks(&w, &h, state, in, insize, &idat);
+  if(state->error)
+  {
+    ucvector_cleanup(&idat);
+    return state->error;
+  }
+
+  /*after pass 1 every 8th pixel in both directions is known, after pass 3 every 4th, after pass 5 every 2nd.
+  Sample points x * scale line up with the grid of the largest power of two (up to 8) that divides scale*/
+  grid = 1;
+  while(grid < 8 && scale % (grid * 2) == 0) grid *= 2;
+  passes = grid == 8 ? 1 : grid == 4 ? 3 : grid == 2 ? 5 : 7;
+
+  Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+
+  ucvector_init(&prefix.data);
+  prefix.needed = filter_passstart[passes];
+  InflateSink_init(&sink, AdamPrefix_write, &prefix);
+  state->error = prefix.needed == 0 ? 0
+               : zlib_decompress_stream(idat.data, idat.size, &state->decoder.zlibsettings, &sink);
+  if(state->error == ADAM7_PREFIX_COMPLETE) state->error = 0;
+  if(!state->error && prefix.data.size < prefix.needed) state->error = 91; /*not enough data for the passes*/
+  ucvector_cleanup(&idat);
+
+  for(i = 0; !state->error && i != passes; ++i)
+  {
+    state->error = unfilter(&prefix.data.data[padded_passstart[i]], &prefix.data.data[filter_passstart[i]],
+                            passw[i], passh[i], bpp);
+    if(!state->error && bpp < 8)
+    {
+      removePaddingBits(&prefix.data.data[passstart[i]], &prefix.data.data[padded_passstart[i]],
+                        passw[i] * bpp, ((passw[i] * bpp + 7) / 8) * 8, passh[i]);
+    }
+  }
+
+  if(!state->error)
+  {
+    reduced = (unsigned char*)lodepng_malloc(((size_t)rw * rh * bpp + 7) / 8);
+    *out = (unsigned char*)lodepng_malloc((size_t)rw * rh * 4);
+    if(!reduced || !*out) state->error = 83; /*alloc fail*/
+  }
+  for(y = 0; !state->error && y != rh; ++y)
+  {
+    for(x = 0; x != rw; ++x)
+    {
+      unsigned fx = x * scale, fy = y * scale;
+      size_t index, obp = ((size_t)y * rw + x) * bpp;
+      /*the first pass whose grid contains the full resolution pixel*/
+      for(pass = 0; pass != passes; ++pass)
+      {
+        if(fx >= ADAM7_IX[pass] && fy >= ADAM7_IY[pass]
+           && (fx - ADAM7_IX[pass]) % ADAM7_DX[pass] == 0 && (fy - ADAM7_IY[pass]) % ADAM7_DY[pass] == 0) break;
+      }
+      index = (size_t)((fy - ADAM7_IY[pass]) / ADAM7_DY[pass]) * passw[pass] + (fx - ADAM7_IX[pass]) / ADAM7_DX[pass];
+      if(bpp >= 8)
+      {
+        memcpy(&reduced[obp / 8], &prefix.data.data[passstart[pass] + index * (bpp / 8)], bpp / 8);
+      }
+      else
+      {
+        size_t ibp = passstart[pass] * 8 + index * bpp;
+        for(i = 0; i != bpp; ++i) setBitOfReversedStream(&obp, reduced, readBitFromReversedStream(&ibp, prefix.data.data));
+      }
+    }
+  }
+
+  if(!state->error)
+  {
+    lodepng_color_mode_init(&rgba); /*8-bit RGBA*/
+    state->error = lodepng_convert(*out, reduced, &rgba, &state->info_png.color, rw, rh);
+  }
+  ucvector_cleanup(&prefix.data);
+  lodepng_free(reduced);
+  return state->error;
+}
+
+unsigned lodepng_decode_reduced32(unsigned char** out, unsigned* w, unsigned* h,
+                                  LodePNGState* state, const unsigned char* in, size_t insize,
+                                  unsigned scale)
+{
+  unsigned fullw, fullh, rw, rh;
+
+  *out = 0;
+  *w = *h = 0;
+  if(scale == 0) scale = 1;
+  state->error = lodepng_inspect(&fullw, &fullh, state, in, insize);
+  if(state->error) return state->error;
+  rw = (fullw + scale - 1) / scale;
+  rh = (fullh + scale - 1) / scale;
+
+  if(state->info_png.interlace_method != 0)
+  {
+    state->error = decodeReducedInterlaced(out, rw, rh, scale, state, in, insize);
+  }
+  else
+  {
+    BoxReducer box;
+    LodePNGColorMode raw = state->info_raw;
+    box.w = fullw;
+    box.h = fullh;
+    box.rw = rw;
+    box.scale = scale;
+    box.out = (unsigned char*)lodepng_malloc((size_t)rw * rh * 4);
+    box.sums = (unsigned*)lodepng_malloc((size_t)rw * 4 * sizeof(unsigned));
+    if(!box.out || !box.sums) state->error = 83; /*alloc fail*/
+    else
+    {
+      memset(box.sums, 0, (size_t)rw * 4 * sizeof(unsigned));
+      /*the filter works on 8-bit RGBA scanlines; info_raw is restored afterwards*/
+      lodepng_color_mode_init(&state->info_raw);
+      lodepng_decode_rows(&fullw, &fullh, state, in, insize, BoxReducer_write, &box);
+      state->info_raw = raw;
+    }
+    lodepng_free(box.sums);
+    *out = box.out;
+  }
+
+  if(state->error)
+  {
+    lodepng_free(*out);
+    *out = 0;
+    return state->error;
+  }
+  *w = rw;
+  *h = rh;
+  return 0;
+}
+
 unsigned lodepng_decode_memory(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in,
                                size_t insize, LodePNGColorType colortype, unsigned bitdepth)
 {
@@ -6510,6 +7513,7 @@ const char* lodepng_error_text(unsigned code)
     case 102: return "not allowed to set greyscale ICC profile with colored pixels by PNG specification";
     case 103: return "Invalid palette index in bKGD chunk. Maybe it came before PLTE chunk?";
     case 104: return "Invalid bKGD color while encoding (e.g. palette index out of range)";
+    case 105: return "image size does not match the output buffer";
   }
   return "unknown error code";
 }
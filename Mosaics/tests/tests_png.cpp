@@ -0,0 +1,307 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cs225/PNG.h"
+#include "cs225/PNGEncoder.h"
+#include "cs225/LUVAPixel.h"
+#include "lodepng/lodepng.h"
+
+using namespace cs225;
+
+TEST_CASE("Parallel encoder round-trips an image at every level", "[png]") {
+  PNG source;
+  REQUIRE( source.readFromFile("../data/source.png") );
+
+  for (int level : {0, 1, 6, 9}) {
+    EncodeOptions options;
+    options.level = level;
+    options.threads = 4;
+    options.rowsPerGroup = 7;
+    REQUIRE( source.writeToFile("encoder-actual.png", options) );
+
+    PNG decoded;
+    REQUIRE( decoded.readFromFile("encoder-actual.png") );
+    REQUIRE( decoded == source );
+  }
+}
+
+TEST_CASE("Streaming encoder writes palette rows one at a time", "[png]") {
+  const unsigned width = 13, height = 9;
+  {
+    PNGEncoder encoder("palette-actual.png", width, height, PNGColorType::PALETTE, 1);
+    encoder.setPalette({0, 0, 0, 255, 255, 255, 255, 255});
+    REQUIRE( encoder.rowBytes() == 2 );
+
+    std::vector<unsigned char> row(encoder.rowBytes());
+    for (unsigned y = 0; y < height; y++) {
+      row[0] = (y % 2) ? 0xaa : 0x55;
+      row[1] = 0xf8;
+      REQUIRE( encoder.writeRows(row.data(), 1) );
+    }
+    REQUIRE( encoder.finish() );
+  }
+
+  PNG decoded;
+  REQUIRE( decoded.readFromFile("palette-actual.png") );
+  REQUIRE( decoded.width() == width );
+  REQUIRE( decoded.height() == height );
+  REQUIRE( decoded.getPixel(1, 0) == decoded.getPixel(0, 1) );
+  REQUIRE( decoded.getPixel(0, 0) != decoded.getPixel(1, 0) );
+}
+
+TEST_CASE("Checksums match their reference values", "[png]") {
+  const std::string check = "123456789";
+  const unsigned char * digits = reinterpret_cast<const unsigned char *>(check.data());
+  REQUIRE( lodepng_crc32(digits, check.size()) == 0xcbf43926u );
+  REQUIRE( lodepng_adler32(digits, check.size()) == 0x091e01deu );
+
+  // long enough to run the wide kernels and their scalar tails
+  std::vector<unsigned char> data(70001);
+  for (size_t i = 0; i < data.size(); i++) { data[i] = (unsigned char)(i * 7 + i / 251); }
+  unsigned crc = 0xffffffffu, s1 = 1, s2 = 0;
+  for (unsigned char c : data) {
+    crc ^= c;
+    for (int k = 0; k < 8; k++) { crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1u))); }
+    s1 = (s1 + c) % 65521;
+    s2 = (s2 + s1) % 65521;
+  }
+  REQUIRE( lodepng_crc32(data.data(), data.size()) == (crc ^ 0xffffffffu) );
+  REQUIRE( lodepng_adler32(data.data(), data.size()) == ((s2 << 16) | s1) );
+}
+
+TEST_CASE("Row decoder fills a strided buffer like the whole-image decoder", "[png]") {
+  std::vector<unsigned char> file, expected;
+  unsigned width, height;
+  REQUIRE( lodepng::load_file(file, "../data/source.png") == 0 );
+  REQUIRE( lodepng::decode(expected, width, height, file) == 0 );
+
+  const size_t stride = width * 4 + 5;
+  std::vector<unsigned char> strided(stride * height, 0xcd);
+  lodepng::State state;
+  REQUIRE( lodepng_decode_into(strided.data(), stride, width, height, &state, file.data(), file.size()) == 0 );
+  for (unsigned y = 0; y < height; y++) {
+    REQUIRE( std::equal(expected.begin() + (size_t)y * width * 4, expected.begin() + (size_t)(y + 1) * width * 4,
+                        strided.begin() + (size_t)y * stride) );
+    REQUIRE( strided[y * stride + width * 4] == 0xcd );
+  }
+
+  lodepng::State wrongSize;
+  REQUIRE( lodepng_decode_into(strided.data(), stride, width + 1, height, &wrongSize, file.data(), file.size()) == 105 );
+}
+
+TEST_CASE("Probe reads dimensions from the header", "[png]") {
+  PNG source;
+  REQUIRE( source.readFromFile("../data/source.png") );
+
+  PNGInfo info;
+  REQUIRE( PNG::probe("../data/source.png", info) );
+  REQUIRE( info.width == source.width() );
+  REQUIRE( info.height == source.height() );
+  REQUIRE( info.bitDepth > 0 );
+  REQUIRE_FALSE( PNG::probe("../data/does-not-exist.png", info) );
+}
+
+TEST_CASE("Oversized and truncated headers fail without allocating", "[png]") {
+  std::vector<unsigned char> file;
+  REQUIRE( lodepng::load_file(file, "../data/source.png") == 0 );
+
+  // Declare 200000x200000 pixels in IHDR and fix up its CRC
+  std::vector<unsigned char> huge = file;
+  for (int i = 0; i < 2; i++) {
+    unsigned value = 200000;
+    for (int b = 0; b < 4; b++) { huge[16 + 4 * i + b] = (unsigned char)(value >> (24 - 8 * b)); }
+  }
+  unsigned crc = lodepng_crc32(&huge[12], 17);
+  for (int b = 0; b < 4; b++) { huge[29 + b] = (unsigned char)(crc >> (24 - 8 * b)); }
+  REQUIRE( lodepng::save_file(huge, "oversized-actual.png") == 0 );
+
+  PNG image;
+  REQUIRE( image.readFromFile("../data/source.png") );
+  PNG original = image;
+  REQUIRE_FALSE( image.readFromFile("oversized-actual.png") );
+  REQUIRE_FALSE( image.readFromFile("oversized-actual.png", 4) );
+  REQUIRE( image == original );
+
+  // A header with the image data cut off
+  std::vector<unsigned char> truncated(file.begin(), file.begin() + 33);
+  REQUIRE( lodepng::save_file(truncated, "oversized-actual.png") == 0 );
+  REQUIRE_FALSE( image.readFromFile("oversized-actual.png") );
+  REQUIRE( image == original );
+}
+
+TEST_CASE("Reduced decode returns a box filtered thumbnail", "[png]") {
+  PNG source;
+  REQUIRE( source.readFromFile("../data/source.png") );
+
+  PNG full;
+  REQUIRE( full.readFromFile("../data/source.png", 1) );
+  REQUIRE( full == source );
+
+  PNG reduced;
+  REQUIRE( reduced.readFromFile("../data/source.png", 4) );
+  REQUIRE( reduced.width() == (source.width() + 3) / 4 );
+  REQUIRE( reduced.height() == (source.height() + 3) / 4 );
+
+  // Every thumbnail pixel is the rounded mean of its box, including the
+  // partial boxes on the right and bottom edges
+  std::vector<unsigned char> file, rgba;
+  unsigned width, height;
+  REQUIRE( lodepng::load_file(file, "../data/source.png") == 0 );
+  REQUIRE( lodepng::decode(rgba, width, height, file) == 0 );
+  for (unsigned scale : {3u, 4u}) {
+    unsigned char * thumb = nullptr;
+    unsigned rw, rh;
+    lodepng::State state;
+    REQUIRE( lodepng_decode_reduced32(&thumb, &rw, &rh, &state, file.data(), file.size(), scale) == 0 );
+    REQUIRE( rw == (width + scale - 1) / scale );
+    REQUIRE( rh == (height + scale - 1) / scale );
+    bool matches = true;
+    for (unsigned y = 0; y < rh; y++) {
+      for (unsigned x = 0; x < rw; x++) {
+        unsigned sums[4] = {0, 0, 0, 0}, count = 0;
+        for (unsigned fy = y * scale; fy < std::min(height, (y + 1) * scale); fy++) {
+          for (unsigned fx = x * scale; fx < std::min(width, (x + 1) * scale); fx++) {
+            for (int c = 0; c < 4; c++) { sums[c] += rgba[((size_t)fy * width + fx) * 4 + c]; }
+            count++;
+          }
+        }
+        for (int c = 0; c < 4; c++) {
+          matches = matches && thumb[((size_t)y * rw + x) * 4 + c] == (sums[c] + count / 2) / count;
+        }
+      }
+    }
+    free(thumb);
+    REQUIRE( matches );
+  }
+}
+
+TEST_CASE("Reduced decode of an Adam7 image samples the top left of each box", "[png]") {
+  std::vector<unsigned char> file, rgba, interlaced;
+  unsigned width, height;
+  REQUIRE( lodepng::load_file(file, "../data/source.png") == 0 );
+  REQUIRE( lodepng::decode(rgba, width, height, file) == 0 );
+
+  lodepng::State encoder;
+  encoder.info_png.interlace_method = 1;
+  REQUIRE( lodepng::encode(interlaced, rgba, width, height, encoder) == 0 );
+  REQUIRE( lodepng::save_file(interlaced, "interlaced-actual.png") == 0 );
+
+  PNGInfo info;
+  REQUIRE( PNG::probe("interlaced-actual.png", info) );
+  REQUIRE( info.interlaced );
+
+  // Scales 8, 4 and 2 stop after passes 1, 3 and 5; 3 needs all seven
+  for (unsigned scale : {8u, 4u, 2u, 3u}) {
+    unsigned char * thumb = nullptr;
+    unsigned rw, rh;
+    lodepng::State state;
+    REQUIRE( lodepng_decode_reduced32(&thumb, &rw, &rh, &state, interlaced.data(), interlaced.size(), scale) == 0 );
+    REQUIRE( rw == (width + scale - 1) / scale );
+    REQUIRE( rh == (height + scale - 1) / scale );
+    bool matches = true;
+    for (unsigned y = 0; y < rh; y++) {
+      for (unsigned x = 0; x < rw; x++) {
+        matches = matches && std::equal(thumb + ((size_t)y * rw + x) * 4, thumb + ((size_t)y * rw + x + 1) * 4,
+                                        rgba.begin() + ((size_t)y * scale * width + x * scale) * 4);
+      }
+    }
+    free(thumb);
+    REQUIRE( matches );
+  }
+
+  PNG reduced;
+  REQUIRE( reduced.readFromFile("interlaced-actual.png", 8) );
+  REQUIRE( reduced.width() == (width + 7) / 8 );
+  REQUIRE( reduced.height() == (height + 7) / 8 );
+}
+
+TEST_CASE("Raw pixel files round-trip and stay copy-on-write", "[png]") {
+  PNG source;
+  REQUIRE( source.readFromFile("../data/source.png") );
+  REQUIRE( source.writeRawFile("raw-actual.raw") );
+
+  PNG mapped;
+  REQUIRE( mapped.readRawFile("raw-actual.raw") );
+  REQUIRE( mapped == source );
+
+  // Writing to a mapped image must not change the file behind it.
+  mapped.getPixel(0, 0) = LUVAPixel(50, 10, 10);
+  PNG again;
+  REQUIRE( again.readRawFile("raw-actual.raw") );
+  REQUIRE( again.getPixel(0, 0) == source.getPixel(0, 0) );
+
+  PNG copy = mapped;
+  REQUIRE( copy == mapped );
+  REQUIRE_FALSE( again.readRawFile("../data/source.png") );
+}
+
+namespace {
+  // Turns the raw side cache on for one scope, even if a REQUIRE throws
+  struct RawCacheScope {
+    RawCacheScope() { PNG::useRawCache = true; }
+    ~RawCacheScope() { PNG::useRawCache = false; }
+  };
+
+  void copyFile(std::string const & from, std::string const & to) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary);
+    out << in.rdbuf();
+  }
+}
+
+TEST_CASE("Raw side cache is written once and then mapped", "[png]") {
+  copyFile("../data/source.png", "rawcache-source.png");
+  std::remove("rawcache-source.png.rawcache");
+
+  RawCacheScope scope;
+  PNG first;
+  REQUIRE( first.readFromFile("rawcache-source.png") );
+  REQUIRE( std::ifstream("rawcache-source.png.rawcache").good() );
+  PNG reference;
+  REQUIRE( reference.readFromFile("../data/source.png") );
+  REQUIRE( first == reference );
+
+  // Mark the first cached pixel; only a load that maps the cache sees it
+  LUVAPixel marked = first.getPixel(1, 0);
+  {
+    std::fstream cache("rawcache-source.png.rawcache", std::ios::binary | std::ios::in | std::ios::out);
+    cache.seekp(4096);
+    cache.write(reinterpret_cast<const char *>(&marked), sizeof(marked));
+  }
+  PNG second;
+  REQUIRE( second.readFromFile("rawcache-source.png") );
+  REQUIRE( second.getPixel(0, 0) == marked );
+  REQUIRE( second.getPixel(1, 0) == reference.getPixel(1, 0) );
+}
+
+TEST_CASE("Raw side cache is refreshed when its PNG is rewritten", "[png]") {
+  // Stored PNGs of one size are always the same length, so only the
+  // modification time tells the two versions apart
+  PNG before, after;
+  REQUIRE( before.readFromFile("../data/source.png", 64) );
+  after = before;
+  after.getPixel(0, 0) = before.getPixel(1, 1);
+  after.getPixel(1, 1) = before.getPixel(0, 0);
+  REQUIRE( after != before );
+  EncodeOptions stored;
+  stored.level = 0;
+  std::remove("rawcache-stored.png.rawcache");
+
+  RawCacheScope scope;
+  REQUIRE( before.writeToFile("rawcache-stored.png", stored) );
+  PNG loaded;
+  REQUIRE( loaded.readFromFile("rawcache-stored.png") );
+  REQUIRE( std::ifstream("rawcache-stored.png.rawcache").good() );
+
+  REQUIRE( after.writeToFile("rawcache-stored.png", stored) );
+  PNG reloaded;
+  REQUIRE( reloaded.readFromFile("rawcache-stored.png") );
+  REQUIRE( reloaded == after );
+  REQUIRE( reloaded != loaded );
+}
@@ -1,7 +1,7 @@
 # Assignment Information (these are the *only* things you need to change here between assignments)
 set(assignment_name "mp_puzzle") # Name of the assignment
 set(assignment_version 1.2024.05.0) # Version, where minor=semester_year, patch=semester_end_month, tweak=revision
-set(assignment_entrypoints "main") # Entrypoints to run the program
-set(assignment_clean_rm "") # Generated files that should be removed with "make clean"
+set(assignment_entrypoints "main" "korf") # Entrypoints to run the program
+set(assignment_clean_rm "patterns-actual.pdb") # Generated files that should be removed with "make clean"
 set(assignment_container "fa23") # Container we are targetting
 set(assignment_uid "UIUC_CS225_SP24_mp_puzzle") # Unique ID for the assignment
\ No newline at end of file
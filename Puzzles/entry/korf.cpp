@@ -0,0 +1,72 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "batch.h"
+#include "patterndb.h"
+#include "puzzle.h"
+
+// Solves a file of 15-puzzle instances with IDA*, one instance per line as
+// 16 tile numbers in row-major order with 0 for the empty space. As in
+// Korf's 100 random instances, the goal has the empty space first:
+// 0 1 2 ... 15. Lines that do not hold 16 numbers are skipped.
+//
+// The instances are solved together by solveBatch() on every core. Given
+// a second file name, the search also uses a 6-6-3 pattern database
+// mapped from that file, building and saving it first if the file cannot
+// be opened.
+int main(int argc, const char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <instances file> [pattern database file]" << std::endl;
+        return 1;
+    }
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "Unable to open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    const PuzzleState goal({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
+    PatternDatabase patterns;
+    if (argc > 2 && !patterns.open(argv[2])) {
+        std::cout << "Building " << argv[2] << std::endl;
+        patterns.build(goal, {{1, 2, 3, 5, 6, 7}, {9, 10, 11, 13, 14, 15}, {4, 8, 12}});
+        if (!patterns.save(argv[2])) return 1;
+    }
+    std::vector<std::pair<PuzzleState, PuzzleState>> instances;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::array<char, 16> tiles;
+        int tile, count = 0;
+        while (count < 16 && fields >> tile) {
+            tiles[count++] = static_cast<char>(tile);
+        }
+        if (count < 16) continue;
+        instances.emplace_back(PuzzleState(tiles), goal);
+    }
+
+    BatchOptions options;
+    options.solver = BatchOptions::Solver::IDASTAR;
+    options.patterns = argc > 2 ? &patterns : NULL;
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<BatchResult<4, 4>> results = solveBatch(instances, options);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    size_t totalNodes = 0, totalMoves = 0;
+    double totalSeconds = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BatchResult<4, 4> &result = results[i];
+        size_t moves = result.path.empty() ? 0 : result.path.size() - 1;
+        std::cout << "#" << i + 1 << ": " << (result.solvable ? std::to_string(moves) + " moves" : "unsolvable")
+                  << ", " << result.nodes << " nodes, " << result.seconds << " s" << std::endl;
+        totalNodes += result.nodes;
+        totalMoves += moves;
+        totalSeconds += result.seconds;
+    }
+    std::cout << results.size() << " instances, " << totalMoves << " moves, " << totalNodes << " nodes, "
+              << totalSeconds << " s (" << wall << " s wall)" << std::endl;
+    return 0;
+}
@@ -12,7 +12,7 @@
 #include <string>
 #include <sys/stat.h>
 
-static std::array<int, 4> offsets = {1, 4, -1, -4};
+static std::array<int, 4> offsets = {1, PuzzleState::COLS, -1, -PuzzleState::COLS};
 
 bool exists(std::string const &path) {
     // Try stat-ing it
@@ -302,6 +302,7 @@ PuzzleAnimation::createAnimationTags(std::vector<int> const &directions,
 }
 
 bool PuzzleAnimation::isValid(int pos, int dir) {
-    return (dir == 0 && pos % 4 != 3) || (dir == 1 && pos < 12) ||
-           (dir == 2 && pos % 4 != 0) || (dir == 3 && pos > 3);
+    const int cols = PuzzleState::COLS;
+    return (dir == 0 && pos % cols != cols - 1) || (dir == 1 && pos < PuzzleState::CELLS - cols) ||
+           (dir == 2 && pos % cols != 0) || (dir == 3 && pos >= cols);
 }
@@ -0,0 +1,124 @@
+/**
+ * @file batch.cpp
+ * A work-stealing pool that solves batches of puzzle instances.
+ */
+
+#include "batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace {
+    // One worker's instances. The owner takes from the back and thieves
+    // from the front, so they only meet on the last instance; a lock held
+    // for one index costs nothing next to solving an instance.
+    class WorkQueue {
+    public:
+        void push(size_t instance) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            instances_.push_back(instance);
+        }
+
+        bool pop(size_t &instance) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (instances_.empty()) return false;
+            instance = instances_.back();
+            instances_.pop_back();
+            return true;
+        }
+
+        bool steal(size_t &instance) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (instances_.empty()) return false;
+            instance = instances_.front();
+            instances_.pop_front();
+            return true;
+        }
+
+    private:
+        std::mutex mutex_;
+        std::deque<size_t> instances_;
+    };
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+template <int Rows, int Cols>
+std::vector<BatchResult<Rows, Cols>> solveBatch(const std::vector<std::pair<SlidingPuzzle<Rows, Cols>, SlidingPuzzle<Rows, Cols>>> &instances,
+                                                const BatchOptions &options) {
+    std::vector<BatchResult<Rows, Cols>> results(instances.size());
+    unsigned threads = options.threads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Reject unsolvable instances before they take a worker's time, and
+    // set the hard ones aside for the parallel search
+    std::vector<size_t> easy, hard;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        results[i].solvable = isSolvable(instances[i].first, instances[i].second);
+        if (!results[i].solvable) continue;
+        if (instances[i].first.manhattanDistance(instances[i].second) >= options.parallelFrom) {
+            hard.push_back(i);
+        } else {
+            easy.push_back(i);
+        }
+    }
+
+    // Deal each thread a contiguous run of the instances
+    std::vector<WorkQueue> queues(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        for (size_t i = easy.size() * t / threads; i < easy.size() * (t + 1) / threads; ++i) {
+            queues[t].push(easy[i]);
+        }
+    }
+
+    // No work is added once the pool starts, so a worker that finds every
+    // queue empty is done
+    auto worker = [&](unsigned self) {
+        size_t i;
+        while (true) {
+            bool found = queues[self].pop(i);
+            for (unsigned k = 1; !found && k < threads; ++k) {
+                found = queues[(self + k) % threads].steal(i);
+            }
+            if (!found) return;
+
+            BatchResult<Rows, Cols> &result = results[i];
+            auto begin = std::chrono::steady_clock::now();
+            if (options.solver == BatchOptions::Solver::IDASTAR) {
+                result.path = solveIDAstar(instances[i].first, instances[i].second, &result.nodes, options.patterns);
+            } else {
+                result.path = solveAstar(instances[i].first, instances[i].second, &result.nodes, options.patterns);
+            }
+            result.seconds = secondsSince(begin);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+
+    for (size_t i : hard) {
+        BatchResult<Rows, Cols> &result = results[i];
+        auto begin = std::chrono::steady_clock::now();
+        result.path = solveIDAstarParallel(instances[i].first, instances[i].second, threads, &result.nodes, options.patterns);
+        result.seconds = secondsSince(begin);
+    }
+    return results;
+}
+
+template std::vector<BatchResult<2, 4>> solveBatch(const std::vector<std::pair<SlidingPuzzle<2, 4>, SlidingPuzzle<2, 4>>> &, const BatchOptions &);
+template std::vector<BatchResult<3, 3>> solveBatch(const std::vector<std::pair<SlidingPuzzle<3, 3>, SlidingPuzzle<3, 3>>> &, const BatchOptions &);
+template std::vector<BatchResult<4, 4>> solveBatch(const std::vector<std::pair<SlidingPuzzle<4, 4>, SlidingPuzzle<4, 4>>> &, const BatchOptions &);
+template std::vector<BatchResult<5, 5>> solveBatch(const std::vector<std::pair<SlidingPuzzle<5, 5>, SlidingPuzzle<5, 5>>> &, const BatchOptions &);
+template std::vector<BatchResult<6, 6>> solveBatch(const std::vector<std::pair<SlidingPuzzle<6, 6>, SlidingPuzzle<6, 6>>> &, const BatchOptions &);
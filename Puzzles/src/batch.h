@@ -0,0 +1,66 @@
+/**
+ * @file batch.h
+ * Solving many puzzle instances at once on a pool of threads.
+ */
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "puzzle.h"
+
+/**
+* How solveBatch() solves its instances.
+*/
+struct BatchOptions {
+    enum class Solver {
+        ASTAR,  // solveAstar(), fastest on easy instances
+        IDASTAR // solveIDAstar(), in little memory however hard the instance
+    };
+
+    Solver solver = Solver::ASTAR;
+
+    // Number of worker threads; 0 uses std::thread::hardware_concurrency()
+    unsigned threads = 0;
+
+    // Instances whose manhattan distance is at least this are solved after
+    // the others, one at a time, by solveIDAstarParallel() on every thread
+    int parallelFrom = INT_MAX;
+
+    // Passed to the solvers; used for 4x4 boards only
+    const PatternDatabase *patterns = NULL;
+};
+
+/**
+* The outcome of one instance of a batch.
+*/
+template <int Rows, int Cols>
+struct BatchResult {
+    std::vector<SlidingPuzzle<Rows, Cols>> path; // Empty if unsolvable
+    bool solvable = false;
+    size_t nodes = 0;    // States expanded, as counted by the solver
+    double seconds = 0;  // Wall time spent on this instance
+};
+
+/**
+* Solves a batch of instances, each a start state and the state to reach
+* from it.
+*
+* Instances that cannot be solved are told apart up front by the parity
+* check of isSolvable() and never reach a solver. The rest are dealt out
+* evenly to one queue per thread. A thread takes instances from the back
+* of its own queue and, once that is empty, steals from the front of the
+* others', so threads that draw easy instances help with the rest.
+*
+* Every worker runs its own solver, so A* on hard 15-puzzles needs memory
+* for that many searches at once; use IDASTAR or parallelFrom for those.
+*
+* @param instances Pairs of start and desired states
+* @param options The solver, threads and heuristic to use
+* @return One result per instance, in the same order
+*/
+template <int Rows, int Cols>
+std::vector<BatchResult<Rows, Cols>> solveBatch(const std::vector<std::pair<SlidingPuzzle<Rows, Cols>, SlidingPuzzle<Rows, Cols>>> &instances,
+                                                const BatchOptions &options = BatchOptions());
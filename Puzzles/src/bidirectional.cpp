@@ -0,0 +1,215 @@
+/**
+ * @file bidirectional.cpp
+ * Breadth-first and A* searches that grow from both the start and the
+ * goal and meet in the middle.
+ */
+
+#include "puzzle.h"
+#include "heuristic.h"
+#include "statetable.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+    // What one direction knows about each state it reached: the fewest
+    // moves found to it from that direction's root, and the state the last
+    // move came from
+    template <typename State>
+    using VisitTable = StateTable<typename State::Packed>;
+
+    // Records that a state was reached with g moves from parent
+    template <typename State>
+    void visit(VisitTable<State> &visited, const State &state, const State &parent, int g) {
+        typename VisitTable<State>::Record &record = visited.insert(state.asWords());
+        record.parent = parent.asWords();
+        record.g = g;
+    }
+
+    // The fewest moves to a state from one direction's root, or INT_MAX
+    template <typename State>
+    int movesTo(const VisitTable<State> &visited, const State &state) {
+        const typename VisitTable<State>::Record *record = visited.find(state.asWords());
+        return record ? record->g : INT_MAX;
+    }
+
+    // Follows the parents from a state back to the root of its direction.
+    // A state's g is always more than its parent's, so this ends at g = 0.
+    template <typename State>
+    std::vector<State> chain(const VisitTable<State> &visited, const State &state) {
+        std::vector<State> states = {state};
+        for (const typename VisitTable<State>::Record *record = visited.find(state.asWords()); record->g > 0;
+             record = visited.find(record->parent)) {
+            states.push_back(State::fromWords(record->parent));
+        }
+        return states;
+    }
+
+    // The forward path to the meeting state, then the backward path from it
+    template <typename State>
+    std::vector<State> join(const VisitTable<State> &forward, const VisitTable<State> &backward, const State &meet) {
+        std::vector<State> path = chain(forward, meet);
+        std::reverse(path.begin(), path.end());
+        std::vector<State> rest = chain(backward, meet);
+        path.insert(path.end(), rest.begin() + 1, rest.end());
+        return path;
+    }
+
+    template <typename State>
+    struct OpenEntry {
+        int priority;
+        int g;
+        int h;
+        State state;
+    };
+
+    struct LaterEntry {
+        template <typename Entry>
+        bool operator()(const Entry &a, const Entry &b) const {
+            return a.priority > b.priority;
+        }
+    };
+}
+
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveBidirectionalBFS(const SlidingPuzzle<Rows, Cols> &startState,
+                                                             const SlidingPuzzle<Rows, Cols> &desiredState, size_t *iterations) {
+    typedef SlidingPuzzle<Rows, Cols> State;
+    if (startState == desiredState) {
+        if (iterations) *iterations = 1;
+        return {startState};
+    }
+    if (!isSolvable(startState, desiredState)) {
+        if (iterations) *iterations = 0;
+        return {};
+    }
+
+    VisitTable<State> visited[2];
+    std::vector<State> frontier[2] = {{startState}, {desiredState}};
+    visit(visited[0], startState, startState, 0);
+    visit(visited[1], desiredState, desiredState, 0);
+
+    // Expand one whole level at a time, from the side with the smaller
+    // frontier. Before the level, no path was as short as the two depths
+    // put together; any that is comes out of this level, so the shortest
+    // meeting in it is optimal.
+    size_t steps = 0;
+    int best = INT_MAX;
+    State meet;
+    while (best == INT_MAX && !frontier[0].empty() && !frontier[1].empty()) {
+        int side = frontier[0].size() <= frontier[1].size() ? 0 : 1;
+        VisitTable<State> &mine = visited[side];
+        const VisitTable<State> &theirs = visited[1 - side];
+        std::vector<State> next;
+        for (const State &state : frontier[side]) {
+            ++steps;
+            int g = movesTo(mine, state) + 1;
+            std::array<State, 4> neighbors;
+            size_t count = state.getNeighbors(neighbors);
+            for (size_t i = 0; i < count; ++i) {
+                if (movesTo(mine, neighbors[i]) != INT_MAX) continue;
+                visit(mine, neighbors[i], state, g);
+                next.push_back(neighbors[i]);
+                int other = movesTo(theirs, neighbors[i]);
+                if (other != INT_MAX && g + other < best) {
+                    best = g + other;
+                    meet = neighbors[i];
+                }
+            }
+        }
+        frontier[side].swap(next);
+    }
+
+    if (iterations) *iterations = steps;
+    if (best == INT_MAX) return {};
+    return join(visited[0], visited[1], meet);
+}
+
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveBidirectionalAstar(const SlidingPuzzle<Rows, Cols> &startState,
+                                                               const SlidingPuzzle<Rows, Cols> &desiredState, size_t *iterations) {
+    typedef SlidingPuzzle<Rows, Cols> State;
+    if (startState == desiredState) {
+        if (iterations) *iterations = 1;
+        return {startState};
+    }
+    if (!isSolvable(startState, desiredState)) {
+        if (iterations) *iterations = 0;
+        return {};
+    }
+
+    // Each side estimates the distance to the other side's root, with the
+    // manhattan distance plus linear conflicts updated per move, and orders
+    // its states by max(f, 2g), so neither side searches past the middle
+    // of a path before the other has reached it
+    const State roots[2] = {startState, desiredState};
+    const MoveEstimator<Rows, Cols> estimators[2] = {{desiredState, true}, {startState, true}};
+    VisitTable<State> visited[2];
+    std::priority_queue<OpenEntry<State>, std::vector<OpenEntry<State>>, LaterEntry> open[2];
+    for (int side = 0; side < 2; ++side) {
+        visit(visited[side], roots[side], roots[side], 0);
+        int h = estimators[side].estimate(roots[side]);
+        open[side].push({h, 0, h, roots[side]});
+    }
+
+    size_t steps = 0;
+    int best = INT_MAX;
+    State meet;
+    while (true) {
+        // Drop entries for states since reached with fewer moves
+        for (int side = 0; side < 2; ++side) {
+            while (!open[side].empty() && open[side].top().g > movesTo(visited[side], open[side].top().state)) {
+                open[side].pop();
+            }
+        }
+        if (open[0].empty() || open[1].empty()) break;
+
+        // Every path not found yet has a state open on one side with a
+        // priority no more than its length, so once the best meeting is no
+        // longer than the smallest priority it is optimal (the MM rule)
+        int side = open[0].top().priority <= open[1].top().priority ? 0 : 1;
+        if (best <= open[side].top().priority) break;
+
+        OpenEntry<State> current = open[side].top();
+        open[side].pop();
+        ++steps;
+
+        VisitTable<State> &mine = visited[side];
+        const VisitTable<State> &theirs = visited[1 - side];
+        int g = current.g + 1;
+        std::array<State, 4> neighbors;
+        std::array<int, 4> deltas;
+        size_t count = estimators[side].neighbors(current.state, neighbors, deltas);
+        for (size_t i = 0; i < count; ++i) {
+            const State &neighbor = neighbors[i];
+            if (movesTo(mine, neighbor) <= g) continue;
+
+            // States can be reached again with fewer moves, and are then
+            // reopened
+            visit(mine, neighbor, current.state, g);
+            int h = current.h + deltas[i];
+            open[side].push({std::max(g + h, 2 * g), g, h, neighbor});
+            int other = movesTo(theirs, neighbor);
+            if (other != INT_MAX && g + other < best) {
+                best = g + other;
+                meet = neighbor;
+            }
+        }
+    }
+
+    if (iterations) *iterations = steps;
+    if (best == INT_MAX) return {};
+    return join(visited[0], visited[1], meet);
+}
+
+template std::vector<SlidingPuzzle<2, 4>> solveBidirectionalBFS(const SlidingPuzzle<2, 4> &, const SlidingPuzzle<2, 4> &, size_t *);
+template std::vector<SlidingPuzzle<3, 3>> solveBidirectionalBFS(const SlidingPuzzle<3, 3> &, const SlidingPuzzle<3, 3> &, size_t *);
+template std::vector<SlidingPuzzle<4, 4>> solveBidirectionalBFS(const SlidingPuzzle<4, 4> &, const SlidingPuzzle<4, 4> &, size_t *);
+template std::vector<SlidingPuzzle<5, 5>> solveBidirectionalBFS(const SlidingPuzzle<5, 5> &, const SlidingPuzzle<5, 5> &, size_t *);
+template std::vector<SlidingPuzzle<6, 6>> solveBidirectionalBFS(const SlidingPuzzle<6, 6> &, const SlidingPuzzle<6, 6> &, size_t *);
+
+template std::vector<SlidingPuzzle<2, 4>> solveBidirectionalAstar(const SlidingPuzzle<2, 4> &, const SlidingPuzzle<2, 4> &, size_t *);
+template std::vector<SlidingPuzzle<3, 3>> solveBidirectionalAstar(const SlidingPuzzle<3, 3> &, const SlidingPuzzle<3, 3> &, size_t *);
+template std::vector<SlidingPuzzle<4, 4>> solveBidirectionalAstar(const SlidingPuzzle<4, 4> &, const SlidingPuzzle<4, 4> &, size_t *);
+template std::vector<SlidingPuzzle<5, 5>> solveBidirectionalAstar(const SlidingPuzzle<5, 5> &, const SlidingPuzzle<5, 5> &, size_t *);
+template std::vector<SlidingPuzzle<6, 6>> solveBidirectionalAstar(const SlidingPuzzle<6, 6> &, const SlidingPuzzle<6, 6> &, size_t *);
@@ -0,0 +1,196 @@
+/**
+ * @file heuristic.h
+ * Manhattan distance and linear conflict estimates that are built once per
+ * search and updated per move.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "puzzle.h"
+
+/**
+* Linear conflict penalty of one row or column of Length cells. The key
+* holds, for each cell in base Length + 1 (first cell least significant),
+* the goal coordinate along the line of the tile there, or Length if the
+* cell is empty or its tile belongs to another line. Tiles of the line
+* that are out of order must leave it and come back: two moves for each
+* tile outside the longest increasing run.
+*/
+template <int Length>
+struct ConflictTable {
+    static constexpr int BASE = Length + 1;
+    static constexpr int KEYS = BASE * BASE * (Length > 2 ? BASE : 1) * (Length > 3 ? BASE : 1)
+                                * (Length > 4 ? BASE : 1) * (Length > 5 ? BASE : 1);
+    static_assert(Length >= 2 && Length <= 6, "Lines are 2 to 6 cells long");
+    std::array<unsigned char, KEYS> penalty;
+
+    ConflictTable() {
+        for (int key = 0; key < KEYS; ++key) {
+            int goals[Length], count = 0;
+            for (int k = key, cell = 0; cell < Length; ++cell, k /= BASE) {
+                if (k % BASE != Length) goals[count++] = k % BASE;
+            }
+            int longest = 0, run[Length];
+            for (int i = 0; i < count; ++i) {
+                run[i] = 1;
+                for (int j = 0; j < i; ++j) {
+                    if (goals[j] < goals[i]) run[i] = std::max(run[i], run[j] + 1);
+                }
+                longest = std::max(longest, run[i]);
+            }
+            penalty[key] = static_cast<unsigned char>(2 * (count - longest));
+        }
+    }
+};
+
+/**
+* @return the table for lines of Length cells, built on first use
+*/
+template <int Length>
+const ConflictTable<Length> &conflictTable() {
+    static const ConflictTable<Length> table;
+    return table;
+}
+
+/**
+* Estimates the distance to one goal: the manhattan distance, optionally
+* plus linear conflicts. The goal's tables are built once, and neighbors
+* are generated together with the change of the estimate, which depends
+* only on the moved tile and the two or three lines it touches.
+*
+* The per-tile and per-line parts are public so that searches keeping
+* their own board, such as IDA*, can update the estimate themselves. They
+* take any Board with tileAt(cell), as State has.
+*/
+template <int Rows, int Cols>
+class MoveEstimator {
+public:
+    typedef SlidingPuzzle<Rows, Cols> State;
+    static constexpr int CELLS = Rows * Cols;
+
+    /**
+    * @param goal The state to estimate the distance to
+    * @param conflicts Whether to add linear conflicts to the manhattan
+    * distance
+    */
+    MoveEstimator(const State &goal, bool conflicts)
+        : conflicts_(conflicts), rowConflicts_(conflictTable<Cols>()), colConflicts_(conflictTable<Rows>()) {
+        std::array<char, CELLS> tiles = goal.asArray();
+        for (int i = 0; i < CELLS; ++i) {
+            goalRow_[static_cast<int>(tiles[i])] = static_cast<uint8_t>(i / Cols);
+            goalCol_[static_cast<int>(tiles[i])] = static_cast<uint8_t>(i % Cols);
+        }
+        for (int cell = 0; cell < CELLS; ++cell) {
+            distance_[0][cell] = 0; // The empty space is not counted
+        }
+        for (int tile = 1; tile < CELLS; ++tile) {
+            for (int cell = 0; cell < CELLS; ++cell) {
+                distance_[tile][cell] = State::DISTANCE[cell][goalRow_[tile] * Cols + goalCol_[tile]];
+            }
+        }
+    }
+
+    /**
+    * @return the estimate for a state, computed from scratch
+    */
+    int estimate(const State &state) const {
+        int total = 0;
+        for (int cell = 0; cell < CELLS; ++cell) {
+            total += distance_[state.tileAt(cell)][cell];
+        }
+        return conflicts_ ? total + conflicts(state) : total;
+    }
+
+    /**
+    * Gets the neighbors of a state, as getNeighbors() does, and how much
+    * each move changes the estimate.
+    * @param neighbors Receives the neighbors in the order UP, DOWN, LEFT,
+    * RIGHT, skipping moves that would leave the board
+    * @param deltas Receives the estimate of each neighbor minus the
+    * estimate of the state
+    * @return The number of neighbors written
+    */
+    size_t neighbors(const State &state, std::array<State, 4> &neighbors, std::array<int, 4> &deltas) const {
+        int blank = state.emptyCell();
+        size_t count = 0;
+        for (int d = 0; d < 4; ++d) {
+            int from = State::MOVES[blank][d];
+            if (from < 0) continue;
+            neighbors[count] = state.getNeighbor(static_cast<typename State::Direction>(d));
+            int tile = state.tileAt(from);
+            int delta = distance_[tile][blank] - distance_[tile][from];
+            if (conflicts_) delta += touchedConflicts(neighbors[count], from, blank) - touchedConflicts(state, from, blank);
+            deltas[count++] = delta;
+        }
+        return count;
+    }
+
+    /**
+    * @return the manhattan distance of a tile in a cell from its goal cell,
+    * 0 for the empty space
+    */
+    int distance(int tile, int cell) const {
+        return distance_[tile][cell];
+    }
+
+    /**
+    * @return the linear conflicts of every row and column of a board,
+    * whether or not the estimate adds them
+    */
+    template <typename Board>
+    int conflicts(const Board &board) const {
+        int total = 0;
+        for (int row = 0; row < Rows; ++row) {
+            total += rowConflict(board, row);
+        }
+        for (int col = 0; col < Cols; ++col) {
+            total += colConflict(board, col);
+        }
+        return total;
+    }
+
+    /**
+    * @return the linear conflicts of the lines that moving a tile between
+    * two cells touches: a vertical move changes two rows and one column, a
+    * horizontal move two columns and one row
+    */
+    template <typename Board>
+    int touchedConflicts(const Board &board, int from, int to) const {
+        if (from % Cols == to % Cols) {
+            return rowConflict(board, from / Cols) + rowConflict(board, to / Cols) + colConflict(board, from % Cols);
+        }
+        return colConflict(board, from % Cols) + colConflict(board, to % Cols) + rowConflict(board, from / Cols);
+    }
+
+private:
+    bool conflicts_;
+    const ConflictTable<Cols> &rowConflicts_;
+    const ConflictTable<Rows> &colConflicts_;
+    std::array<uint8_t, CELLS> goalRow_;
+    std::array<uint8_t, CELLS> goalCol_;
+    std::array<std::array<uint8_t, CELLS>, CELLS> distance_; // By tile, then cell
+
+    template <typename Board>
+    int rowConflict(const Board &board, int row) const {
+        int key = 0;
+        for (int col = Cols - 1; col >= 0; --col) {
+            int tile = board.tileAt(row * Cols + col);
+            key = key * (Cols + 1) + (tile != 0 && goalRow_[tile] == row ? goalCol_[tile] : Cols);
+        }
+        return rowConflicts_.penalty[key];
+    }
+
+    template <typename Board>
+    int colConflict(const Board &board, int col) const {
+        int key = 0;
+        for (int row = Rows - 1; row >= 0; --row) {
+            int tile = board.tileAt(row * Cols + col);
+            key = key * (Rows + 1) + (tile != 0 && goalCol_[tile] == col ? goalRow_[tile] : Rows);
+        }
+        return colConflicts_.penalty[key];
+    }
+};
@@ -0,0 +1,329 @@
+/**
+ * @file idastar.cpp
+ * Iterative-deepening A* for sliding puzzles, guided by the Manhattan
+ * distance plus linear conflicts or a pattern database, updated
+ * incrementally per move.
+ */
+
+#include "puzzle.h"
+#include "heuristic.h"
+#include "patterndb.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <thread>
+
+namespace {
+    const int FOUND = -1;
+
+    template <int Rows, int Cols>
+    class IDAstarSearch {
+    public:
+        static constexpr int CELLS = Rows * Cols;
+
+        // The estimator must be built for the goal with conflicts, and
+        // outlive the search
+        IDAstarSearch(const std::array<char, CELLS> &start, const MoveEstimator<Rows, Cols> &estimator, const PatternDatabase *patterns)
+            : nodes(0), estimator_(estimator), patterns_(patterns), stop_(NULL) {
+            for (int i = 0; i < CELLS; ++i) {
+                board_.tiles[i] = start[i];
+                where_[static_cast<int>(start[i])] = i;
+                if (start[i] == 0) blank_ = i;
+            }
+            manhattan_ = 0;
+            for (int pos = 0; pos < CELLS; ++pos) {
+                manhattan_ += estimator_.distance(board_.tiles[pos], pos);
+            }
+            conflicts_ = estimator_.conflicts(board_);
+            excess_.fill(0);
+            totalExcess_ = 0;
+            if constexpr (Rows == 4 && Cols == 4) {
+                for (int p = 0; patterns_ && p < patterns_->patternCount(); ++p) {
+                    excess_[p] = patterns_->excess(p, where_);
+                    totalExcess_ += excess_[p];
+                }
+            }
+        }
+
+        // Runs deeper and deeper bounded searches; returns the blank
+        // positions after each move of an optimal solution
+        std::vector<int> solve() {
+            int bound = h();
+            while (true) {
+                int next = search(0, bound, -1);
+                if (next == FOUND) return moves_;
+                if (next == INT_MAX) return {};
+                bound = next;
+            }
+        }
+
+        // One bounded search from a board g moves into the solution, whose
+        // blank was at previous before the last move. Returns FOUND, with
+        // the moves from this board in moves(), or the smallest f over the
+        // bound.
+        int bounded(int g, int bound, int previous) {
+            return search(g, bound, previous);
+        }
+
+        const std::vector<int> &moves() const {
+            return moves_;
+        }
+
+        // Gives up, as if nothing were found, once stop is set
+        void stopOn(const std::atomic<bool> *stop) {
+            stop_ = stop;
+        }
+
+        int estimate() const {
+            return h();
+        }
+
+        size_t nodes;
+
+    private:
+        // The tiles by cell, read by the estimator like a State
+        struct Board {
+            std::array<int, CELLS> tiles;
+            int tileAt(int cell) const { return tiles[cell]; }
+        };
+
+        const MoveEstimator<Rows, Cols> &estimator_;
+        const PatternDatabase *patterns_;
+        const std::atomic<bool> *stop_;
+        Board board_;
+        std::array<int, CELLS> where_;
+        int blank_;
+        int manhattan_;
+        int conflicts_;
+        std::array<int, PatternDatabase::MAX_PATTERNS> excess_;
+        int totalExcess_;
+        std::vector<int> moves_;
+
+        // Both the conflicts and the pattern database add to the manhattan
+        // distance, but not to each other
+        int h() const {
+            return manhattan_ + std::max(conflicts_, 2 * totalExcess_);
+        }
+
+        int search(int g, int bound, int previous) {
+            ++nodes;
+            int f = g + h();
+            if (f > bound) return f;
+            if (manhattan_ == 0) return FOUND;
+            if (stop_ && stop_->load(std::memory_order_relaxed)) return INT_MAX;
+
+            // Tiles slide up, down, left and right into the blank
+            int least = INT_MAX;
+            for (int pos : SlidingPuzzle<Rows, Cols>::MOVES[blank_]) {
+                if (pos < 0 || pos == previous) continue; // Never undo the last move
+
+                int tile = board_.tiles[pos], blank = blank_;
+                int before = estimator_.touchedConflicts(board_, pos, blank);
+                board_.tiles[blank] = tile;
+                board_.tiles[pos] = 0;
+                where_[tile] = blank;
+                where_[0] = pos;
+                blank_ = pos;
+                int dm = estimator_.distance(tile, blank) - estimator_.distance(tile, pos);
+                int dc = estimator_.touchedConflicts(board_, pos, blank) - before;
+                manhattan_ += dm;
+                conflicts_ += dc;
+                int pattern = -1, excess = 0;
+                if constexpr (Rows == 4 && Cols == 4) {
+                    pattern = patterns_ ? patterns_->patternOf(tile) : -1;
+                    if (pattern >= 0) {
+                        excess = excess_[pattern];
+                        excess_[pattern] = patterns_->excess(pattern, where_);
+                        totalExcess_ += excess_[pattern] - excess;
+                    }
+                }
+                moves_.push_back(pos);
+
+                int t = search(g + 1, bound, blank);
+                if (t == FOUND) return FOUND;
+
+                moves_.pop_back();
+                if (pattern >= 0) {
+                    totalExcess_ -= excess_[pattern] - excess;
+                    excess_[pattern] = excess;
+                }
+                conflicts_ -= dc;
+                manhattan_ -= dm;
+                blank_ = blank;
+                where_[0] = blank;
+                where_[tile] = pos;
+                board_.tiles[pos] = tile;
+                board_.tiles[blank] = 0;
+                least = std::min(least, t);
+            }
+            return least;
+        }
+    };
+}
+
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveIDAstar(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState,
+                                                    size_t *iterations, const PatternDatabase *patterns) {
+    if (startState == desiredState) {
+        if (iterations) *iterations = 1;
+        return {startState};
+    }
+    if (!isSolvable(startState, desiredState)) {
+        if (iterations) *iterations = 0;
+        return {};
+    }
+    std::array<char, Rows * Cols> start = startState.asArray();
+
+    // Pattern databases are built for the 15-puzzle only
+    if constexpr (Rows == 4 && Cols == 4) {
+        if (patterns && (!patterns->ready() || patterns->goal() != desiredState)) patterns = NULL;
+    } else {
+        patterns = NULL;
+    }
+    MoveEstimator<Rows, Cols> estimator(desiredState, true);
+    IDAstarSearch<Rows, Cols> search(start, estimator, patterns);
+    std::vector<int> moves = search.solve();
+    if (iterations) *iterations = search.nodes;
+
+    std::vector<SlidingPuzzle<Rows, Cols>> path = {startState};
+    int blank = static_cast<int>(std::find(start.begin(), start.end(), 0) - start.begin());
+    for (int pos : moves) {
+        std::swap(start[blank], start[pos]);
+        blank = pos;
+        path.push_back(SlidingPuzzle<Rows, Cols>(start));
+    }
+    return path;
+}
+
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveIDAstarParallel(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState,
+                                                            unsigned threads, size_t *iterations, const PatternDatabase *patterns) {
+    typedef SlidingPuzzle<Rows, Cols> State;
+    typedef std::array<char, Rows * Cols> Tiles;
+    if (startState == desiredState) {
+        if (iterations) *iterations = 1;
+        return {startState};
+    }
+    if (!isSolvable(startState, desiredState)) {
+        if (iterations) *iterations = 0;
+        return {};
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    Tiles start = startState.asArray();
+    Tiles goal = desiredState.asArray();
+    if constexpr (Rows == 4 && Cols == 4) {
+        if (patterns && (!patterns->ready() || patterns->goal() != desiredState)) patterns = NULL;
+    } else {
+        patterns = NULL;
+    }
+
+    const int startBlank = static_cast<int>(std::find(start.begin(), start.end(), 0) - start.begin());
+    auto pathOf = [&](const std::vector<int> &moves) {
+        std::vector<State> path = {startState};
+        Tiles tiles = start;
+        int blank = startBlank;
+        for (int pos : moves) {
+            std::swap(tiles[blank], tiles[pos]);
+            blank = pos;
+            path.push_back(State(tiles));
+        }
+        return path;
+    };
+
+    // The roots of the subtrees: every sequence of the first few moves that
+    // never undoes the last one. Whole levels are checked for the goal, so
+    // one found here is optimal.
+    struct Subtree {
+        Tiles tiles;
+        std::vector<int> moves; // Blank positions after each move
+        int previous;           // Blank position before the last move
+    };
+    std::vector<Subtree> roots = {Subtree{start, {}, -1}};
+    size_t steps = 0;
+    int depth = 0;
+    while (roots.size() < 32 * threads) {
+        std::vector<Subtree> next;
+        for (const Subtree &root : roots) {
+            ++steps;
+            int blank = root.moves.empty() ? startBlank : root.moves.back();
+            for (int pos : State::MOVES[blank]) {
+                if (pos < 0 || pos == root.previous) continue;
+                Subtree child = {root.tiles, root.moves, blank};
+                std::swap(child.tiles[blank], child.tiles[pos]);
+                child.moves.push_back(pos);
+                if (child.tiles == goal) {
+                    if (iterations) *iterations = steps;
+                    return pathOf(child.moves);
+                }
+                next.push_back(child);
+            }
+        }
+        roots.swap(next);
+        ++depth;
+    }
+
+    MoveEstimator<Rows, Cols> estimator(desiredState, true);
+    int bound = IDAstarSearch<Rows, Cols>(start, estimator, patterns).estimate();
+    while (true) {
+        std::atomic<bool> found(false);
+        std::atomic<size_t> nextRoot(0), visited(0);
+        std::atomic<int> nextBound(INT_MAX);
+        std::vector<int> solution;
+
+        // Subtrees differ wildly in size, so threads take them one at a
+        // time rather than in fixed ranges
+        auto worker = [&]() {
+            for (size_t i = nextRoot++; i < roots.size() && !found.load(std::memory_order_relaxed); i = nextRoot++) {
+                IDAstarSearch<Rows, Cols> search(roots[i].tiles, estimator, patterns);
+                search.stopOn(&found);
+                int t = search.bounded(depth, bound, roots[i].previous);
+                visited += search.nodes;
+                if (t == FOUND) {
+                    if (!found.exchange(true)) {
+                        solution = roots[i].moves;
+                        solution.insert(solution.end(), search.moves().begin(), search.moves().end());
+                    }
+                    break;
+                }
+                int least = nextBound.load();
+                while (t < least && !nextBound.compare_exchange_weak(least, t)) {
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; ++t) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread &thread : pool) {
+            thread.join();
+        }
+
+        steps += visited;
+        if (found || nextBound == INT_MAX) {
+            if (iterations) *iterations = steps;
+            return found ? pathOf(solution) : std::vector<State>();
+        }
+        bound = nextBound;
+    }
+}
+
+template std::vector<SlidingPuzzle<2, 4>> solveIDAstar(const SlidingPuzzle<2, 4> &, const SlidingPuzzle<2, 4> &, size_t *, const PatternDatabase *);
+template std::vector<SlidingPuzzle<3, 3>> solveIDAstar(const SlidingPuzzle<3, 3> &, const SlidingPuzzle<3, 3> &, size_t *, const PatternDatabase *);
+template std::vector<SlidingPuzzle<4, 4>> solveIDAstar(const SlidingPuzzle<4, 4> &, const SlidingPuzzle<4, 4> &, size_t *, const PatternDatabase *);
+template std::vector<SlidingPuzzle<5, 5>> solveIDAstar(const SlidingPuzzle<5, 5> &, const SlidingPuzzle<5, 5> &, size_t *, const PatternDatabase *);
+template std::vector<SlidingPuzzle<6, 6>> solveIDAstar(const SlidingPuzzle<6, 6> &, const SlidingPuzzle<6, 6> &, size_t *, const PatternDatabase *);
+
+template std::vector<SlidingPuzzle<2, 4>> solveIDAstarParallel(const SlidingPuzzle<2, 4> &, const SlidingPuzzle<2, 4> &, unsigned, size_t *,
+                                                                 const PatternDatabase *);
+template std::vector<SlidingPuzzle<3, 3>> solveIDAstarParallel(const SlidingPuzzle<3, 3> &, const SlidingPuzzle<3, 3> &, unsigned, size_t *,
+                                                                 const PatternDatabase *);
+template std::vector<SlidingPuzzle<4, 4>> solveIDAstarParallel(const SlidingPuzzle<4, 4> &, const SlidingPuzzle<4, 4> &, unsigned, size_t *,
+                                                                 const PatternDatabase *);
+template std::vector<SlidingPuzzle<5, 5>> solveIDAstarParallel(const SlidingPuzzle<5, 5> &, const SlidingPuzzle<5, 5> &, unsigned, size_t *,
+                                                                 const PatternDatabase *);
+template std::vector<SlidingPuzzle<6, 6>> solveIDAstarParallel(const SlidingPuzzle<6, 6> &, const SlidingPuzzle<6, 6> &, unsigned, size_t *,
+                                                                 const PatternDatabase *);
@@ -0,0 +1,350 @@
+/**
+ * @file patterndb.cpp
+ * Building, saving and mapping additive pattern databases.
+ */
+
+#include "patterndb.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    const size_t HEADER_BYTES = 40;
+    const uint32_t VERSION = 1;
+    const int MAX_EXCESS = 15;
+
+    int distance(int a, int b) {
+        return std::abs(a / 4 - b / 4) + std::abs(a % 4 - b % 4);
+    }
+
+    // Number of ways to place count distinct tiles on the 16 cells
+    size_t placements(int count) {
+        size_t total = 1;
+        for (int i = 0; i < count; ++i) {
+            total *= 16 - i;
+        }
+        return total;
+    }
+
+    size_t tableBytes(int count) {
+        return (placements(count) + 1) / 2;
+    }
+
+    // Perfect rank of distinct positions in [0, placements(count)): each
+    // position is numbered among the cells still free, like the digits of
+    // a mixed-radix number
+    uint64_t rank(const int *positions, int count) {
+        uint64_t result = 0;
+        unsigned used = 0;
+        for (int i = 0; i < count; ++i) {
+            int free = positions[i] - __builtin_popcount(used & ((1u << positions[i]) - 1));
+            result = result * (16 - i) + free;
+            used |= 1u << positions[i];
+        }
+        return result;
+    }
+
+    bool testAndSet(std::vector<uint64_t> &bits, uint64_t i) {
+        uint64_t bit = 1ULL << (i % 64);
+        bool set = bits[i / 64] & bit;
+        bits[i / 64] |= bit;
+        return set;
+    }
+
+    template <typename T>
+    T readField(const unsigned char *bytes, size_t offset) {
+        T value;
+        std::memcpy(&value, bytes + offset, sizeof(T));
+        return value;
+    }
+
+    // Breadth-first search from the goal over placements of the group's
+    // tiles and the empty space. Sliding another tile into the empty space
+    // is free and stays on the current level; sliding one of the group's
+    // tiles costs a move and goes to the next level. Each placement of the
+    // group gets the level it is first reached on.
+    void buildTable(const std::vector<int> &tiles, const std::array<int, 16> &goalWhere, unsigned char *table) {
+        const int count = static_cast<int>(tiles.size());
+        std::vector<uint64_t> visited((placements(count + 1) + 63) / 64);
+        std::vector<uint64_t> assigned((placements(count) + 63) / 64);
+
+        // A state lists the positions of the tiles and then of the empty
+        // space, 4 bits each
+        uint64_t start = 0;
+        for (int i = 0; i < count; ++i) {
+            start |= static_cast<uint64_t>(goalWhere[tiles[i]]) << (4 * i);
+        }
+        start |= static_cast<uint64_t>(goalWhere[0]) << (4 * count);
+
+        std::vector<uint64_t> level, next(1, start);
+        for (int moves = 0; !next.empty(); ++moves) {
+            level.swap(next);
+            next.clear();
+            while (!level.empty()) {
+                uint64_t state = level.back();
+                level.pop_back();
+                int positions[PatternDatabase::MAX_PATTERN_TILES + 1];
+                for (int i = 0; i <= count; ++i) {
+                    positions[i] = (state >> (4 * i)) & 0xF;
+                }
+                uint64_t r = rank(positions, count + 1);
+                if (testAndSet(visited, r)) continue;
+
+                // The empty space is the last digit of the rank
+                uint64_t entry = r / (16 - count);
+                if (!testAndSet(assigned, entry)) {
+                    int manhattan = 0;
+                    for (int i = 0; i < count; ++i) {
+                        manhattan += distance(positions[i], goalWhere[tiles[i]]);
+                    }
+                    int excess = std::min((moves - manhattan) / 2, MAX_EXCESS);
+                    unsigned char &byte = table[entry / 2];
+                    byte = entry % 2 ? (byte & 0x0F) | (excess << 4) : (byte & 0xF0) | excess;
+                }
+
+                int occupant[16];
+                std::fill(occupant, occupant + 16, -1);
+                for (int i = 0; i < count; ++i) {
+                    occupant[positions[i]] = i;
+                }
+                int blank = positions[count];
+                int from[4], options = 0;
+                if (blank / 4 < 3) from[options++] = blank + 4;
+                if (blank / 4 > 0) from[options++] = blank - 4;
+                if (blank % 4 < 3) from[options++] = blank + 1;
+                if (blank % 4 > 0) from[options++] = blank - 1;
+                for (int m = 0; m < options; ++m) {
+                    int tile = occupant[from[m]];
+                    if (tile >= 0) positions[tile] = blank;
+                    positions[count] = from[m];
+                    uint64_t nextRank = rank(positions, count + 1);
+                    if (!(visited[nextRank / 64] >> (nextRank % 64) & 1)) {
+                        uint64_t moved = state & ~(0xFULL << (4 * count));
+                        moved |= static_cast<uint64_t>(from[m]) << (4 * count);
+                        if (tile >= 0) {
+                            moved = (moved & ~(0xFULL << (4 * tile))) | static_cast<uint64_t>(blank) << (4 * tile);
+                        }
+                        (tile >= 0 ? next : level).push_back(moved);
+                    }
+                    if (tile >= 0) positions[tile] = from[m];
+                }
+            }
+        }
+    }
+}
+
+PatternDatabase::PatternDatabase() : data_(NULL), size_(0), goal_(0), patterns_(0) {
+    close();
+}
+
+PatternDatabase::~PatternDatabase() {
+    close();
+}
+
+void PatternDatabase::close() {
+    if (data_ != NULL) {
+        munmap(data_, size_);
+    }
+    data_ = NULL;
+    size_ = 0;
+    built_.clear();
+    built_.shrink_to_fit();
+    goal_ = 0;
+    patterns_ = 0;
+    tables_.fill(NULL);
+    for (std::vector<int> &tiles : tiles_) {
+        tiles.clear();
+    }
+    patternOf_.fill(-1);
+    goalWhere_.fill(0);
+}
+
+bool PatternDatabase::setPartition(uint64_t goal, const std::vector<uint16_t> &masks) {
+    std::array<char, 16> goalTiles = PuzzleState::fromPacked(goal).asArray();
+    unsigned seen = 0;
+    for (int i = 0; i < 16; ++i) {
+        seen |= 1u << goalTiles[i];
+        goalWhere_[static_cast<int>(goalTiles[i])] = i;
+    }
+    if (seen != 0xFFFF || static_cast<int>(masks.size()) > MAX_PATTERNS) return false;
+
+    unsigned covered = 0;
+    for (size_t p = 0; p < masks.size(); ++p) {
+        int count = __builtin_popcount(masks[p]);
+        if ((masks[p] & 1) || (masks[p] & covered) || count == 0 || count > MAX_PATTERN_TILES) return false;
+        covered |= masks[p];
+        for (int tile = 1; tile < 16; ++tile) {
+            if (masks[p] >> tile & 1) {
+                tiles_[p].push_back(tile);
+                patternOf_[tile] = static_cast<int>(p);
+            }
+        }
+    }
+    goal_ = goal;
+    patterns_ = static_cast<int>(masks.size());
+    return true;
+}
+
+bool PatternDatabase::build(const PuzzleState &goal, const std::vector<std::vector<int>> &partition) {
+    close();
+    std::vector<uint16_t> masks;
+    for (const std::vector<int> &group : partition) {
+        uint16_t mask = 0;
+        for (int tile : group) {
+            if (tile < 1 || tile > 15 || (mask >> tile & 1)) return false;
+            mask |= 1 << tile;
+        }
+        masks.push_back(mask);
+    }
+    if (!setPartition(goal.asPacked(), masks)) {
+        close();
+        return false;
+    }
+
+    size_t total = 0;
+    for (int p = 0; p < patterns_; ++p) {
+        total += tableBytes(static_cast<int>(tiles_[p].size()));
+    }
+    built_.assign(total, 0xFF);
+    unsigned char *table = built_.data();
+    for (int p = 0; p < patterns_; ++p) {
+        buildTable(tiles_[p], goalWhere_, table);
+        tables_[p] = table;
+        table += tableBytes(static_cast<int>(tiles_[p].size()));
+    }
+    return true;
+}
+
+bool PatternDatabase::save(const std::string &fileName) const {
+    if (!ready()) return false;
+    std::ofstream out(fileName, std::ios::binary);
+    if (!out) {
+        std::cerr << "Unable to open " << fileName << std::endl;
+        return false;
+    }
+
+    unsigned char header[HEADER_BYTES] = {};
+    uint32_t count = static_cast<uint32_t>(patterns_);
+    std::memcpy(header, "CS225PDB", 8);
+    std::memcpy(header + 8, &VERSION, sizeof(VERSION));
+    std::memcpy(header + 12, &count, sizeof(count));
+    std::memcpy(header + 16, &goal_, sizeof(goal_));
+    for (int p = 0; p < patterns_; ++p) {
+        uint16_t mask = 0;
+        for (int tile : tiles_[p]) {
+            mask |= 1 << tile;
+        }
+        std::memcpy(header + 24 + 2 * p, &mask, sizeof(mask));
+    }
+    out.write(reinterpret_cast<const char *>(header), HEADER_BYTES);
+    for (int p = 0; p < patterns_; ++p) {
+        out.write(reinterpret_cast<const char *>(tables_[p]), tableBytes(static_cast<int>(tiles_[p].size())));
+    }
+    if (!out) {
+        std::cerr << "Unable to write " << fileName << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool PatternDatabase::open(const std::string &fileName) {
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Unable to open " << fileName << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < HEADER_BYTES) {
+        std::cerr << fileName << " is not a pattern database" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "Unable to map " << fileName << std::endl;
+        return false;
+    }
+    data_ = data;
+    size_ = size;
+
+    // The header is checked against the file size before it is trusted
+    const unsigned char *bytes = static_cast<const unsigned char *>(data_);
+    uint32_t count = readField<uint32_t>(bytes, 12);
+    std::vector<uint16_t> masks;
+    for (uint32_t p = 0; p < count && p < MAX_PATTERNS; ++p) {
+        masks.push_back(readField<uint16_t>(bytes, 24 + 2 * p));
+    }
+    if (std::memcmp(bytes, "CS225PDB", 8) != 0 || readField<uint32_t>(bytes, 8) != VERSION
+        || count > MAX_PATTERNS || !setPartition(readField<uint64_t>(bytes, 16), masks)) {
+        std::cerr << fileName << " is not a pattern database" << std::endl;
+        close();
+        return false;
+    }
+    size_t offset = HEADER_BYTES;
+    for (int p = 0; p < patterns_; ++p) {
+        size_t length = tableBytes(static_cast<int>(tiles_[p].size()));
+        if (size_ - offset < length) {
+            std::cerr << fileName << " is truncated" << std::endl;
+            close();
+            return false;
+        }
+        tables_[p] = bytes + offset;
+        offset += length;
+    }
+    return true;
+}
+
+bool PatternDatabase::ready() const {
+    return patterns_ > 0;
+}
+
+PuzzleState PatternDatabase::goal() const {
+    return PuzzleState::fromPacked(goal_);
+}
+
+int PatternDatabase::patternCount() const {
+    return patterns_;
+}
+
+int PatternDatabase::patternOf(int tile) const {
+    return patternOf_[tile];
+}
+
+int PatternDatabase::excess(int pattern, const std::array<int, 16> &where) const {
+    const std::vector<int> &tiles = tiles_[pattern];
+    int positions[MAX_PATTERN_TILES];
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        positions[i] = where[tiles[i]];
+    }
+    uint64_t entry = rank(positions, static_cast<int>(tiles.size()));
+    unsigned char byte = tables_[pattern][entry / 2];
+    return entry % 2 ? byte >> 4 : byte & 0xF;
+}
+
+int PatternDatabase::estimate(const PuzzleState &state) const {
+    std::array<char, 16> tiles = state.asArray();
+    std::array<int, 16> where;
+    for (int i = 0; i < 16; ++i) {
+        where[static_cast<int>(tiles[i])] = i;
+    }
+    int total = 0;
+    for (int tile = 1; tile < 16; ++tile) {
+        total += distance(where[tile], goalWhere_[tile]);
+    }
+    for (int p = 0; p < patterns_; ++p) {
+        total += 2 * excess(p, where);
+    }
+    return total;
+}
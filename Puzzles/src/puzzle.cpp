@@ -1,172 +1,216 @@
 #include "puzzle.h"
+#include "heuristic.h"
+#include "patterndb.h"
+#include "statetable.h"
 #include <algorithm>
+#include <climits>
 #include <cmath>
 #include <vector>
 #include <stdexcept>
 
-// Default constructor: initializes the puzzle to the solved state
-PuzzleState::PuzzleState() {
-    for (char i = 0; i < 15; ++i) {
-        state_[i] = i + 1;
-    }
-    state_[15] = 0;
-}
+// Default constructor: initializes the puzzle to the solved state, tiles
+// 1 to CELLS - 1 in order and then the empty space
+template <int Rows, int Cols>
+SlidingPuzzle<Rows, Cols>::SlidingPuzzle() : tiles_(SOLVED), empty_(CELLS - 1) {}
 
 // Custom constructor: initializes the puzzle with a given state
-PuzzleState::PuzzleState(const std::array<char, 16> state) {
-    if (std::all_of(state.begin(), state.end(), [](char val) { return val >= 0 && val <= 15; }) &&
+template <int Rows, int Cols>
+SlidingPuzzle<Rows, Cols>::SlidingPuzzle(const std::array<char, CELLS> state) : tiles_(), empty_(0) {
+    if (std::all_of(state.begin(), state.end(), [](char val) { return val >= 0 && val < CELLS; }) &&
         std::count(state.begin(), state.end(), 0) == 1) {
-        state_ = state;
-    } else {
-        state_.fill(0); // Invalid input, initialize with zeros
+        for (int i = 0; i < CELLS; ++i) {
+            tiles_[word(i)] |= static_cast<uint64_t>(state[i]) << shift(i);
+            if (state[i] == 0) {
+                empty_ = i;
+            }
+        }
+    } // Otherwise invalid input: all zeros
+}
+
+template <int Rows, int Cols>
+SlidingPuzzle<Rows, Cols> SlidingPuzzle<Rows, Cols>::fromWords(const Packed &words) {
+    SlidingPuzzle state;
+    state.tiles_ = words;
+    state.empty_ = 0;
+    while (state.empty_ < CELLS - 1 && state.tileAt(state.empty_) != 0) {
+        ++state.empty_;
     }
+    return state;
+}
+
+template <int Rows, int Cols>
+const typename SlidingPuzzle<Rows, Cols>::Packed &SlidingPuzzle<Rows, Cols>::asWords() const {
+    return tiles_;
 }
 
 // Convert the puzzle state to an array
-std::array<char, 16> PuzzleState::asArray() const {
-    return state_;
+template <int Rows, int Cols>
+std::array<char, SlidingPuzzle<Rows, Cols>::CELLS> SlidingPuzzle<Rows, Cols>::asArray() const {
+    std::array<char, CELLS> state;
+    for (int i = 0; i < CELLS; ++i) {
+        state[i] = static_cast<char>(tileAt(i));
+    }
+    return state;
 }
 
 // Equality operator
-bool PuzzleState::operator==(const PuzzleState &rhs) const {
-    return state_ == rhs.state_;
+template <int Rows, int Cols>
+bool SlidingPuzzle<Rows, Cols>::operator==(const SlidingPuzzle &rhs) const {
+    return tiles_ == rhs.tiles_;
 }
 
 // Inequality operator
-bool PuzzleState::operator!=(const PuzzleState &rhs) const {
-    return state_ != rhs.state_;
+template <int Rows, int Cols>
+bool SlidingPuzzle<Rows, Cols>::operator!=(const SlidingPuzzle &rhs) const {
+    return tiles_ != rhs.tiles_;
 }
 
-// Less-than operator (for use in std::map and std::set)
-bool PuzzleState::operator<(const PuzzleState &rhs) const {
-    return state_ < rhs.state_;
+// Less-than operator (for use in std::map and std::set); the first tile is
+// the most significant field, so this is the lexicographic order
+template <int Rows, int Cols>
+bool SlidingPuzzle<Rows, Cols>::operator<(const SlidingPuzzle &rhs) const {
+    return tiles_ < rhs.tiles_;
 }
 
-// Helper function to locate the empty tile (0)
-int PuzzleState::findEmptyTile() const {
-    auto it = std::find(state_.begin(), state_.end(), 0);
-    return std::distance(state_.begin(), it);
+// The empty field is zero, so moving a tile is a subtract and an add
+template <int Rows, int Cols>
+SlidingPuzzle<Rows, Cols> SlidingPuzzle<Rows, Cols>::moved(int from) const {
+    uint64_t tile = static_cast<uint64_t>(tileAt(from));
+    SlidingPuzzle neighbor = *this;
+    neighbor.tiles_[word(from)] -= tile << shift(from);
+    neighbor.tiles_[word(empty_)] += tile << shift(empty_);
+    neighbor.empty_ = from;
+    return neighbor;
 }
 
-PuzzleState PuzzleState::getNeighbor(Direction direction) const {
-    int emptyTile = findEmptyTile();
-    int row = emptyTile / 4;
-    int col = emptyTile % 4;
-
-    PuzzleState neighbor = *this;
-
-    switch (direction) {
-        case Direction::UP:
-            if (row > 0) {
-                std::swap(neighbor.state_[emptyTile], neighbor.state_[emptyTile - 4]);
-            } else {
-                return PuzzleState(std::array<char, 16>{0});
-            }
-            break;
-        case Direction::DOWN:
-            if (row < 3) {
-                std::swap(neighbor.state_[emptyTile], neighbor.state_[emptyTile + 4]);
-            } else {
-                return PuzzleState(std::array<char, 16>{0});
-            }
-            break;
-        case Direction::LEFT:
-            if (col > 0) {
-                std::swap(neighbor.state_[emptyTile], neighbor.state_[emptyTile - 1]);
-            } else {
-                return PuzzleState(std::array<char, 16>{0});
-            }
-            break;
-        case Direction::RIGHT:
-            if (col < 3) {
-                std::swap(neighbor.state_[emptyTile], neighbor.state_[emptyTile + 1]);
-            } else {
-                return PuzzleState(std::array<char, 16>{0});
-            }
-            break;
+// The tile moves the given way, so it comes from the opposite side of the
+// empty space
+template <int Rows, int Cols>
+SlidingPuzzle<Rows, Cols> SlidingPuzzle<Rows, Cols>::getNeighbor(Direction direction) const {
+    int from = MOVES[empty_][static_cast<int>(direction)];
+    if (from < 0) {
+        return SlidingPuzzle(std::array<char, CELLS>{0});
     }
-
-    return neighbor;
+    return moved(from);
 }
 
-
+template <int Rows, int Cols>
+size_t SlidingPuzzle<Rows, Cols>::getNeighbors(std::array<SlidingPuzzle, 4> &neighbors) const {
+    size_t count = 0;
+    for (int from : MOVES[empty_]) {
+        if (from >= 0) neighbors[count++] = moved(from);
+    }
+    return count;
+}
 
 // Get all possible neighbors
-std::vector<PuzzleState> PuzzleState::getNeighbors() const {
-    std::vector<PuzzleState> neighbors;
-    for (Direction dir : {Direction::UP, Direction::DOWN, Direction::LEFT, Direction::RIGHT}) {
-        PuzzleState neighbor = getNeighbor(dir);
-        if (neighbor.state_ != std::array<char, 16>{0}) { // Exclude invalid states
-            neighbors.push_back(neighbor);
-        }
-    }
-    return neighbors;
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> SlidingPuzzle<Rows, Cols>::getNeighbors() const {
+    std::array<SlidingPuzzle, 4> neighbors;
+    size_t count = getNeighbors(neighbors);
+    return std::vector<SlidingPuzzle>(neighbors.begin(), neighbors.begin() + count);
 }
 
-int PuzzleState::manhattanDistance(const PuzzleState desiredState /*= PuzzleState()*/) const {
-    PuzzleState solvedState;  // Default is solved state if none provided
-    const PuzzleState &goalState = (desiredState.asArray() == std::array<char, 16>{0}) ? solvedState : desiredState;
+template <int Rows, int Cols>
+int SlidingPuzzle<Rows, Cols>::manhattanDistance(const SlidingPuzzle desiredState /*= SlidingPuzzle()*/) const {
+    // An invalid (all zero) goal means the solved state
+    std::array<uint8_t, CELLS> goalCell = GOAL_CELL;
+    if (desiredState.tiles_ != SOLVED && desiredState.tiles_ != Packed{}) {
+        for (int i = 0; i < CELLS; ++i) {
+            goalCell[desiredState.tileAt(i)] = static_cast<uint8_t>(i);
+        }
+    }
 
     int distance = 0;
-
-    for (char tile = 1; tile <= 15; ++tile) { // Ignore tile 0 (empty space)
-        int currIndex = std::find(state_.begin(), state_.end(), tile) - state_.begin();
-        int goalIndex = std::find(goalState.state_.begin(), goalState.state_.end(), tile) - goalState.state_.begin();
-
-        int currRow = currIndex / 4;
-        int currCol = currIndex % 4;
-
-        int goalRow = goalIndex / 4;
-        int goalCol = goalIndex % 4;
-
-        distance += std::abs(currRow - goalRow) + std::abs(currCol - goalCol);
+    for (int i = 0; i < CELLS; ++i) {
+        int tile = tileAt(i);
+        if (tile == 0) continue; // Ignore the empty space
+        distance += DISTANCE[i][goalCell[tile]];
     }
 
     return distance;
 }
 
-
-
-// Define a hash function for PuzzleState to use with unordered_set/unordered_map
-struct PuzzleStateHash {
-    std::size_t operator()(const PuzzleState &state) const {
-        std::array<char, 16> arr = state.asArray();
-        return std::hash<std::string>()(std::string(arr.begin(), arr.end()));
+// The states must hold the same distinct tiles, and the permutation
+// between them must be even exactly when the blank is an even number of
+// moves away: every move swaps the blank with a tile and moves it by one
+template <int Rows, int Cols>
+bool isSolvable(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState) {
+    const int cells = Rows * Cols;
+    std::array<char, cells> start = startState.asArray();
+    std::array<char, cells> goal = desiredState.asArray();
+    std::array<int, cells> where;
+    std::array<bool, cells> present{};
+    where.fill(-1);
+    for (int i = 0; i < cells; ++i) {
+        if (where[static_cast<int>(goal[i])] != -1 || present[static_cast<int>(start[i])]) return false;
+        where[static_cast<int>(goal[i])] = i;
+        present[static_cast<int>(start[i])] = true;
+    }
+    std::array<bool, cells> seen{};
+    int parity = 0, blankStart = 0, blankGoal = where[0];
+    for (int i = 0; i < cells; ++i) {
+        if (start[i] == 0) blankStart = i;
+        if (seen[i]) continue;
+        int length = 0;
+        for (int j = i; !seen[j]; j = where[static_cast<int>(start[j])]) {
+            seen[j] = true;
+            ++length;
+        }
+        parity ^= (length - 1) & 1;
     }
-};
+    return parity == (SlidingPuzzle<Rows, Cols>::DISTANCE[blankStart][blankGoal] & 1);
+}
+
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveBFS(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState,
+                                                size_t *iterations) {
+    typedef SlidingPuzzle<Rows, Cols> State;
+    const typename State::Direction directions[4] = {State::Direction::UP, State::Direction::DOWN,
+                                                     State::Direction::LEFT, State::Direction::RIGHT};
 
-std::vector<PuzzleState> solveBFS(const PuzzleState &startState, const PuzzleState &desiredState, size_t *iterations) {
     if (startState == desiredState) {
         if (iterations) *iterations = 1;
         return {startState};
     }
 
-    std::queue<std::vector<PuzzleState>> queue;
-    std::unordered_set<PuzzleState, PuzzleStateHash> visited;
-    queue.push({startState});
+    // Every queued state is kept in one flat arena, in the order it was
+    // queued, with the index of the state it was reached from and the
+    // direction of the move. The queue is the part of the arena past head.
+    std::vector<typename State::Packed> states(1, startState.asWords());
+    std::vector<uint32_t> parents(1, 0);
+    std::vector<uint8_t> moves(1, 0);
+    std::unordered_set<State, PuzzleStateHash> visited;
     visited.insert(startState);
 
     size_t steps = 0;
-
-    while (!queue.empty()) {
+    for (size_t head = 0; head < states.size(); ++head) {
         ++steps; // Increment for every state popped from the queue
-        auto path = queue.front();
-        queue.pop();
+        State current = State::fromWords(states[head]);
 
-        const PuzzleState &currentState = path.back();
-        for (const PuzzleState &neighbor : currentState.getNeighbors()) {
+        for (uint8_t d = 0; d < 4; ++d) {
+            if (State::MOVES[current.emptyCell()][d] < 0) continue;
+            State neighbor = current.getNeighbor(directions[d]);
             if (visited.find(neighbor) != visited.end()) continue;
 
-            std::vector<PuzzleState> newPath = path;
-            newPath.push_back(neighbor);
-
             if (neighbor == desiredState) {
+                // Collect the moves back to the start, then replay them
+                std::vector<uint8_t> path(1, d);
+                for (size_t i = head; i != 0; i = parents[i]) {
+                    path.push_back(moves[i]);
+                }
+                std::vector<State> solution = {startState};
+                for (size_t i = path.size(); i-- > 0; ) {
+                    solution.push_back(solution.back().getNeighbor(directions[path[i]]));
+                }
                 if (iterations) *iterations = steps;
-                return newPath;
+                return solution;
             }
 
-            queue.push(newPath);
             visited.insert(neighbor);
+            states.push_back(neighbor.asWords());
+            parents.push_back(static_cast<uint32_t>(head));
+            moves.push_back(d);
         }
     }
 
@@ -176,59 +220,147 @@ std::vector<PuzzleState> solveBFS(const PuzzleState &startState, const PuzzleSta
 
 
 
-std::vector<PuzzleState> solveAstar(const PuzzleState &startState, const PuzzleState &desiredState, size_t *iterations) {
+namespace {
+    template <typename Packed>
+    struct OpenEntry {
+        Packed state;
+        int g;
+        int h; // Kept so the neighbors' estimates only need the change
+    };
+
+    // Open states in one stack per f value. f values are small, so the
+    // smallest is found by stepping up from the last one popped; a push
+    // below it (possible with an inconsistent heuristic) moves it back down.
+    template <typename Packed>
+    class BucketQueue {
+    public:
+        BucketQueue() : lowest_(0), size_(0) {}
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        void push(const Packed &state, int g, int h) {
+            size_t f = g + h;
+            if (f >= buckets_.size()) buckets_.resize(f + 1);
+            buckets_[f].push_back(OpenEntry<Packed>{state, g, h});
+            lowest_ = std::min(lowest_, f);
+            ++size_;
+        }
+
+        OpenEntry<Packed> pop() {
+            while (buckets_[lowest_].empty()) {
+                ++lowest_;
+            }
+            OpenEntry<Packed> entry = buckets_[lowest_].back();
+            buckets_[lowest_].pop_back();
+            --size_;
+            return entry;
+        }
+
+    private:
+        std::vector<std::vector<OpenEntry<Packed>>> buckets_;
+        size_t lowest_;
+        size_t size_;
+    };
+}
+
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveAstar(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState,
+                                                  size_t *iterations, const PatternDatabase *patterns) {
+    typedef SlidingPuzzle<Rows, Cols> State;
+    typedef typename State::Packed Packed;
     if (startState == desiredState) {
         if (iterations) *iterations = 1;
         return {startState};
     }
+    if (!isSolvable(startState, desiredState)) {
+        if (iterations) *iterations = 0;
+        return {};
+    }
 
-    auto compare = [](const std::pair<PuzzleState, int> &a, const std::pair<PuzzleState, int> &b) {
-        return a.second > b.second;
+    // The manhattan distance is computed once, then updated from the tile
+    // each move slides. Pattern databases are built for the 15-puzzle only
+    // and are looked up whole.
+    MoveEstimator<Rows, Cols> estimator(desiredState, false);
+    auto heuristic = [&](const State &state, int manhattan) {
+        if constexpr (Rows == 4 && Cols == 4) {
+            if (patterns) return patterns->estimate(state);
+        }
+        return manhattan;
     };
+    if constexpr (Rows == 4 && Cols == 4) {
+        if (patterns && (!patterns->ready() || patterns->goal() != desiredState)) patterns = NULL;
+    }
 
-    std::priority_queue<std::pair<PuzzleState, int>, std::vector<std::pair<PuzzleState, int>>, decltype(compare)> openSet(compare);
-    std::unordered_set<PuzzleState, PuzzleStateHash> closedSet;
-    std::map<PuzzleState, PuzzleState> cameFrom;
-    std::map<PuzzleState, int> gScore;
-
-    gScore[startState] = 0;
-    openSet.push({startState, startState.manhattanDistance(desiredState)});
+    StateTable<Packed> records;
+    BucketQueue<Packed> openSet;
+    records.insert(startState.asWords()).g = 0;
+    openSet.push(startState.asWords(), 0, heuristic(startState, estimator.estimate(startState)));
 
     size_t steps = 0;
 
     while (!openSet.empty()) {
+        OpenEntry<Packed> entry = openSet.pop();
+        StateRecord<Packed> &record = *records.find(entry.state);
+        if (record.closed || entry.g != record.g) continue; // Reached again with fewer moves
         ++steps; // Increment for every state processed
-        auto current = openSet.top().first;
-        openSet.pop();
+        record.closed = true;
 
+        State current = State::fromWords(entry.state);
         if (current == desiredState) {
-            std::vector<PuzzleState> path;
-            while (current != startState) {
-                path.push_back(current);
-                current = cameFrom[current];
+            std::vector<State> path;
+            for (Packed state = entry.state; state != Packed{}; state = records.find(state)->parent) {
+                path.push_back(State::fromWords(state));
             }
-            path.push_back(startState);
             std::reverse(path.begin(), path.end());
             if (iterations) *iterations = steps;
             return path;
         }
 
-        closedSet.insert(current);
-
-        for (const PuzzleState &neighbor : current.getNeighbors()) {
-            if (closedSet.find(neighbor) != closedSet.end()) continue;
-
-            int tentativeGScore = gScore[current] + 1;
-
-            if (gScore.find(neighbor) == gScore.end() || tentativeGScore < gScore[neighbor]) {
-                cameFrom[neighbor] = current;
-                gScore[neighbor] = tentativeGScore;
-                int fScore = tentativeGScore + neighbor.manhattanDistance(desiredState);
-                openSet.push({neighbor, fScore});
-            }
+        std::array<State, 4> neighbors;
+        std::array<int, 4> deltas;
+        size_t count = estimator.neighbors(current, neighbors, deltas);
+        for (size_t i = 0; i < count; ++i) {
+            const State &neighbor = neighbors[i];
+            int tentativeGScore = entry.g + 1;
+
+            // Pattern database estimates need not be consistent, so a closed
+            // state is reopened if a shorter path to it turns up
+            StateRecord<Packed> &next = records.insert(neighbor.asWords());
+            if (tentativeGScore >= next.g) continue;
+            next.parent = entry.state;
+            next.g = tentativeGScore;
+            next.closed = false;
+            openSet.push(neighbor.asWords(), tentativeGScore, heuristic(neighbor, entry.h + deltas[i]));
         }
     }
 
     if (iterations) *iterations = steps;
     return {};
 }
+
+// The 2x4 board and boards from 3x3 to 6x6
+template class SlidingPuzzle<2, 4>;
+template class SlidingPuzzle<3, 3>;
+template class SlidingPuzzle<4, 4>;
+template class SlidingPuzzle<5, 5>;
+template class SlidingPuzzle<6, 6>;
+
+template bool isSolvable(const SlidingPuzzle<2, 4> &, const SlidingPuzzle<2, 4> &);
+template bool isSolvable(const SlidingPuzzle<3, 3> &, const SlidingPuzzle<3, 3> &);
+template bool isSolvable(const SlidingPuzzle<4, 4> &, const SlidingPuzzle<4, 4> &);
+template bool isSolvable(const SlidingPuzzle<5, 5> &, const SlidingPuzzle<5, 5> &);
+template bool isSolvable(const SlidingPuzzle<6, 6> &, const SlidingPuzzle<6, 6> &);
+
+template std::vector<SlidingPuzzle<2, 4>> solveBFS(const SlidingPuzzle<2, 4> &, const SlidingPuzzle<2, 4> &, size_t *);
+template std::vector<SlidingPuzzle<3, 3>> solveBFS(const SlidingPuzzle<3, 3> &, const SlidingPuzzle<3, 3> &, size_t *);
+template std::vector<SlidingPuzzle<4, 4>> solveBFS(const SlidingPuzzle<4, 4> &, const SlidingPuzzle<4, 4> &, size_t *);
+template std::vector<SlidingPuzzle<5, 5>> solveBFS(const SlidingPuzzle<5, 5> &, const SlidingPuzzle<5, 5> &, size_t *);
+template std::vector<SlidingPuzzle<6, 6>> solveBFS(const SlidingPuzzle<6, 6> &, const SlidingPuzzle<6, 6> &, size_t *);
+
+template std::vector<SlidingPuzzle<2, 4>> solveAstar(const SlidingPuzzle<2, 4> &, const SlidingPuzzle<2, 4> &, size_t *, const PatternDatabase *);
+template std::vector<SlidingPuzzle<3, 3>> solveAstar(const SlidingPuzzle<3, 3> &, const SlidingPuzzle<3, 3> &, size_t *, const PatternDatabase *);
+template std::vector<SlidingPuzzle<4, 4>> solveAstar(const SlidingPuzzle<4, 4> &, const SlidingPuzzle<4, 4> &, size_t *, const PatternDatabase *);
+template std::vector<SlidingPuzzle<5, 5>> solveAstar(const SlidingPuzzle<5, 5> &, const SlidingPuzzle<5, 5> &, size_t *, const PatternDatabase *);
+template std::vector<SlidingPuzzle<6, 6>> solveAstar(const SlidingPuzzle<6, 6> &, const SlidingPuzzle<6, 6> &, size_t *, const PatternDatabase *);
@@ -5,6 +5,8 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include "puzzle.h"
 #include <queue>
@@ -12,9 +14,90 @@
 #include <map>
 #include <set>
 #include <functional>
+#include <type_traits>
 
-class PuzzleState {
+class PatternDatabase;
+
+namespace puzzle_tables {
+    // For each cell of the empty space, the cell the tile comes from when
+    // moving UP, DOWN, LEFT and RIGHT, or -1 if that move leaves the board
+    template <int Rows, int Cols>
+    constexpr std::array<std::array<int8_t, 4>, Rows * Cols> moves() {
+        std::array<std::array<int8_t, 4>, Rows * Cols> table{};
+        for (int cell = 0; cell < Rows * Cols; ++cell) {
+            int row = cell / Cols, col = cell % Cols;
+            table[cell][0] = static_cast<int8_t>(row < Rows - 1 ? cell + Cols : -1);
+            table[cell][1] = static_cast<int8_t>(row > 0 ? cell - Cols : -1);
+            table[cell][2] = static_cast<int8_t>(col < Cols - 1 ? cell + 1 : -1);
+            table[cell][3] = static_cast<int8_t>(col > 0 ? cell - 1 : -1);
+        }
+        return table;
+    }
+
+    // The manhattan distance between every pair of cells
+    template <int Rows, int Cols>
+    constexpr std::array<std::array<uint8_t, Rows * Cols>, Rows * Cols> distances() {
+        std::array<std::array<uint8_t, Rows * Cols>, Rows * Cols> table{};
+        for (int a = 0; a < Rows * Cols; ++a) {
+            for (int b = 0; b < Rows * Cols; ++b) {
+                int rows = a / Cols - b / Cols, cols = a % Cols - b % Cols;
+                table[a][b] = static_cast<uint8_t>((rows < 0 ? -rows : rows) + (cols < 0 ? -cols : cols));
+            }
+        }
+        return table;
+    }
+
+    // The cell of each tile in the solved state: tile t at cell t - 1 and
+    // the empty space last
+    template <int Rows, int Cols>
+    constexpr std::array<uint8_t, Rows * Cols> goalCells() {
+        std::array<uint8_t, Rows * Cols> table{};
+        table[0] = Rows * Cols - 1;
+        for (int tile = 1; tile < Rows * Cols; ++tile) {
+            table[tile] = static_cast<uint8_t>(tile - 1);
+        }
+        return table;
+    }
+
+    // The solved state packed Bits to a tile, first cell most significant
+    template <int Cells, int Bits, int Words>
+    constexpr std::array<uint64_t, Words> solved() {
+        std::array<uint64_t, Words> words{};
+        for (int i = 0; i < Cells - 1; ++i) {
+            words[i / (64 / Bits)] |= static_cast<uint64_t>(i + 1) << (64 - Bits * (i % (64 / Bits) + 1));
+        }
+        return words;
+    }
+}
+
+/**
+* A sliding puzzle of Rows x Cols cells, such as the 15-puzzle. Tiles are
+* numbered from 1 and the empty space is 0. The move, distance and goal
+* tables are built at compile time, so each size gets its own fully
+* specialized code. Boards of 2x4 and 3x3 to 6x6 are instantiated in
+* puzzle.cpp.
+*/
+template <int Rows, int Cols>
+class SlidingPuzzle {
 public:
+    static constexpr int ROWS = Rows;
+    static constexpr int COLS = Cols;
+    static constexpr int CELLS = Rows * Cols;
+
+    // Tiles are packed into 64-bit words with as few bits as hold the
+    // largest tile, and never straddle two words
+    static constexpr int BITS = CELLS <= 16 ? 4 : CELLS <= 32 ? 5 : 6;
+    static constexpr int PER_WORD = 64 / BITS;
+    static constexpr int WORDS = (CELLS + PER_WORD - 1) / PER_WORD;
+    static_assert(Rows >= 2 && Cols >= 2 && CELLS <= 64, "Boards are 2x2 up to 64 cells");
+
+    typedef std::array<uint64_t, WORDS> Packed;
+
+    static constexpr std::array<std::array<int8_t, 4>, CELLS> MOVES = puzzle_tables::moves<Rows, Cols>();
+    static constexpr std::array<std::array<uint8_t, CELLS>, CELLS> DISTANCE = puzzle_tables::distances<Rows, Cols>();
+    static constexpr std::array<uint8_t, CELLS> GOAL_CELL = puzzle_tables::goalCells<Rows, Cols>();
+    static constexpr Packed SOLVED = puzzle_tables::solved<CELLS, BITS, WORDS>();
+
     enum class Direction {
         UP,   // Refers to moving a tile up (i.e. the empty space goes down.)
         DOWN, // Refers to moving a tile down (i.e. the empty space goes up.)
@@ -26,7 +109,7 @@ public:
     * Default constructor for the puzzle state. This should initialize the
     * puzzle to the solved state.
     */
-    PuzzleState();
+    SlidingPuzzle();
 
     /**
     * Custom constructor for the puzzle state. Invalid inputs should initialize
@@ -45,27 +128,27 @@ public:
     * 8  9  10 11
     * 12 13 14 15
     */
-    PuzzleState(const std::array<char, 16> state);
+    SlidingPuzzle(const std::array<char, CELLS> state);
 
     /**
     * Convert the puzzle state to an array.
     * @return an array representing the state of the puzzle in the same format
     * as described in the constructor.
     */
-    std::array<char, 16> asArray() const;
+    std::array<char, CELLS> asArray() const;
 
     /**
     * Overloaded operator== for the puzzle state. Puzzles are equal when the
     * value of each tile is the same.
     * @param rhs The puzzle state to compare to
     */
-    bool operator==(const PuzzleState &rhs) const;
+    bool operator==(const SlidingPuzzle &rhs) const;
 
     /**
     * Overloaded operator!= for the puzzle state.
     * @param rhs The puzzle state to compare to
     */
-    bool operator!=(const PuzzleState &rhs) const;
+    bool operator!=(const SlidingPuzzle &rhs) const;
 
     /**
     * Overloaded operator< for the puzzle state. The PuzzleState with the first
@@ -73,7 +156,7 @@ public:
     * considered less, you can assume both puzzle states are valid.
     * @param rhs The puzzle state to compare to
     */
-    bool operator<(const PuzzleState &rhs) const;
+    bool operator<(const SlidingPuzzle &rhs) const;
 
     /**
     * Get the neighbor specified by the direction. If the direction refers to an
@@ -81,13 +164,66 @@ public:
     * @param direction The direction to move a tile (e.x. UP means the empty
     * space should move down).
     */
-    PuzzleState getNeighbor(Direction direction) const;
+    SlidingPuzzle getNeighbor(Direction direction) const;
 
     /**
     * Gets all possible PuzzleStates that result from a single move.
     * @return All possible next PuzzleStates in any order
     */
-    std::vector<PuzzleState> getNeighbors() const;
+    std::vector<SlidingPuzzle> getNeighbors() const;
+
+    /**
+    * Gets all possible PuzzleStates that result from a single move without
+    * allocating.
+    * @param neighbors Receives the neighbors in the order UP, DOWN, LEFT,
+    * RIGHT, skipping moves that would leave the board
+    * @return The number of neighbors written, from 2 to 4
+    */
+    size_t getNeighbors(std::array<SlidingPuzzle, 4> &neighbors) const;
+
+    /**
+    * Gets the packed words of the puzzle: the tile at index i of asArray()
+    * is the field of BITS bits at word i / PER_WORD, starting from the most
+    * significant end, and unused low bits are zero. Comparing the words in
+    * order orders states the same way as operator<.
+    */
+    const Packed &asWords() const;
+
+    /**
+    * Builds a puzzle state from the output of asWords(). The words must
+    * hold exactly one empty tile; no other checks are made.
+    */
+    static SlidingPuzzle fromWords(const Packed &words);
+
+    /**
+    * Gets a puzzle of at most 16 cells as one 64-bit word: the tile at
+    * index i of asArray() is the 4-bit nibble at bits 60 - 4i to 63 - 4i,
+    * so the first tile is the most significant. Comparing packed words
+    * orders states the same way as operator<.
+    */
+    template <int W = WORDS, typename = typename std::enable_if<W == 1>::type>
+    uint64_t asPacked() const {
+        return tiles_[0];
+    }
+
+    /**
+    * Builds a puzzle state from the output of asPacked(). The word must hold
+    * exactly one empty tile; no other checks are made.
+    */
+    template <int W = WORDS, typename = typename std::enable_if<W == 1>::type>
+    static SlidingPuzzle fromPacked(uint64_t packed) {
+        return fromWords(Packed{packed});
+    }
+
+    /**
+    * @return the cell of the empty space
+    */
+    int emptyCell() const { return empty_; }
+
+    /**
+    * @return the tile at a cell, 0 for the empty space
+    */
+    int tileAt(int cell) const { return static_cast<int>((tiles_[word(cell)] >> shift(cell)) & ((1u << BITS) - 1)); }
 
     /**
     * Calculates the "manhattan distance" between the current state and the goal
@@ -96,14 +232,68 @@ public:
     * @param desiredState The state to calculate the distance to
     * @return The manhattan distance between the current and goal states
     */
-    int manhattanDistance(const PuzzleState desiredState = PuzzleState()) const;
+    int manhattanDistance(const SlidingPuzzle desiredState = SlidingPuzzle()) const;
 
 
 private:
-    std::array<char, 16> state_; // Internal representation of the puzzle state
-    int findEmptyTile() const; // Helper function to find the empty tile position
+    Packed tiles_;   // Tiles packed in row-major order, first tile at the top
+    uint8_t empty_;  // Index of the empty tile, kept in step with tiles_
+
+    // Gets the word and bit offset of the field holding tile index i
+    static int word(int i) { return i / PER_WORD; }
+    static int shift(int i) { return 64 - BITS * (i % PER_WORD + 1); }
+
+    // Slides the tile at index from into the empty space
+    SlidingPuzzle moved(int from) const;
+};
+
+/**
+* The 15-puzzle.
+*/
+typedef SlidingPuzzle<4, 4> PuzzleState;
+
+/**
+* Hashes puzzle states for std::unordered_set and std::unordered_map by
+* mixing the packed words with multiplies and xor-shifts.
+*/
+struct PuzzleStateHash {
+    template <int Rows, int Cols>
+    std::size_t operator()(const SlidingPuzzle<Rows, Cols> &state) const {
+        return mix(state.asWords());
+    }
+
+    // Hashes a packed state directly
+    static std::size_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return static_cast<std::size_t>(h);
+    }
+
+    template <size_t Words>
+    static std::size_t mix(const std::array<uint64_t, Words> &words) {
+        uint64_t h = words[0];
+        for (size_t i = 1; i < Words; ++i) {
+            h = mix(h) ^ words[i];
+        }
+        return mix(h);
+    }
 };
 
+/**
+* Determines whether any sequence of moves leads from one state to another.
+* Exactly half of all arrangements can reach a given state, which is told
+* by the parity of the permutation between the two states and of the
+* distance between their empty spaces.
+* @param startState The starting state of the puzzle
+* @param desiredState The final goal state of the puzzle
+* @return true, if both states are valid and desiredState can be reached
+*/
+template <int Rows, int Cols>
+bool isSolvable(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState);
+
 /**
 * Solves the puzzle using BFS.
 * @param startState The starting state of the puzzle
@@ -116,10 +306,15 @@ private:
 * @return The path to the solution. The first element of the vector is the start
 * state, and the last element is the desired state. Empty if no solution exists.
 */
-std::vector<PuzzleState> solveBFS(const PuzzleState &startState, const PuzzleState &desiredState, size_t *iterations = NULL);
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveBFS(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState, size_t *iterations = NULL);
 
 /**
-* Solves the puzzle using A* with manhattan distance as a heuristic.
+* Solves the puzzle using A* with manhattan distance as a heuristic, or with
+* the estimates of a pattern database built for desiredState. Open states
+* wait in one stack per f value, so ties go to the state pushed last, and
+* each state's g, parent and closed flag live in one open-addressing hash
+* table.
 * @param startState The starting state of the puzzle
 * @param desiredState The final goal state of the puzzle after solving
 * @param iterations The number of iterations it took to solve the puzzle. An
@@ -129,19 +324,100 @@ std::vector<PuzzleState> solveBFS(const PuzzleState &startState, const PuzzleSta
 * stored at this pointer to evaluate efficiency. Ignore if NULL.
 * @return The path to the solution. The first element of the vector is the start
 * state, and the last element is the desired state. Empty if no solution exists.
+* @param patterns A pattern database to use as the heuristic. Ignored if NULL,
+* not ready, built for a different goal than desiredState, or if the board
+* is not 4x4.
+*/
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveAstar(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState, size_t *iterations = NULL,
+                                                  const PatternDatabase *patterns = NULL);
+
+/**
+* Solves the puzzle optimally using IDA*: depth-first searches bounded by
+* f = g + h, raising the bound to the smallest f that exceeded it until the
+* goal is reached. h is the manhattan distance plus linear conflicts (two
+* extra moves for each tile that has to leave its goal row or column to let
+* another tile past), updated per move from the few lines the move touches.
+* With a pattern database, h is the larger of that and the database's
+* estimate, which is updated from the one group the moved tile belongs to.
+* Only the current path is stored, and the last move is never undone.
+* @param startState The starting state of the puzzle
+* @param desiredState The final goal state of the puzzle after solving
+* @param iterations The number of states visited by all of the depth-first
+* searches together. Ignore if NULL.
+* @return The path to the solution. The first element of the vector is the start
+* state, and the last element is the desired state. Empty if no solution exists.
+* @param patterns A pattern database to strengthen the heuristic. Ignored if
+* NULL, not ready, built for a different goal than desiredState, or if the
+* board is not 4x4.
+*/
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveIDAstar(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState, size_t *iterations = NULL,
+                                                    const PatternDatabase *patterns = NULL);
+
+/**
+* Solves the puzzle optimally like solveIDAstar(), on several threads.
+* Every move sequence of the first few moves is enumerated until there
+* are a few dozen per thread; each iteration then searches the subtrees
+* under them with one shared bound, taking them from a common counter, and
+* the next bound is the smallest f that exceeded it in any subtree. The
+* first solution found stops every thread. Which of several optimal
+* solutions is returned can differ between runs.
+* @param startState The starting state of the puzzle
+* @param desiredState The final goal state of the puzzle after solving
+* @param threads Number of worker threads; 0 uses
+*  std::thread::hardware_concurrency()
+* @param iterations The number of states visited by all threads together.
+* Ignore if NULL.
+* @param patterns As for solveIDAstar()
+* @return The path to the solution, as for solveIDAstar()
+*/
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveIDAstarParallel(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState,
+                                                            unsigned threads = 0, size_t *iterations = NULL, const PatternDatabase *patterns = NULL);
+
+/**
+* Solves the puzzle using BFS from both ends at once: whole levels are
+* expanded from whichever of the start and the goal has the smaller
+* frontier, until the two searches meet. The shortest meeting found in the
+* level where they first meet is an optimal solution.
+* @param startState The starting state of the puzzle
+* @param desiredState The final goal state of the puzzle after solving
+* @param iterations The number of states expanded by both searches. Ignore
+* if NULL.
+* @return The path to the solution. The first element of the vector is the start
+* state, and the last element is the desired state. Empty if no solution exists.
+*/
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveBidirectionalBFS(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState, size_t *iterations = NULL);
+
+/**
+* Solves the puzzle optimally using bidirectional A* with the MM ordering:
+* each side orders its states by max(f, 2g), with the manhattan distance
+* plus linear conflicts to the other side's root as h, and always expands
+* the smaller priority. The search stops once the shortest meeting of the
+* two sides is no longer than that priority.
+* @param startState The starting state of the puzzle
+* @param desiredState The final goal state of the puzzle after solving
+* @param iterations The number of states expanded by both searches. Ignore
+* if NULL.
+* @return The path to the solution. The first element of the vector is the start
+* state, and the last element is the desired state. Empty if no solution exists.
 */
-std::vector<PuzzleState> solveAstar(const PuzzleState& startState, const PuzzleState &desiredState, size_t *iterations = NULL);
+template <int Rows, int Cols>
+std::vector<SlidingPuzzle<Rows, Cols>> solveBidirectionalAstar(const SlidingPuzzle<Rows, Cols> &startState, const SlidingPuzzle<Rows, Cols> &desiredState, size_t *iterations = NULL);
 
 /**
  * Overloaded operator<< for the puzzle state, you can use this to print the puzzle.
  */
-inline std::ostream &operator<<(std::ostream &os, const PuzzleState &puzzle) {
-    std::array<char, 16> arr = puzzle.asArray();
-    for (size_t i = 0; i < 16; ++i) {
+template <int Rows, int Cols>
+std::ostream &operator<<(std::ostream &os, const SlidingPuzzle<Rows, Cols> &puzzle) {
+    std::array<char, Rows * Cols> arr = puzzle.asArray();
+    for (size_t i = 0; i < arr.size(); ++i) {
         if (arr[i] < 10)
             os << " ";
         os << (int)arr[i] << " ";
-        if ((i + 1) % 4 == 0) {
+        if ((i + 1) % Cols == 0) {
             os << std::endl;
         }
     }
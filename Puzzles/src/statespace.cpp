@@ -0,0 +1,244 @@
+/**
+ * @file statespace.cpp
+ * Myrvold-Ruskey ranking and the parallel breadth-first sweep of a whole
+ * puzzle state space.
+ */
+
+#include "statespace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+    const int MAX_EXCESS = 15;
+
+    // Below this many bitmap words per level, threads cost more than they save
+    const size_t PARALLEL_MIN = 1024;
+
+    constexpr uint64_t factorial(int n) {
+        return n <= 1 ? 1 : n * factorial(n - 1);
+    }
+
+    // Runs body(thread, begin, end) over [0, count) split into one range per thread
+    template <typename Body>
+    void parallelFor(size_t count, unsigned threads, Body body) {
+        if (count < PARALLEL_MIN) {
+            threads = 1;
+        }
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; t++) {
+            pool.emplace_back(body, t, count * t / threads, count * (t + 1) / threads);
+        }
+        body(0, 0, count / threads);
+        for (std::thread &thread : pool) {
+            thread.join();
+        }
+    }
+
+    // Ranks the tile at each cell. Each step swaps the last cell's tile for
+    // the tile numbered like the cell, taking the tile it found as the next
+    // mixed-radix digit, so the cells are consumed from the end.
+    template <size_t Cells>
+    uint64_t rankTiles(std::array<char, Cells> tiles) {
+        static_assert(Cells <= 20, "Ranks of more than 20 cells overflow 64 bits");
+        std::array<int, Cells> where;
+        for (size_t i = 0; i < Cells; ++i) {
+            where[static_cast<int>(tiles[i])] = static_cast<int>(i);
+        }
+        uint64_t rank = 0, scale = 1;
+        for (int n = Cells; n > 1; --n) {
+            int tile = tiles[n - 1];
+            std::swap(tiles[n - 1], tiles[where[n - 1]]);
+            std::swap(where[tile], where[n - 1]);
+            rank += tile * scale;
+            scale *= n;
+        }
+        return rank;
+    }
+
+    // Undoes the swaps of rankTiles(), starting from the identity
+    template <size_t Cells>
+    void unrankTiles(uint64_t rank, std::array<char, Cells> &tiles) {
+        for (size_t i = 0; i < Cells; ++i) {
+            tiles[i] = static_cast<char>(i);
+        }
+        for (int n = Cells; n > 1; --n) {
+            std::swap(tiles[n - 1], tiles[rank % n]);
+            rank /= n;
+        }
+    }
+}
+
+template <int Rows, int Cols>
+uint64_t rankState(const SlidingPuzzle<Rows, Cols> &state) {
+    return rankTiles(state.asArray());
+}
+
+template <int Rows, int Cols>
+SlidingPuzzle<Rows, Cols> unrankState(uint64_t rank) {
+    std::array<char, Rows * Cols> tiles;
+    unrankTiles(rank, tiles);
+    return SlidingPuzzle<Rows, Cols>(tiles);
+}
+
+template <int Rows, int Cols>
+StateSpace<Rows, Cols>::StateSpace() : goal_() {
+    goalCell_.fill(0);
+}
+
+template <int Rows, int Cols>
+bool StateSpace<Rows, Cols>::build(const State &goal, unsigned threads) {
+    constexpr int CELLS = Rows * Cols;
+    constexpr uint64_t RANKS = factorial(CELLS);
+    static_assert(RANKS <= (1ULL << 32), "Sweeps are for boards of up to 12 cells");
+    const size_t words = (RANKS + 63) / 64;
+
+    reached_.clear();
+    excess_.clear();
+    histogram_.clear();
+    hardest_.clear();
+    if (goal == State(std::array<char, CELLS>{0})) return false;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    goal_ = goal;
+    std::array<char, CELLS> goalTiles = goal.asArray();
+    for (int i = 0; i < CELLS; ++i) {
+        goalCell_[static_cast<int>(goalTiles[i])] = i;
+    }
+
+    std::vector<uint64_t> reached(words), frontier(words), found(words);
+    std::vector<std::atomic<uint64_t>> next(words);
+    std::vector<unsigned char> excess((RANKS + 1) / 2);
+    std::vector<size_t> counts(threads);
+    uint64_t root = rankTiles(goalTiles);
+    reached[root / 64] = frontier[root / 64] = 1ULL << (root % 64);
+    histogram_.push_back(1);
+    std::atomic<bool> fits(true);
+
+    for (int level = 1; ; ++level) {
+        for (std::atomic<uint64_t> &word : next) {
+            word.store(0, std::memory_order_relaxed);
+        }
+
+        // Every frontier state marks its neighbors that were not reached on
+        // an earlier level
+        parallelFor(words, threads, [&](unsigned, size_t begin, size_t end) {
+            std::array<char, CELLS> tiles;
+            for (size_t w = begin; w < end; ++w) {
+                for (uint64_t bits = frontier[w]; bits; bits &= bits - 1) {
+                    unrankTiles(w * 64 + __builtin_ctzll(bits), tiles);
+                    int blank = static_cast<int>(std::find(tiles.begin(), tiles.end(), 0) - tiles.begin());
+                    for (int from : State::MOVES[blank]) {
+                        if (from < 0) continue;
+                        std::swap(tiles[blank], tiles[from]);
+                        uint64_t rank = rankTiles(tiles);
+                        std::swap(tiles[blank], tiles[from]);
+                        uint64_t bit = 1ULL << (rank % 64);
+                        if (!(reached[rank / 64] & bit)) next[rank / 64].fetch_or(bit, std::memory_order_relaxed);
+                    }
+                }
+            }
+        });
+
+        // Threads own whole words of the bitmaps, and the 32 bytes of
+        // excess entries under each, so the merge needs no atomics
+        parallelFor(words, threads, [&](unsigned t, size_t begin, size_t end) {
+            std::array<char, CELLS> tiles;
+            size_t count = 0;
+            for (size_t w = begin; w < end; ++w) {
+                found[w] = next[w].load(std::memory_order_relaxed);
+                reached[w] |= found[w];
+                for (uint64_t bits = found[w]; bits; bits &= bits - 1) {
+                    uint64_t rank = w * 64 + __builtin_ctzll(bits);
+                    unrankTiles(rank, tiles);
+                    int manhattan = 0;
+                    for (int i = 0; i < CELLS; ++i) {
+                        if (tiles[i] != 0) manhattan += State::DISTANCE[i][goalCell_[static_cast<int>(tiles[i])]];
+                    }
+                    int entry = (level - manhattan) / 2;
+                    if (entry > MAX_EXCESS) {
+                        fits.store(false, std::memory_order_relaxed);
+                        entry = MAX_EXCESS;
+                    }
+                    excess[rank / 2] |= static_cast<unsigned char>(rank % 2 ? entry << 4 : entry);
+                    ++count;
+                }
+            }
+            counts[t] = count;
+        });
+
+        size_t total = 0;
+        for (unsigned t = 0; t < threads; ++t) {
+            total += counts[t];
+            counts[t] = 0;
+        }
+        if (total == 0) break;
+        histogram_.push_back(total);
+        frontier.swap(found);
+    }
+
+    if (!fits.load()) {
+        histogram_.clear();
+        return false;
+    }
+    for (size_t w = 0; w < words; ++w) {
+        for (uint64_t bits = frontier[w]; bits; bits &= bits - 1) {
+            hardest_.push_back(unrankState<Rows, Cols>(w * 64 + __builtin_ctzll(bits)));
+        }
+    }
+    reached_.swap(reached);
+    excess_.swap(excess);
+    return true;
+}
+
+template <int Rows, int Cols>
+bool StateSpace<Rows, Cols>::ready() const {
+    return !reached_.empty();
+}
+
+template <int Rows, int Cols>
+size_t StateSpace<Rows, Cols>::size() const {
+    size_t total = 0;
+    for (size_t count : histogram_) {
+        total += count;
+    }
+    return total;
+}
+
+template <int Rows, int Cols>
+int StateSpace<Rows, Cols>::distance(const State &state) const {
+    if (!ready() || state == State(std::array<char, Rows * Cols>{0})) return -1;
+    std::array<char, Rows * Cols> tiles = state.asArray();
+    uint64_t rank = rankTiles(tiles);
+    if (!(reached_[rank / 64] >> (rank % 64) & 1)) return -1;
+    int manhattan = 0;
+    for (int i = 0; i < Rows * Cols; ++i) {
+        if (tiles[i] != 0) manhattan += State::DISTANCE[i][goalCell_[static_cast<int>(tiles[i])]];
+    }
+    unsigned char byte = excess_[rank / 2];
+    return manhattan + 2 * (rank % 2 ? byte >> 4 : byte & 0xF);
+}
+
+template <int Rows, int Cols>
+const std::vector<size_t> &StateSpace<Rows, Cols>::histogram() const {
+    return histogram_;
+}
+
+template <int Rows, int Cols>
+const std::vector<SlidingPuzzle<Rows, Cols>> &StateSpace<Rows, Cols>::hardest() const {
+    return hardest_;
+}
+
+template uint64_t rankState(const SlidingPuzzle<2, 4> &);
+template uint64_t rankState(const SlidingPuzzle<3, 3> &);
+template uint64_t rankState(const SlidingPuzzle<4, 4> &);
+
+template SlidingPuzzle<2, 4> unrankState(uint64_t);
+template SlidingPuzzle<3, 3> unrankState(uint64_t);
+template SlidingPuzzle<4, 4> unrankState(uint64_t);
+
+template class StateSpace<2, 4>;
+template class StateSpace<3, 3>;
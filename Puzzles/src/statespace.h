@@ -0,0 +1,102 @@
+/**
+ * @file statespace.h
+ * Perfect ranking of puzzle states and exhaustive breadth-first sweeps of
+ * small puzzles over rank space.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "puzzle.h"
+
+/**
+* Ranks a state by the Myrvold-Ruskey permutation ranking: a bijection
+* between the Cells! arrangements of tiles and the integers below Cells!,
+* computed in time linear in the number of cells. Boards of up to 20
+* cells fit in 64 bits.
+* @param state The state to rank
+* @return the rank, below Rows * Cols factorial
+*/
+template <int Rows, int Cols>
+uint64_t rankState(const SlidingPuzzle<Rows, Cols> &state);
+
+/**
+* The state with a given rank; the inverse of rankState().
+* @param rank A rank below Rows * Cols factorial
+*/
+template <int Rows, int Cols>
+SlidingPuzzle<Rows, Cols> unrankState(uint64_t rank);
+
+/**
+* The exact distance from every state of a small puzzle to one goal,
+* found by a breadth-first sweep of the whole state space.
+*
+* Every table is indexed by rank. The states reached are a bitmap over
+* all Cells! ranks; the half that cannot reach the goal is left unset,
+* which costs one bit per state and keeps ranking free of parity
+* arithmetic. Distances are stored as 4-bit entries like those of a
+* PatternDatabase: half the excess of the distance over the manhattan
+* distance, so the 8-puzzle takes 226 kB in all.
+*
+* The sweep is level-synchronous over bitmap frontiers. Each level is
+* split into ranges of frontier words, one per thread, and the states
+* found are merged into the reached bitmap by words, so only setting a
+* bit in the next frontier needs an atomic operation.
+*
+* StateSpace is instantiated for the 2x4 and 3x3 boards in statespace.cpp.
+*/
+template <int Rows, int Cols>
+class StateSpace {
+public:
+    typedef SlidingPuzzle<Rows, Cols> State;
+
+    StateSpace();
+
+    /**
+    * Sweeps every state reachable from the goal, replacing anything built
+    * before. The 8-puzzle's 181,440 states take a fraction of a second.
+    * @param goal The state distances are measured to
+    * @param threads Number of worker threads; 0 uses
+    *  std::thread::hardware_concurrency()
+    * @return true, if the goal is valid and every excess fits in 4 bits
+    */
+    bool build(const State &goal = State(), unsigned threads = 0);
+
+    /**
+    * @return true, if the space was built
+    */
+    bool ready() const;
+
+    /**
+    * @return the number of states that can reach the goal
+    */
+    size_t size() const;
+
+    /**
+    * @return the fewest moves from a state to the goal, or -1 if it
+    * cannot reach it
+    */
+    int distance(const State &state) const;
+
+    /**
+    * @return the number of states at each distance from the goal, from 0
+    * up to the largest
+    */
+    const std::vector<size_t> &histogram() const;
+
+    /**
+    * @return the states farthest from the goal, in rank order
+    */
+    const std::vector<State> &hardest() const;
+
+private:
+    State goal_;
+    std::array<int, Rows * Cols> goalCell_; // Goal position of each tile
+    std::vector<uint64_t> reached_;         // One bit per rank
+    std::vector<unsigned char> excess_;     // 4-bit entries, two per byte
+    std::vector<size_t> histogram_;
+    std::vector<State> hardest_;
+};
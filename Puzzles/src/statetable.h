@@ -0,0 +1,85 @@
+/**
+ * @file statetable.h
+ * A flat hash table of search records keyed by packed puzzle states.
+ */
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <vector>
+
+#include "puzzle.h"
+
+/**
+* What a search knows about a state: the fewest moves found to it, the
+* state the last of them came from, and whether A* has expanded it. The
+* first word of a valid state holds several tiles and at most one empty
+* space, so it is never zero; a zero first word marks an empty slot, and
+* a root's parent.
+*/
+template <typename Packed>
+struct StateRecord {
+    Packed state;
+    Packed parent;
+    int g;
+    bool closed;
+};
+
+/**
+* Open-addressing hash table of state records with linear probing, kept
+* at most half full. Records live in one flat array, so a state costs no
+* allocation of its own. References are only good until the next insert.
+*/
+template <typename Packed>
+class StateTable {
+public:
+    typedef StateRecord<Packed> Record;
+
+    StateTable() : slots_(1 << 12), size_(0) {}
+
+    Record *find(const Packed &state) {
+        return const_cast<Record *>(static_cast<const StateTable &>(*this).find(state));
+    }
+
+    const Record *find(const Packed &state) const {
+        for (size_t i = slot(state); ; i = (i + 1) & (slots_.size() - 1)) {
+            if (slots_[i].state == state) return &slots_[i];
+            if (slots_[i].state[0] == 0) return NULL;
+        }
+    }
+
+    // Finds a state's record, adding one with g = INT_MAX if missing
+    Record &insert(const Packed &state) {
+        if (2 * (size_ + 1) > slots_.size()) grow();
+        size_t i = slot(state);
+        while (slots_[i].state[0] != 0 && slots_[i].state != state) {
+            i = (i + 1) & (slots_.size() - 1);
+        }
+        if (slots_[i].state[0] == 0) {
+            slots_[i] = Record{state, Packed{}, INT_MAX, false};
+            ++size_;
+        }
+        return slots_[i];
+    }
+
+private:
+    std::vector<Record> slots_;
+    size_t size_;
+
+    size_t slot(const Packed &state) const {
+        return PuzzleStateHash::mix(state) & (slots_.size() - 1);
+    }
+
+    void grow() {
+        std::vector<Record> old(slots_.size() * 2);
+        old.swap(slots_);
+        for (const Record &record : old) {
+            if (record.state[0] == 0) continue;
+            size_t i = slot(record.state);
+            while (slots_[i].state[0] != 0) {
+                i = (i + 1) & (slots_.size() - 1);
+            }
+            slots_[i] = record;
+        }
+    }
+};
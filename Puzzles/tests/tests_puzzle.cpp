@@ -0,0 +1,443 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+
+#include "puzzle.h"
+#include "batch.h"
+#include "heuristic.h"
+#include "patterndb.h"
+#include "statespace.h"
+
+namespace {
+    // A random solvable state, reached by a random walk from the solved one
+    template <typename State = PuzzleState>
+    State randomState(std::mt19937 & rng, int moves) {
+        State state;
+        for (int i = 0; i < moves; i++) {
+            std::array<State, 4> neighbors;
+            size_t count = state.getNeighbors(neighbors);
+            state = neighbors[rng() % count];
+        }
+        return state;
+    }
+}
+
+TEST_CASE("Packed states round-trip through arrays and words", "[puzzle]") {
+    std::mt19937 rng(225);
+    for (int i = 0; i < 200; i++) {
+        PuzzleState state = randomState(rng, 60);
+        std::array<char, 16> tiles = state.asArray();
+        REQUIRE(PuzzleState(tiles) == state);
+        REQUIRE(PuzzleState::fromPacked(state.asPacked()) == state);
+        REQUIRE(PuzzleState::fromPacked(state.asPacked()).getNeighbors() == state.getNeighbors());
+    }
+    REQUIRE(PuzzleState().asPacked() == 0x123456789ABCDEF0ULL);
+    REQUIRE(PuzzleState(std::array<char, 16>{0}).asPacked() == 0);
+}
+
+TEST_CASE("Packed order matches array order", "[puzzle]") {
+    std::mt19937 rng(7);
+    for (int i = 0; i < 500; i++) {
+        PuzzleState a = randomState(rng, 40), b = randomState(rng, 40);
+        REQUIRE((a < b) == (a.asArray() < b.asArray()));
+        REQUIRE((a == b) == (a.asArray() == b.asArray()));
+    }
+}
+
+TEST_CASE("Neighbor array matches getNeighbor", "[puzzle]") {
+    std::mt19937 rng(11);
+    const PuzzleState::Direction order[4] = {PuzzleState::Direction::UP, PuzzleState::Direction::DOWN,
+                                                                                      PuzzleState::Direction::LEFT, PuzzleState::Direction::RIGHT};
+    PuzzleState invalid(std::array<char, 16>{0});
+    for (int i = 0; i < 200; i++) {
+        PuzzleState state = randomState(rng, 30);
+        std::array<PuzzleState, 4> neighbors;
+        size_t count = state.getNeighbors(neighbors);
+        size_t next = 0;
+        for (PuzzleState::Direction dir : order) {
+            PuzzleState neighbor = state.getNeighbor(dir);
+            if (neighbor != invalid) {
+                REQUIRE(next < count);
+                REQUIRE(neighbors[next++] == neighbor);
+                REQUIRE(neighbor.manhattanDistance(state) == 1);
+            }
+        }
+        REQUIRE(next == count);
+    }
+}
+
+TEST_CASE("Hash spreads nearby states", "[puzzle]") {
+    std::mt19937 rng(3);
+    std::unordered_set<PuzzleState, PuzzleStateHash> states;
+    std::unordered_set<size_t> hashes;
+    for (int i = 0; i < 5000; i++) {
+        PuzzleState state = randomState(rng, 20);
+        if (states.insert(state).second) {
+            hashes.insert(PuzzleStateHash()(state));
+        }
+    }
+    REQUIRE(hashes.size() == states.size());
+}
+
+namespace {
+    // Whether every step of a path moves exactly one tile into the blank
+    template <typename State>
+    bool validPath(const std::vector<State> &path) {
+        for (size_t i = 1; i < path.size(); i++) {
+            std::vector<State> neighbors = path[i - 1].getNeighbors();
+            if (std::find(neighbors.begin(), neighbors.end(), path[i]) == neighbors.end()) return false;
+        }
+        return true;
+    }
+}
+
+TEST_CASE("IDA* finds optimal solutions", "[puzzle][IDA*]") {
+    std::mt19937 rng(42);
+    for (int i = 0; i < 20; i++) {
+        PuzzleState start = randomState(rng, 50);
+        std::vector<PuzzleState> astar = solveAstar(start, PuzzleState());
+        size_t iterations;
+        std::vector<PuzzleState> ida = solveIDAstar(start, PuzzleState(), &iterations);
+        REQUIRE(ida.size() == astar.size());
+        REQUIRE(ida.front() == start);
+        REQUIRE(ida.back() == PuzzleState());
+        REQUIRE(validPath(ida));
+        REQUIRE(iterations >= ida.size());
+    }
+
+    // Swapping two tiles makes the puzzle unsolvable
+    PuzzleState swapped({2, 1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0});
+    REQUIRE(solveIDAstar(swapped, PuzzleState()).empty());
+    REQUIRE(solveIDAstar(PuzzleState(), PuzzleState()).size() == 1);
+}
+
+TEST_CASE("IDA* solves Korf's first random instance", "[puzzle][IDA*][timeout=30000]") {
+    PuzzleState start({14, 13, 15, 7, 11, 12, 9, 5, 6, 0, 2, 1, 4, 8, 10, 3});
+    PuzzleState goal({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
+    std::vector<PuzzleState> path = solveIDAstar(start, goal);
+    REQUIRE(path.size() == 58);
+    REQUIRE(path.back() == goal);
+    REQUIRE(validPath(path));
+}
+
+TEST_CASE("Pattern database estimates are admissible", "[puzzle][patterndb]") {
+    PatternDatabase patterns;
+    REQUIRE(patterns.build(PuzzleState(), {{1, 2, 5, 6}, {3, 4, 7, 8}, {9, 10, 13, 14}, {11, 12, 15}}));
+    REQUIRE(patterns.ready());
+    REQUIRE(patterns.patternCount() == 4);
+    REQUIRE(patterns.patternOf(6) == 0);
+    REQUIRE(patterns.patternOf(15) == 3);
+    REQUIRE(patterns.patternOf(0) == -1);
+    REQUIRE(patterns.estimate(PuzzleState()) == 0);
+
+    std::mt19937 rng(43);
+    bool stronger = false;
+    for (int i = 0; i < 20; i++) {
+        PuzzleState start = randomState(rng, 60);
+        size_t plain, guided;
+        std::vector<PuzzleState> expected = solveIDAstar(start, PuzzleState(), &plain);
+        std::vector<PuzzleState> path = solveIDAstar(start, PuzzleState(), &guided, &patterns);
+        REQUIRE(path.size() == expected.size());
+        REQUIRE(validPath(path));
+        REQUIRE(guided <= plain);
+        REQUIRE(solveAstar(start, PuzzleState(), NULL, &patterns).size() == expected.size());
+
+        // Every state on an optimal path is estimated within its distance,
+        // and one move changes the estimate by an odd amount
+        for (size_t j = 0; j < path.size(); j++) {
+            int estimate = patterns.estimate(path[j]);
+            REQUIRE(estimate >= path[j].manhattanDistance());
+            REQUIRE(estimate <= static_cast<int>(path.size() - 1 - j));
+            stronger = stronger || estimate > path[j].manhattanDistance();
+            for (const PuzzleState &neighbor : path[j].getNeighbors()) {
+                REQUIRE(std::abs(patterns.estimate(neighbor) - estimate) % 2 == 1);
+            }
+        }
+    }
+    REQUIRE(stronger);
+
+    // Groups must be disjoint tiles from 1 to 15
+    REQUIRE_FALSE(patterns.build(PuzzleState(), {{1, 2}, {2, 3}}));
+    REQUIRE_FALSE(patterns.build(PuzzleState(), {{0, 1}}));
+    REQUIRE_FALSE(patterns.ready());
+}
+
+TEST_CASE("Pattern databases round-trip through files", "[puzzle][patterndb]") {
+    PuzzleState goal({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
+    PatternDatabase built;
+    REQUIRE(built.build(goal, {{1, 2, 3, 5, 6}, {4, 8, 12}, {9, 10, 13, 14}}));
+    REQUIRE(built.save("patterns-actual.pdb"));
+
+    PatternDatabase mapped;
+    REQUIRE(mapped.open("patterns-actual.pdb"));
+    REQUIRE(mapped.goal() == goal);
+    REQUIRE(mapped.patternCount() == 3);
+    std::mt19937 rng(44);
+    for (int i = 0; i < 1000; i++) {
+        PuzzleState state = goal;
+        for (int j = 0; j < 80; j++) {
+            std::array<PuzzleState, 4> neighbors;
+            state = neighbors[rng() % state.getNeighbors(neighbors)];
+        }
+        REQUIRE(mapped.estimate(state) == built.estimate(state));
+    }
+
+    // A database for another goal is ignored by the solvers
+    PuzzleState start({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0, 14, 15});
+    REQUIRE(solveIDAstar(start, PuzzleState(), NULL, &mapped).size() == 3);
+
+    REQUIRE_FALSE(mapped.open("missing-actual.pdb"));
+    REQUIRE_FALSE(mapped.ready());
+}
+
+TEST_CASE("Bidirectional searches find optimal solutions", "[puzzle][bidirectional]") {
+    std::mt19937 rng(45);
+    for (int i = 0; i < 20; i++) {
+        PuzzleState start = randomState(rng, i < 10 ? 24 : 60);
+        size_t expected = solveIDAstar(start, PuzzleState()).size();
+        std::vector<PuzzleState> astar = solveBidirectionalAstar(start, PuzzleState());
+        REQUIRE(astar.size() == expected);
+        REQUIRE(astar.front() == start);
+        REQUIRE(astar.back() == PuzzleState());
+        REQUIRE(validPath(astar));
+        if (i < 10) {
+            std::vector<PuzzleState> bfs = solveBidirectionalBFS(start, PuzzleState());
+            REQUIRE(bfs.size() == expected);
+            REQUIRE(bfs.front() == start);
+            REQUIRE(bfs.back() == PuzzleState());
+            REQUIRE(validPath(bfs));
+        }
+    }
+
+    // With one move, each side meets the other at its root
+    PuzzleState oneMove({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 0, 15});
+    REQUIRE(solveBidirectionalBFS(oneMove, PuzzleState()).size() == 2);
+    REQUIRE(solveBidirectionalAstar(oneMove, PuzzleState()).size() == 2);
+
+    PuzzleState swapped({2, 1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0});
+    REQUIRE(solveBidirectionalBFS(swapped, PuzzleState()).empty());
+    REQUIRE(solveBidirectionalAstar(swapped, PuzzleState()).empty());
+    REQUIRE(solveBidirectionalBFS(PuzzleState(), PuzzleState()).size() == 1);
+    REQUIRE(solveBidirectionalAstar(PuzzleState(), PuzzleState()).size() == 1);
+}
+
+TEST_CASE("BFS iteration counts are pinned", "[puzzle][BFS]") {
+    // Counts of the queue-of-paths search the arena replaced, which tested
+    // each state for the goal as it was generated
+    size_t iterations;
+    REQUIRE(solveBFS(PuzzleState({5, 1, 7, 4, 9, 3, 11, 8, 0, 2, 12, 15, 13, 6, 10, 14}), PuzzleState(), &iterations).size() == 19);
+    REQUIRE(iterations == 361513);
+    REQUIRE(solveBFS(PuzzleState({5, 1, 2, 3, 9, 10, 6, 4, 13, 0, 7, 8, 14, 15, 11, 12}), PuzzleState(), &iterations).size() == 16);
+    REQUIRE(iterations == 64097);
+    REQUIRE(solveBFS(PuzzleState({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0, 12, 13, 14, 11, 15}), PuzzleState(), &iterations).size() == 3);
+    REQUIRE(iterations == 2);
+    REQUIRE(solveBFS(PuzzleState(), PuzzleState(), &iterations).size() == 1);
+    REQUIRE(iterations == 1);
+}
+
+TEST_CASE("Bidirectional BFS expands far fewer states", "[puzzle][bidirectional]") {
+    PuzzleState start({5, 1, 2, 3, 9, 10, 6, 4, 13, 0, 7, 8, 14, 15, 11, 12});
+    size_t forward, bidirectional;
+    std::vector<PuzzleState> expected = solveBFS(start, PuzzleState(), &forward);
+    REQUIRE(solveBidirectionalBFS(start, PuzzleState(), &bidirectional).size() == expected.size());
+    REQUIRE(bidirectional * 10 < forward);
+}
+
+TEST_CASE("A* matches IDA* on longer solutions", "[puzzle][A*]") {
+    std::mt19937 rng(46);
+    for (int i = 0; i < 10; i++) {
+        PuzzleState start = randomState(rng, 200);
+        size_t iterations;
+        std::vector<PuzzleState> path = solveAstar(start, PuzzleState(), &iterations);
+        REQUIRE(path.size() == solveIDAstar(start, PuzzleState()).size());
+        REQUIRE(path.front() == start);
+        REQUIRE(path.back() == PuzzleState());
+        REQUIRE(validPath(path));
+        REQUIRE(iterations >= path.size());
+    }
+
+    PuzzleState swapped({2, 1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0});
+    size_t iterations;
+    REQUIRE(solveAstar(swapped, PuzzleState(), &iterations).empty());
+    REQUIRE(iterations == 0);
+}
+
+static_assert(SlidingPuzzle<3, 3>::MOVES[0][1] == -1 && SlidingPuzzle<3, 3>::MOVES[0][0] == 3, "Moves into the corner");
+static_assert(SlidingPuzzle<5, 5>::DISTANCE[0][24] == 8, "Corner to corner");
+static_assert(SlidingPuzzle<6, 6>::GOAL_CELL[0] == 35 && SlidingPuzzle<6, 6>::GOAL_CELL[7] == 6, "Goal cells");
+static_assert(SlidingPuzzle<6, 6>::WORDS == 4, "36 tiles of 6 bits");
+
+TEST_CASE("Solvers agree on the 8-puzzle", "[puzzle][sizes]") {
+    typedef SlidingPuzzle<3, 3> Puzzle8;
+    std::mt19937 rng(47);
+    for (int i = 0; i < 20; i++) {
+        Puzzle8 start = randomState<Puzzle8>(rng, 60);
+        REQUIRE(Puzzle8::fromWords(start.asWords()) == start);
+        std::vector<Puzzle8> bfs = solveBFS(start, Puzzle8());
+        REQUIRE(validPath(bfs));
+        REQUIRE(solveAstar(start, Puzzle8()).size() == bfs.size());
+        REQUIRE(solveIDAstar(start, Puzzle8()).size() == bfs.size());
+        REQUIRE(solveBidirectionalBFS(start, Puzzle8()).size() == bfs.size());
+        REQUIRE(solveBidirectionalAstar(start, Puzzle8()).size() == bfs.size());
+    }
+
+    Puzzle8 swapped({2, 1, 3, 4, 5, 6, 7, 8, 0});
+    REQUIRE(!isSolvable(swapped, Puzzle8()));
+    REQUIRE(solveBFS(swapped, Puzzle8()).empty());
+}
+
+TEST_CASE("A* matches IDA* on larger boards", "[puzzle][sizes]") {
+    typedef SlidingPuzzle<5, 5> Puzzle24;
+    typedef SlidingPuzzle<6, 6> Puzzle35;
+    std::mt19937 rng(48);
+    for (int i = 0; i < 10; i++) {
+        Puzzle24 start = randomState<Puzzle24>(rng, 30);
+        REQUIRE(Puzzle24::fromWords(start.asWords()) == start);
+        std::vector<Puzzle24> path = solveAstar(start, Puzzle24());
+        REQUIRE(validPath(path));
+        REQUIRE(path.back() == Puzzle24());
+        REQUIRE(solveIDAstar(start, Puzzle24()).size() == path.size());
+    }
+    for (int i = 0; i < 10; i++) {
+        Puzzle35 start = randomState<Puzzle35>(rng, 24);
+        REQUIRE(Puzzle35::fromWords(start.asWords()) == start);
+        std::vector<Puzzle35> path = solveIDAstar(start, Puzzle35());
+        REQUIRE(validPath(path));
+        REQUIRE(solveAstar(start, Puzzle35()).size() == path.size());
+        REQUIRE(solveBidirectionalAstar(start, Puzzle35()).size() == path.size());
+    }
+}
+
+TEST_CASE("Ranks are a bijection onto the factorial", "[puzzle][statespace]") {
+    std::vector<bool> seen(40320);
+    for (uint64_t rank = 0; rank < seen.size(); rank++) {
+        SlidingPuzzle<2, 4> state = unrankState<2, 4>(rank);
+        REQUIRE(rankState(state) == rank);
+        seen[rank] = true;
+    }
+    REQUIRE(std::count(seen.begin(), seen.end(), true) == 40320);
+    REQUIRE(rankState(unrankState<3, 3>(362879)) == 362879);
+
+    std::mt19937 rng(48);
+    for (int i = 0; i < 200; i++) {
+        PuzzleState state = randomState(rng, 80);
+        REQUIRE(unrankState<4, 4>(rankState(state)) == state);
+    }
+}
+
+TEST_CASE("Sweeping the 8-puzzle finds every distance", "[puzzle][statespace]") {
+    typedef SlidingPuzzle<3, 3> Puzzle8;
+    StateSpace<3, 3> space;
+    REQUIRE(!space.ready());
+    REQUIRE(space.build(Puzzle8(), 2));
+    REQUIRE(space.size() == 181440);
+    REQUIRE(space.histogram().size() == 32);
+    REQUIRE(space.histogram()[0] == 1);
+    REQUIRE(space.hardest() == std::vector<Puzzle8>{Puzzle8({8, 6, 7, 2, 5, 4, 3, 0, 1}), Puzzle8({6, 4, 7, 8, 5, 0, 3, 2, 1})});
+
+    std::mt19937 rng(49);
+    for (int i = 0; i < 50; i++) {
+        Puzzle8 start = randomState<Puzzle8>(rng, 40);
+        REQUIRE(space.distance(start) + 1 == static_cast<int>(solveBFS(start, Puzzle8()).size()));
+    }
+    REQUIRE(space.distance(Puzzle8({2, 1, 3, 4, 5, 6, 7, 8, 0})) == -1);
+    REQUIRE(space.distance(space.hardest()[0]) == 31);
+
+    StateSpace<2, 4> small;
+    REQUIRE(small.build());
+    REQUIRE(small.size() == 20160);
+    REQUIRE(small.histogram().size() == 37);
+}
+
+TEST_CASE("Parallel IDA* finds optimal solutions", "[puzzle][IDA*][parallel]") {
+    std::mt19937 rng(49);
+    for (int i = 0; i < 10; i++) {
+        PuzzleState start = randomState(rng, 100);
+        size_t iterations;
+        std::vector<PuzzleState> path = solveIDAstarParallel(start, PuzzleState(), 3, &iterations);
+        REQUIRE(path.size() == solveIDAstar(start, PuzzleState()).size());
+        REQUIRE(path.front() == start);
+        REQUIRE(path.back() == PuzzleState());
+        REQUIRE(validPath(path));
+        REQUIRE(iterations >= path.size());
+    }
+
+    // Solutions shorter than the enumerated moves are found while enumerating
+    PuzzleState oneMove({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 0, 15});
+    REQUIRE(solveIDAstarParallel(oneMove, PuzzleState(), 4).size() == 2);
+
+    PuzzleState swapped({2, 1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0});
+    size_t iterations;
+    REQUIRE(solveIDAstarParallel(swapped, PuzzleState(), 2, &iterations).empty());
+    REQUIRE(iterations == 0);
+}
+
+TEST_CASE("Batches solve every instance in order", "[puzzle][batch]") {
+    std::mt19937 rng(50);
+    std::vector<std::pair<PuzzleState, PuzzleState>> instances;
+    for (int i = 0; i < 24; i++) {
+        instances.emplace_back(randomState(rng, 20 + 4 * i), PuzzleState());
+    }
+    PuzzleState swapped({2, 1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0});
+    instances[5].first = swapped;
+    instances[17].second = swapped;
+
+    BatchOptions options;
+    options.threads = 3;
+    for (int round = 0; round < 3; round++) {
+        if (round == 1) options.solver = BatchOptions::Solver::IDASTAR;
+        if (round == 2) options.parallelFrom = 20;
+        std::vector<BatchResult<4, 4>> results = solveBatch(instances, options);
+        REQUIRE(results.size() == instances.size());
+        for (size_t i = 0; i < instances.size(); i++) {
+            const BatchResult<4, 4> &result = results[i];
+            if (i == 5 || i == 17) {
+                REQUIRE(!result.solvable);
+                REQUIRE(result.path.empty());
+                REQUIRE(result.nodes == 0);
+                continue;
+            }
+            REQUIRE(result.solvable);
+            REQUIRE(result.path.size() == solveAstar(instances[i].first, instances[i].second).size());
+            REQUIRE(result.path.front() == instances[i].first);
+            REQUIRE(validPath(result.path));
+            REQUIRE(result.nodes > 0);
+            REQUIRE(result.seconds >= 0);
+        }
+    }
+}
+
+TEST_CASE("Estimate deltas match estimates from scratch", "[puzzle][heuristic]") {
+    std::mt19937 rng(50);
+    PuzzleState goal({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
+    for (bool conflicts : {false, true}) {
+        MoveEstimator<4, 4> estimator(goal, conflicts);
+        for (int i = 0; i < 300; i++) {
+            PuzzleState state = randomState(rng, 60);
+            int h = estimator.estimate(state);
+            if (!conflicts) REQUIRE(h == state.manhattanDistance(goal));
+            std::array<PuzzleState, 4> neighbors, expected;
+            std::array<int, 4> deltas;
+            size_t count = estimator.neighbors(state, neighbors, deltas);
+            REQUIRE(count == state.getNeighbors(expected));
+            for (size_t k = 0; k < count; k++) {
+                REQUIRE(neighbors[k] == expected[k]);
+                REQUIRE(h + deltas[k] == estimator.estimate(neighbors[k]));
+            }
+        }
+    }
+
+    typedef SlidingPuzzle<2, 4> Puzzle7;
+    MoveEstimator<2, 4> small(Puzzle7(), true);
+    for (int i = 0; i < 100; i++) {
+        Puzzle7 state = randomState<Puzzle7>(rng, 30);
+        std::array<Puzzle7, 4> neighbors;
+        std::array<int, 4> deltas;
+        size_t count = small.neighbors(state, neighbors, deltas);
+        for (size_t k = 0; k < count; k++) {
+            REQUIRE(small.estimate(state) + deltas[k] == small.estimate(neighbors[k]));
+        }
+    }
+}